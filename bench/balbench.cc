@@ -0,0 +1,1355 @@
+/*
+ * balbench.cc
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <bal.hh>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(__WIN__)
+# include <netinet/tcp.h>
+# include <signal.h>
+# include <sys/resource.h>
+# include <sys/wait.h>
+#endif
+
+using namespace std;
+using namespace bal;
+
+namespace
+{
+    /** Socket errors (including EAGAIN) are expected here, so don't throw. */
+    class nothrow_policy : public policy
+    {
+    public:
+        static constexpr bool throw_on_error() noexcept {
+            return false;
+        }
+    };
+
+    using bench_socket = socket_base<true, nothrow_policy>;
+
+    constexpr const char* bench_addr = "127.0.0.1";
+    constexpr size_t io_buf_size     = 65536;
+
+    /** Command line options. */
+    struct bench_options
+    {
+        string mode        = "echo";   /**< "echo", "churn" or "idle". */
+        string port        = "6990";
+        string server      = "inproc"; /**< "inproc", "child" or "none". */
+        string handlers    = "callback"; /**< Echo server style: "callback" or
+                                              "coroutine". */
+        size_t connections = 16;       /**< Peak live connections in churn mode;
+                                            active connections in idle mode. */
+        size_t idle        = 1000;     /**< Idle connections (idle mode). */
+        size_t threads     = 1;
+        size_t size        = 64;
+        size_t pipeline    = 1;
+        size_t window      = 32;       /**< Connects in flight (churn mode). */
+        size_t reactors    = 1;
+        double duration    = 5.0;
+        double warmup      = 1.0;
+        bool nodelay       = true;
+    };
+
+    uint64_t now_ns()
+    {
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void set_nodelay(bench_socket& sock, bool nodelay)
+    {
+        int value = nodelay ? 1 : 0;
+        [[maybe_unused]] auto unused = sock.set_option(IPPROTO_TCP, TCP_NODELAY,
+            &value, sizeof(value));
+    }
+
+    string last_error()
+    {
+        return error::from_last_error().message;
+    }
+
+    /** CPU time consumed by the whole process, or by the calling thread. */
+    uint64_t cpu_time_ns(bool thread)
+    {
+#if defined(__WIN__)
+        FILETIME created {};
+        FILETIME exited {};
+        FILETIME kernel {};
+        FILETIME user {};
+        const BOOL ok = thread
+            ? GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)
+            : GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+        if (!ok) {
+            return 0;
+        }
+
+        auto to_ns = [](const FILETIME& ft)
+        {
+            return ((static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100;
+        };
+        return to_ns(kernel) + to_ns(user);
+#else
+        timespec ts {};
+        if (0 != clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &ts)) {
+            return 0;
+        }
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+            static_cast<uint64_t>(ts.tv_nsec);
+#endif
+    }
+
+    /** The process's resident set size, or zero where that isn't available. */
+    uint64_t resident_bytes()
+    {
+#if defined(__linux__)
+        unsigned long long size = 0;
+        unsigned long long resident = 0;
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (nullptr == statm) {
+            return 0;
+        }
+
+        const int read = fscanf(statm, "%llu %llu", &size, &resident);
+        [[maybe_unused]] auto unused = fclose(statm);
+        return 2 == read ? resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    /** Bytes currently allocated by libbal; idle mode installs the allocator
+     * below to measure the memory cost of each registered socket. */
+    atomic<uint64_t> lib_heap_bytes {0};
+
+    /** Prefixes each block with its size, keeping the block max_align_t
+     * aligned as calloc's would be. */
+    void* counting_calloc(size_t num, size_t size, void*)
+    {
+        constexpr size_t header = sizeof(max_align_t);
+        if (0 != size && num > (SIZE_MAX - header) / size) {
+            return nullptr;
+        }
+
+        const size_t bytes = num * size;
+        auto* block = static_cast<unsigned char*>(calloc(1, header + bytes));
+        if (nullptr == block) {
+            return nullptr;
+        }
+
+        memcpy(block, &bytes, sizeof(bytes));
+        lib_heap_bytes += bytes;
+        return block + header;
+    }
+
+    void counting_free(void* ptr, void*)
+    {
+        if (nullptr == ptr) {
+            return;
+        }
+
+        auto* block = static_cast<unsigned char*>(ptr) - sizeof(max_align_t);
+        size_t bytes = 0;
+        memcpy(&bytes, block, sizeof(bytes));
+        lib_heap_bytes -= bytes;
+        free(block);
+    }
+
+    /** Raises the soft limit on open descriptors as far as the hard limit
+     * allows, and returns the resulting limit. */
+    uint64_t raise_descriptor_limit()
+    {
+#if defined(__WIN__)
+        return UINT64_MAX;
+#else
+        rlimit lim {};
+        if (0 != getrlimit(RLIMIT_NOFILE, &lim)) {
+            return 0;
+        }
+
+        if (lim.rlim_cur != lim.rlim_max) {
+            rlimit raised = lim;
+            raised.rlim_cur = lim.rlim_max;
+            if (0 == setrlimit(RLIMIT_NOFILE, &raised)) {
+                lim = raised;
+            }
+        }
+
+        return RLIM_INFINITY == lim.rlim_cur ? UINT64_MAX : static_cast<uint64_t>(lim.rlim_cur);
+#endif
+    }
+
+    uint64_t registered_sockets()
+    {
+        bal_stats stats {};
+        return bal_get_stats(&stats) ? stats.total.sockets : 0;
+    }
+
+    /** Waits until the reactors have `count` sockets registered, giving up
+     * once that number has stopped changing for `stall_ms`. */
+    bool wait_for_registered(uint64_t count, uint32_t stall_ms)
+    {
+        auto last     = registered_sockets();
+        auto progress = now_ns();
+
+        while (last != count) {
+            bal_sleep_msec(10);
+            const auto now = registered_sockets();
+            if (now != last) {
+                last     = now;
+                progress = now_ns();
+            } else if (now_ns() - progress > stall_ms * 1000000ULL) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /** Exact percentiles of a set of samples (which is reordered). */
+    uint64_t percentile(vector<uint64_t>& samples, double pct)
+    {
+        if (samples.empty()) {
+            return 0;
+        }
+
+        auto rank = static_cast<size_t>(pct / 100.0 * static_cast<double>(samples.size()));
+        rank = std::min(rank, samples.size() - 1);
+        nth_element(samples.begin(), samples.begin() + static_cast<ptrdiff_t>(rank),
+            samples.end());
+        return samples[rank];
+    }
+
+    /** Accumulates "key": value pairs for a single-line JSON object. */
+    class json_object
+    {
+    public:
+        json_object& add(const string& key, const string& value)
+        {
+            return add_raw(key, "\"" + value + "\"");
+        }
+
+        json_object& add(const string& key, double value)
+        {
+            std::array<char, 64> buf {};
+            [[maybe_unused]] auto unused = snprintf(buf.data(), buf.size(), "%.3f", value);
+            return add_raw(key, buf.data());
+        }
+
+        json_object& add(const string& key, uint64_t value)
+        {
+            return add_raw(key, to_string(value));
+        }
+
+        json_object& add(const string& key, const json_object& value)
+        {
+            return add_raw(key, value.str());
+        }
+
+        json_object& add_raw(const string& key, const string& value)
+        {
+            _body += (_body.empty() ? "\"" : ", \"") + key + "\": " + value;
+            return *this;
+        }
+
+        string str() const
+        {
+            return "{" + _body + "}";
+        }
+
+    private:
+        string _body;
+    };
+
+    /** Summarizes a set of latencies (in nanoseconds) in microseconds. */
+    json_object summarize(vector<uint64_t>& samples)
+    {
+        uint64_t sum = 0;
+        for (auto s : samples) {
+            sum += s;
+        }
+
+        json_object out;
+        out.add("count", static_cast<uint64_t>(samples.size()))
+            .add("mean", samples.empty() ? 0.0 : static_cast<double>(sum) /
+                static_cast<double>(samples.size()) / 1e3)
+            .add("p50", static_cast<double>(percentile(samples, 50.0)) / 1e3)
+            .add("p99", static_cast<double>(percentile(samples, 99.0)) / 1e3)
+            .add("p99.9", static_cast<double>(percentile(samples, 99.9)) / 1e3)
+            .add("max", static_cast<double>(percentile(samples, 100.0)) / 1e3);
+
+        return out;
+    }
+
+    /** An echo server in the style of balserver: every byte read from a
+     * client is written back to it, using the C++ wrapper's event handlers. */
+    class echo_server
+    {
+    public:
+        echo_server(const string& port, bool nodelay) : _nodelay(nodelay)
+        {
+            _listener.handlers().on_incoming_conn = [this](bench_socket* sock)
+            {
+                return on_incoming_conn(sock);
+            };
+
+            if (!_listener.create(AF_INET, SOCK_STREAM, IPPROTO_TCP) ||
+                !_listener.set_reuseaddr(1) || !_listener.bind(bench_addr, port) ||
+                !_listener.listen(SOMAXCONN) || !_listener.async_poll(BAL_EVT_NORMAL)) {
+                throw bal::exception("failed to start echo server: " + last_error());
+            }
+        }
+
+        /** Server-side latencies, per connection. */
+        struct timings
+        {
+            vector<uint64_t> accept_to_registered; /**< From the accept event
+                                                        until registered. */
+            vector<uint64_t> close_to_removed;     /**< From the close event
+                                                        until closed and removed. */
+        };
+
+        echo_server(const echo_server&) = delete;
+        echo_server& operator=(const echo_server&) = delete;
+
+        ~echo_server()
+        {
+            [[maybe_unused]] auto unused = _listener.close();
+
+            scoped_lock lock(_mutex);
+            _conns.clear();
+            _closed.clear();
+        }
+
+        /** Returns (and clears) the latencies recorded so far. */
+        timings take_timings()
+        {
+            scoped_lock lock(_mutex);
+            return std::exchange(_timings, timings {});
+        }
+
+    private:
+        struct conn
+        {
+            bench_socket sock;
+            string out;
+        };
+
+        bool on_incoming_conn(bench_socket* sock)
+        {
+            const auto event_at = now_ns();
+            scoped_lock lock(_mutex);
+
+            /* connections that closed are retired here rather than from their
+             * own handlers, which are still running when they close. */
+            _closed.clear();
+
+            sock->accept_many(SOMAXCONN, [this, event_at](bench_socket& client_sock,
+                const address&)
+            {
+                auto c  = make_unique<conn>();
+                c->sock = std::move(client_sock);
+                set_nodelay(c->sock, _nodelay);
+
+                auto* cp = c.get();
+                c->sock.handlers().on_read  = [cp](bench_socket*) { return on_read(cp); };
+                c->sock.handlers().on_write = [cp](bench_socket*) { return flush(cp); };
+                c->sock.handlers().on_close = [this, cp](bench_socket*) { return on_close(cp); };
+                c->sock.handlers().on_error = [this, cp](bench_socket*) { return on_close(cp); };
+
+                if (c->sock.async_poll(BAL_EVT_NORMAL)) {
+                    const auto sd = c->sock.get_descriptor();
+                    _conns[sd] = std::move(c);
+                    _timings.accept_to_registered.push_back(now_ns() - event_at);
+                }
+            });
+
+            return true;
+        }
+
+        static bool on_read(conn* c)
+        {
+            thread_local std::array<char, io_buf_size> buf {};
+
+            ssize_t read = 0;
+            while ((read = c->sock.recv(buf.data(), buf.size(), 0)) > 0) {
+                c->out.append(buf.data(), static_cast<size_t>(read));
+            }
+
+            return flush(c);
+        }
+
+        static bool flush(conn* c)
+        {
+            size_t offset = 0;
+            while (offset < c->out.size()) {
+                const auto sent = c->sock.send(c->out.data() + offset,
+                    c->out.size() - offset);
+                if (sent <= 0) {
+                    break;
+                }
+                offset += static_cast<size_t>(sent);
+            }
+
+            c->out.erase(0, offset);
+            c->sock.want_write_events(!c->out.empty());
+            return true;
+        }
+
+        bool on_close(conn* c)
+        {
+            const auto event_at = now_ns();
+            scoped_lock lock(_mutex);
+
+            const auto sd = c->sock.get_descriptor();
+            [[maybe_unused]] auto unused = c->sock.close();
+
+            if (auto it = _conns.find(sd); it != _conns.end()) {
+                _closed.push_back(std::move(it->second));
+                _conns.erase(it);
+            }
+
+            _timings.close_to_removed.push_back(now_ns() - event_at);
+
+            return false;
+        }
+
+        bool _nodelay;
+        bench_socket _listener;
+        mutex _mutex;
+        unordered_map<bal_descriptor, unique_ptr<conn>> _conns;
+        vector<unique_ptr<conn>> _closed;
+        timings _timings;
+    };
+
+#if defined(__HAVE_COROUTINES__)
+    /** The same echo server written with coroutines: one accepts, and one per
+     * connection receives and sends, each resumed on the reactor's thread. */
+    class co_echo_server
+    {
+    public:
+        co_echo_server(const string& port, bool nodelay) : _nodelay(nodelay)
+        {
+            if (!_listener.create(AF_INET, SOCK_STREAM, IPPROTO_TCP) ||
+                !_listener.set_reuseaddr(1) || !_listener.bind(bench_addr, port) ||
+                !_listener.listen(SOMAXCONN) || !_listener.async_poll(BAL_EVT_NORMAL)) {
+                throw bal::exception("failed to start echo server: " + last_error());
+            }
+
+            accept_loop();
+        }
+
+        co_echo_server(const co_echo_server&) = delete;
+        co_echo_server& operator=(const co_echo_server&) = delete;
+
+        /* coroutines still suspended at this point are never resumed; the
+         * process is about to exit, so their frames are simply leaked. */
+        ~co_echo_server()
+        {
+            [[maybe_unused]] auto unused = _listener.close();
+
+            scoped_lock lock(_mutex);
+            _conns.clear();
+            _closed.clear();
+        }
+
+    private:
+        task accept_loop()
+        {
+            for (;;) {
+                auto client_sock = make_unique<bench_socket>();
+                address client_addr;
+                if (!co_await _listener.async_accept(*client_sock, client_addr)) {
+                    fprintf(stderr, "error: accept failed: %s\n", last_error().c_str());
+                    break;
+                }
+
+                set_nodelay(*client_sock, _nodelay);
+                client_sock->handlers().on_close = nullptr;
+                client_sock->handlers().on_error = nullptr;
+                if (!client_sock->async_poll(BAL_EVT_NORMAL)) {
+                    continue;
+                }
+
+                auto* sock = client_sock.get();
+                {
+                    scoped_lock lock(_mutex);
+                    /* see echo_server::on_incoming_conn. */
+                    _closed.clear();
+                    _conns[sock->get_descriptor()] = std::move(client_sock);
+                }
+
+                echo(sock);
+            }
+        }
+
+        task echo(bench_socket* sock)
+        {
+            std::array<char, io_buf_size> buf {};
+
+            for (;;) {
+                const auto read = co_await sock->async_recv(buf.data(), buf.size());
+                if (read <= 0 ||
+                    !co_await sock->async_send_all(buf.data(), static_cast<size_t>(read))) {
+                    break;
+                }
+            }
+
+            scoped_lock lock(_mutex);
+            const auto sd = sock->get_descriptor();
+            [[maybe_unused]] auto unused = sock->close();
+
+            if (auto it = _conns.find(sd); it != _conns.end()) {
+                _closed.push_back(std::move(it->second));
+                _conns.erase(it);
+            }
+        }
+
+        bool _nodelay;
+        bench_socket _listener;
+        mutex _mutex;
+        unordered_map<bal_descriptor, unique_ptr<bench_socket>> _conns;
+        vector<unique_ptr<bench_socket>> _closed;
+    };
+#endif
+
+    /** Runs whichever echo server opts.handlers selects, until destroyed. */
+    class any_echo_server
+    {
+    public:
+        explicit any_echo_server(const bench_options& opts)
+        {
+#if defined(__HAVE_COROUTINES__)
+            if (opts.handlers == "coroutine") {
+                _co_server = make_unique<co_echo_server>(opts.port, opts.nodelay);
+                return;
+            }
+#endif
+            _server = make_unique<echo_server>(opts.port, opts.nodelay);
+        }
+
+        /** The callback server (required by churn mode), or nullptr. */
+        echo_server* get() const noexcept
+        {
+            return _server.get();
+        }
+
+    private:
+        unique_ptr<echo_server> _server;
+#if defined(__HAVE_COROUTINES__)
+        unique_ptr<co_echo_server> _co_server;
+#endif
+    };
+
+    /** Results of one echo client thread. */
+    struct echo_result
+    {
+        uint64_t messages = 0;
+        uint64_t cpu_ns   = 0; /**< CPU time used by the client thread. */
+        vector<uint64_t> latencies;
+        string error;
+    };
+
+    /** A client connection with `pipeline` messages in flight. Responses
+     * arrive in order, so the send time of each is kept in a FIFO. */
+    struct echo_conn
+    {
+        bench_socket sock;
+        deque<uint64_t> sent_at;
+        size_t rx_partial = 0;
+        size_t tx_pending = 0;
+    };
+
+    /** Writes as much of the pending data as the socket will take. Hard errors
+     * are left for the next readiness check to report. */
+    void echo_flush(echo_conn& c, const vector<char>& payload)
+    {
+        while (c.tx_pending > 0) {
+            const auto len  = std::min(c.tx_pending, payload.size());
+            const auto sent = c.sock.send(payload.data(), static_cast<bal_iolen>(len));
+            if (sent <= 0) {
+                break;
+            }
+            c.tx_pending -= static_cast<size_t>(sent);
+        }
+    }
+
+    void echo_client(const bench_options& opts, size_t conns, uint64_t measure_start,
+        uint64_t measure_end, echo_result& result)
+    {
+        vector<unique_ptr<echo_conn>> cs;
+        vector<bal_socket*> socks;
+        vector<uint32_t> events;
+        const vector<char> payload(std::max(opts.size, io_buf_size), 'x');
+        std::array<char, io_buf_size> buf {};
+
+        for (size_t n = 0; n < conns; n++) {
+            auto c = make_unique<echo_conn>();
+            if (!c->sock.create(AF_INET, SOCK_STREAM, IPPROTO_TCP) ||
+                !c->sock.connect(bench_addr, opts.port) || !c->sock.set_io_mode(true)) {
+                result.error = "failed to connect: " + last_error();
+                return;
+            }
+            set_nodelay(c->sock, opts.nodelay);
+
+            const auto now = now_ns();
+            for (size_t p = 0; p < opts.pipeline; p++) {
+                c->sent_at.push_back(now);
+            }
+            c->tx_pending = opts.pipeline * opts.size;
+
+            socks.push_back(c->sock.get());
+            cs.push_back(std::move(c));
+        }
+
+        events.resize(cs.size());
+        for (auto& c : cs) {
+            echo_flush(*c, payload);
+        }
+
+        while (now_ns() < measure_end) {
+            for (size_t n = 0; n < cs.size(); n++) {
+                events[n] = BAL_EVT_READ | (cs[n]->tx_pending > 0 ? BAL_EVT_WRITE : 0U);
+            }
+
+            const auto ready = bal_check_readiness(socks.data(), events.data(),
+                socks.size(), 100);
+            if (-1 == ready) {
+                result.error = "bal_check_readiness failed: " + last_error();
+                return;
+            }
+
+            for (size_t n = 0; n < cs.size() && ready > 0; n++) {
+                auto& c = *cs[n];
+
+                if (bal_isbitset(events[n], BAL_EVT_READ)) {
+                    ssize_t read = 0;
+                    while ((read = c.sock.recv(buf.data(), buf.size(), 0)) > 0) {
+                        c.rx_partial += static_cast<size_t>(read);
+
+                        const auto now = now_ns();
+                        while (c.rx_partial >= opts.size && !c.sent_at.empty()) {
+                            c.rx_partial -= opts.size;
+                            if (now >= measure_start) {
+                                result.latencies.push_back(now - c.sent_at.front());
+                                result.messages++;
+                            }
+                            c.sent_at.pop_front();
+                            c.sent_at.push_back(now);
+                            c.tx_pending += opts.size;
+                        }
+                    }
+
+                    if (0 == read) {
+                        result.error = "server closed the connection";
+                        return;
+                    }
+                }
+
+                if (bal_isbitset(events[n], BAL_EVT_ERROR | BAL_EVT_CLOSE)) {
+                    result.error = "connection error: " + to_string(
+                        bal_get_sock_error(c.sock.get()));
+                    return;
+                }
+
+                echo_flush(c, payload);
+            }
+        }
+
+        result.cpu_ns = cpu_time_ns(true);
+    }
+
+    /** Runs opts.connections echo clients (spread over opts.threads threads)
+     * until measure_end, and combines their results. */
+    bool run_echo_clients(const bench_options& opts, uint64_t measure_start,
+        uint64_t measure_end, echo_result& total)
+    {
+        const auto threads = std::max<size_t>(1, std::min(opts.threads, opts.connections));
+
+        vector<echo_result> results(threads);
+        vector<thread> workers;
+
+        for (size_t t = 0; t < threads; t++) {
+            const auto conns = opts.connections / threads +
+                (t < opts.connections % threads ? 1 : 0);
+            workers.emplace_back(echo_client, cref(opts), conns, measure_start,
+                measure_end, ref(results[t]));
+        }
+
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        for (auto& r : results) {
+            if (!r.error.empty()) {
+                fprintf(stderr, "error: %s\n", r.error.c_str());
+                return false;
+            }
+            total.messages += r.messages;
+            total.cpu_ns   += r.cpu_ns;
+            total.latencies.insert(total.latencies.end(), r.latencies.begin(),
+                r.latencies.end());
+        }
+
+        return true;
+    }
+
+    /** Runs the echo benchmark against a server already listening on
+     * opts.port, and prints the results as JSON. */
+    bool run_echo(const bench_options& opts)
+    {
+        const auto start         = now_ns();
+        const auto measure_start = start + static_cast<uint64_t>(opts.warmup * 1e9);
+        const auto measure_end   = measure_start + static_cast<uint64_t>(opts.duration * 1e9);
+
+        echo_result total;
+        if (!run_echo_clients(opts, measure_start, measure_end, total)) {
+            return false;
+        }
+
+        const auto elapsed = static_cast<double>(now_ns() - measure_start) / 1e9;
+
+        json_object out;
+        out.add("mode", opts.mode)
+            .add("version", bal_get_versionstring())
+            .add("server", opts.server)
+            .add("handlers", opts.handlers)
+            .add("reactors", static_cast<uint64_t>(opts.reactors))
+            .add("threads", static_cast<uint64_t>(std::max<size_t>(1,
+                std::min(opts.threads, opts.connections))))
+            .add("connections", static_cast<uint64_t>(opts.connections))
+            .add("size", static_cast<uint64_t>(opts.size))
+            .add("pipeline", static_cast<uint64_t>(opts.pipeline))
+            .add("duration_s", elapsed)
+            .add("messages", total.messages)
+            .add("msgs_per_sec", static_cast<double>(total.messages) / elapsed)
+            .add("mb_per_sec", static_cast<double>(total.messages * opts.size) / elapsed / 1e6)
+            .add("latency_us", summarize(total.latencies));
+
+        printf("%s\n", out.str().c_str());
+        return true;
+    }
+
+    /** A client connection in churn mode. */
+    struct churn_conn
+    {
+        bench_socket sock;
+        uint64_t started = 0;
+    };
+
+    /** State shared by the churn driver and the client connections' handlers
+     * (which run on the reactor threads). */
+    struct churn_state
+    {
+        mutex mtx;
+        condition_variable cv;
+        size_t connected = 0;
+        bool failed      = false;
+        uint64_t measure_start = 0;
+        vector<uint64_t> connect_to_event;
+    };
+
+    bool start_churn_conn(churn_state& state, churn_conn& c, const string& port,
+        vector<uint64_t>& create_to_registered)
+    {
+        const auto started = now_ns();
+        c.sock.handlers().on_connect = [&state, &c](bench_socket*)
+        {
+            const auto now = now_ns();
+            {
+                scoped_lock lock(state.mtx);
+                if (c.started >= state.measure_start) {
+                    state.connect_to_event.push_back(now - c.started);
+                }
+                state.connected++;
+            }
+            state.cv.notify_one();
+            return true;
+        };
+        c.sock.handlers().on_conn_fail = [&state](bench_socket*)
+        {
+            {
+                scoped_lock lock(state.mtx);
+                state.failed = true;
+            }
+            state.cv.notify_one();
+            return false;
+        };
+
+        /* the driver closes these connections; leave them alone until then. */
+        c.sock.handlers().on_close = nullptr;
+        c.sock.handlers().on_error = nullptr;
+
+        if (!c.sock.create(AF_INET, SOCK_STREAM, IPPROTO_TCP) ||
+            !c.sock.async_poll(BAL_EVT_CONNECT | BAL_EVT_CONNFAIL)) {
+            return false;
+        }
+
+        c.started = now_ns();
+        if (started >= state.measure_start) {
+            create_to_registered.push_back(c.started - started);
+        }
+
+        return c.sock.connect(bench_addr, port);
+    }
+
+    /** Opens connections (at most opts.window connecting at once) until
+     * opts.connections are live, then closes them all, oldest first, and
+     * repeats. The in-process server records its side of each connection. */
+    bool run_churn(const bench_options& opts, echo_server& server)
+    {
+        churn_state state;
+        const auto start    = now_ns();
+        state.measure_start = start + static_cast<uint64_t>(opts.warmup * 1e9);
+        const auto measure_end = state.measure_start +
+            static_cast<uint64_t>(opts.duration * 1e9);
+
+        deque<unique_ptr<churn_conn>> live;
+        vector<uint64_t> create_to_registered;
+        vector<uint64_t> close_to_removed;
+        uint64_t closed  = 0;
+        uint64_t cycles  = 0;
+        bool growing     = true;
+        bool measuring   = false;
+        string error;
+
+        while (error.empty() && now_ns() < measure_end) {
+            if (!measuring && now_ns() >= state.measure_start) {
+                /* discard what the server recorded during the warm-up. */
+                [[maybe_unused]] auto unused = server.take_timings();
+                measuring = true;
+            }
+
+            if (growing) {
+                unique_lock lock(state.mtx);
+                while (live.size() < opts.connections &&
+                    live.size() - state.connected < opts.window) {
+                    lock.unlock();
+                    auto c = make_unique<churn_conn>();
+                    if (!start_churn_conn(state, *c, opts.port, create_to_registered)) {
+                        error = "failed to connect: " + last_error();
+                    }
+                    live.push_back(std::move(c));
+                    lock.lock();
+                    if (!error.empty()) {
+                        break;
+                    }
+                }
+
+                if (!error.empty() || state.connected == opts.connections) {
+                    growing = false;
+                    continue;
+                }
+
+                const auto progress = state.connected;
+                if (!state.cv.wait_for(lock, chrono::seconds(5), [&state, progress]
+                    { return state.failed || state.connected != progress; })) {
+                    error = "timed out waiting for connections to complete";
+                } else if (state.failed) {
+                    error = "connection failed";
+                }
+            } else {
+                auto c = std::move(live.front());
+                live.pop_front();
+
+                const auto close_start = now_ns();
+                [[maybe_unused]] auto unused = c->sock.close();
+                const auto close_end = now_ns();
+                c.reset();
+
+                {
+                    scoped_lock lock(state.mtx);
+                    state.connected--;
+                }
+
+                if (close_start >= state.measure_start) {
+                    close_to_removed.push_back(close_end - close_start);
+                    closed++;
+                }
+
+                if (live.empty()) {
+                    growing = true;
+                    cycles += measuring ? 1 : 0;
+                }
+            }
+        }
+
+        const auto elapsed = static_cast<double>(now_ns() - state.measure_start) / 1e9;
+
+        /* wait for the remaining connections to finish connecting, so that
+         * none of their handlers are running when they are destroyed. */
+        {
+            unique_lock lock(state.mtx);
+            [[maybe_unused]] auto unused = state.cv.wait_for(lock, chrono::seconds(5),
+                [&state, &live] { return state.failed || state.connected == live.size(); });
+        }
+        live.clear();
+
+        if (!error.empty()) {
+            fprintf(stderr, "error: %s\n", error.c_str());
+            return false;
+        }
+
+        auto server_timings = server.take_timings();
+        bal_stats stats {};
+        [[maybe_unused]] auto got_stats = bal_get_stats(&stats);
+
+        vector<uint64_t> connect_to_event;
+        {
+            scoped_lock lock(state.mtx);
+            connect_to_event = state.connect_to_event;
+        }
+
+        json_object phases;
+        phases.add("create_to_registered_us", summarize(create_to_registered))
+            .add("connect_to_event_us", summarize(connect_to_event))
+            .add("accept_to_registered_us", summarize(server_timings.accept_to_registered))
+            .add("client_close_to_removed_us", summarize(close_to_removed))
+            .add("server_close_to_removed_us", summarize(server_timings.close_to_removed));
+
+        json_object out;
+        out.add("mode", opts.mode)
+            .add("version", bal_get_versionstring())
+            .add("reactors", static_cast<uint64_t>(opts.reactors))
+            .add("max_live", static_cast<uint64_t>(opts.connections))
+            .add("window", static_cast<uint64_t>(opts.window))
+            .add("duration_s", elapsed)
+            .add("connections", closed)
+            .add("cycles", cycles)
+            .add("conns_per_sec", static_cast<double>(closed) / elapsed)
+            .add("peak_registered", stats.total.peak_sockets)
+            .add("loop_iterations", stats.total.iterations)
+            .add("phases", phases);
+
+        printf("%s\n", out.str().c_str());
+        return true;
+    }
+
+    /** The client ends of idle connections: plain sockets, never registered,
+     * so that only the server's ends load the reactors. */
+    class idle_set
+    {
+    public:
+        idle_set() = default;
+        idle_set(const idle_set&) = delete;
+        idle_set& operator=(const idle_set&) = delete;
+
+        ~idle_set()
+        {
+            close();
+        }
+
+        void close()
+        {
+            for (auto* s : socks) {
+                [[maybe_unused]] auto unused = bal_close(&s, true);
+            }
+            socks.clear();
+        }
+
+        vector<bal_socket*> socks;
+    };
+
+    /** Each source address only has an ephemeral port range's worth of
+     * connections to one destination; Linux routes all of 127.0.0.0/8 to the
+     * loopback interface, so larger idle sets are spread over several. */
+    constexpr size_t conns_per_source_addr = 16384;
+
+    bool connect_idle(const bench_options& opts, bal_socket* s, size_t n)
+    {
+#if defined(__linux__)
+        if (opts.idle > conns_per_source_addr) {
+            const auto source = "127.0.0." + to_string(1 + n / conns_per_source_addr);
+            if (!bal_bind(s, source.c_str(), "0")) {
+                return false;
+            }
+        }
+#else
+        (void)n;
+#endif
+        return bal_connect(s, bench_addr, opts.port.c_str());
+    }
+
+    /** Registers opts.idle connections that never send anything with the
+     * in-process server's reactors, then measures echo latency over a small
+     * active set, the CPU time the reactor threads burn, and the memory that
+     * each registered socket costs. */
+    bool run_idle(const bench_options& opts)
+    {
+        const uint64_t descriptors = 2 * (opts.idle + opts.connections) + 64;
+        const uint64_t limit       = raise_descriptor_limit();
+        if (limit < descriptors) {
+            fprintf(stderr, "error: %zu idle connections need about %" PRIu64
+                " descriptors, but the limit is %" PRIu64 " (see ulimit -n)\n",
+                opts.idle, descriptors, limit);
+            return false;
+        }
+
+#if defined(__linux__)
+        if (opts.idle / conns_per_source_addr >= 254) {
+            fprintf(stderr, "error: too many idle connections\n");
+            return false;
+        }
+#endif
+
+        /* the client sockets are created first, so that the heap measured
+         * below grows only by what the server's ends cost. */
+        idle_set idle;
+        idle.socks.reserve(opts.idle);
+        for (size_t n = 0; n < opts.idle; n++) {
+            bal_socket* s = nullptr;
+            if (!bal_create(&s, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP)) {
+                fprintf(stderr, "error: failed to create socket: %s\n", last_error().c_str());
+                return false;
+            }
+            idle.socks.push_back(s);
+        }
+
+        const auto base_registered = registered_sockets();
+        const auto heap_before     = lib_heap_bytes.load();
+        const auto rss_before      = resident_bytes();
+        const auto setup_start     = now_ns();
+
+        for (size_t n = 0; n < idle.socks.size(); n++) {
+            if (!connect_idle(opts, idle.socks[n], n)) {
+                fprintf(stderr, "error: idle connection %zu failed: %s\n", n,
+                    last_error().c_str());
+                return false;
+            }
+        }
+
+        if (!wait_for_registered(base_registered + opts.idle, 5000)) {
+            fprintf(stderr, "error: the server registered %" PRIu64 " of %zu idle"
+                " connections\n", registered_sockets() - base_registered, opts.idle);
+            return false;
+        }
+
+        const auto setup_s    = static_cast<double>(now_ns() - setup_start) / 1e9;
+        const auto heap_after = lib_heap_bytes.load();
+        const auto rss_after  = resident_bytes();
+        const auto registered = registered_sockets();
+
+        bal_stats before {};
+        [[maybe_unused]] auto got_before = bal_get_stats(&before);
+        const auto cpu_start      = cpu_time_ns(false);
+        const auto main_cpu_start = cpu_time_ns(true);
+        const auto start          = now_ns();
+        const auto measure_start  = start + static_cast<uint64_t>(opts.warmup * 1e9);
+        const auto measure_end    = measure_start + static_cast<uint64_t>(opts.duration * 1e9);
+
+        echo_result total;
+        if (!run_echo_clients(opts, measure_start, measure_end, total)) {
+            return false;
+        }
+
+        const auto end = now_ns();
+        const auto cpu = cpu_time_ns(false) - cpu_start;
+        const auto main_cpu = cpu_time_ns(true) - main_cpu_start;
+        bal_stats after {};
+        [[maybe_unused]] auto got_after = bal_get_stats(&after);
+
+        /* whatever the client threads and this one didn't use went to the
+         * reactor threads. */
+        const auto reactor_cpu = cpu - std::min(cpu, total.cpu_ns + main_cpu);
+        const auto iterations  = after.total.iterations - before.total.iterations;
+        const auto wall        = static_cast<double>(end - start);
+        const auto elapsed     = static_cast<double>(end - measure_start) / 1e9;
+
+        idle.close();
+        if (!wait_for_registered(base_registered, 5000)) {
+            fprintf(stderr, "warning: idle connections are still registered\n");
+        }
+
+        auto per_socket = [&opts](uint64_t before_bytes, uint64_t after_bytes)
+        {
+            return after_bytes > before_bytes ? static_cast<double>(after_bytes -
+                before_bytes) / static_cast<double>(opts.idle) : 0.0;
+        };
+
+        json_object out;
+        out.add("mode", opts.mode)
+            .add("version", bal_get_versionstring())
+            .add("reactors", static_cast<uint64_t>(opts.reactors))
+            .add("idle", static_cast<uint64_t>(opts.idle))
+            .add("active", static_cast<uint64_t>(opts.connections))
+            .add("registered", registered)
+            .add("size", static_cast<uint64_t>(opts.size))
+            .add("pipeline", static_cast<uint64_t>(opts.pipeline))
+            .add("setup_s", setup_s)
+            .add("duration_s", elapsed)
+            .add("messages", total.messages)
+            .add("msgs_per_sec", static_cast<double>(total.messages) / elapsed)
+            .add("latency_us", summarize(total.latencies))
+            .add("reactor_cpu_pct", static_cast<double>(reactor_cpu) / wall * 100.0)
+            .add("loop_iterations", iterations)
+            .add("reactor_cpu_us_per_iteration", 0 == iterations ? 0.0 :
+                static_cast<double>(reactor_cpu) / static_cast<double>(iterations) / 1e3)
+            .add("lib_bytes_per_socket", per_socket(heap_before, heap_after))
+            .add("rss_bytes_per_socket", per_socket(rss_before, rss_after));
+
+        printf("%s\n", out.str().c_str());
+        return true;
+    }
+
+    void print_usage()
+    {
+        fprintf(stderr,
+            "usage: balbench [echo|churn|idle] [options]\n"
+            "  --server <inproc|child|none>  where the echo server runs (default: inproc)\n"
+            "  --handlers <callback|coroutine>\n"
+            "                                how the echo server is written; coroutine\n"
+            "                                requires echo mode (default: callback)\n"
+            "  --port <port>                 loopback port (default: 6990)\n"
+            "  --connections <n>             client connections, or the peak number of\n"
+            "                                live connections in churn mode, or the active\n"
+            "                                connections in idle mode (default: 16)\n"
+            "  --window <n>                  connects in flight in churn mode (default: 32)\n"
+            "  --idle <n>                    idle connections in idle mode (default: 1000)\n"
+            "  --threads <n>                 client threads (default: 1)\n"
+            "  --size <bytes>                message size (default: 64)\n"
+            "  --pipeline <n>                messages in flight per connection (default: 1)\n"
+            "  --duration <sec>              measurement time (default: 5)\n"
+            "  --warmup <sec>                unmeasured time before that (default: 1)\n"
+            "  --reactors <n>                server async I/O reactors (default: 1)\n"
+            "  --no-nodelay                  leave Nagle's algorithm enabled\n");
+    }
+
+    bool parse_args(int argc, char** argv, bench_options& opts)
+    {
+        int n = 1;
+        if (n < argc && argv[n][0] != '-') {
+            opts.mode = argv[n++];
+        }
+
+        for (; n < argc; n++) {
+            const string arg = argv[n];
+            if (arg == "--no-nodelay") {
+                opts.nodelay = false;
+                continue;
+            }
+
+            if (n + 1 >= argc) {
+                return false;
+            }
+
+            const string val = argv[++n];
+            if (arg == "--server") {
+                opts.server = val;
+            } else if (arg == "--handlers") {
+                opts.handlers = val;
+            } else if (arg == "--port") {
+                opts.port = val;
+            } else if (arg == "--connections") {
+                opts.connections = stoul(val);
+            } else if (arg == "--threads") {
+                opts.threads = stoul(val);
+            } else if (arg == "--size") {
+                opts.size = stoul(val);
+            } else if (arg == "--pipeline") {
+                opts.pipeline = stoul(val);
+            } else if (arg == "--window") {
+                opts.window = stoul(val);
+            } else if (arg == "--idle") {
+                opts.idle = stoul(val);
+            } else if (arg == "--duration") {
+                opts.duration = stod(val);
+            } else if (arg == "--warmup") {
+                opts.warmup = stod(val);
+            } else if (arg == "--reactors") {
+                opts.reactors = stoul(val);
+            } else {
+                return false;
+            }
+        }
+
+        if ((opts.mode == "churn" || opts.mode == "idle") && opts.server != "inproc") {
+            fprintf(stderr, "error: %s mode requires the in-process server\n",
+                opts.mode.c_str());
+            return false;
+        }
+
+        if (opts.handlers == "coroutine") {
+#if defined(__HAVE_COROUTINES__)
+            if (opts.mode != "echo") {
+                fprintf(stderr, "error: coroutine handlers require echo mode\n");
+                return false;
+            }
+#else
+            fprintf(stderr, "error: this compiler doesn't support coroutines\n");
+            return false;
+#endif
+        } else if (opts.handlers != "callback") {
+            return false;
+        }
+
+        return (opts.mode == "echo" || opts.mode == "churn" || opts.mode == "idle") &&
+            opts.connections > 0 && opts.size > 0 && opts.pipeline > 0 &&
+            opts.window > 0 && opts.idle > 0 &&
+            opts.duration > 0.0 && (opts.server == "inproc" ||
+            opts.server == "child" || opts.server == "none");
+    }
+
+#if !defined(__WIN__)
+    volatile sig_atomic_t _child_stop = 0;
+
+    void on_child_sigterm(int)
+    {
+        _child_stop = 1;
+    }
+
+    /** Forks an echo server process (before this process initializes libbal)
+     * and waits until it accepts connections. */
+    pid_t start_child_server(const bench_options& opts)
+    {
+        const pid_t pid = fork();
+        if (0 == pid) {
+            [[maybe_unused]] auto unused = signal(SIGTERM, &on_child_sigterm);
+            try {
+                initializer balinit {opts.reactors};
+                any_echo_server server {opts};
+                while (0 == _child_stop) {
+                    bal_sleep_msec(100);
+                }
+            } catch (bal::exception& ex) {
+                fprintf(stderr, "error: %s\n", ex.what());
+                _exit(EXIT_FAILURE);
+            }
+            _exit(EXIT_SUCCESS);
+        }
+
+        return pid;
+    }
+
+    void stop_child_server(pid_t pid)
+    {
+        if (pid > 0) {
+            [[maybe_unused]] auto unused1 = kill(pid, SIGTERM);
+            [[maybe_unused]] auto unused2 = waitpid(pid, nullptr, 0);
+        }
+    }
+#endif
+
+    /** Waits (up to five seconds) for something to accept connections on
+     * opts.port. */
+    bool wait_for_server(const bench_options& opts)
+    {
+        for (int attempt = 0; attempt < 50; attempt++) {
+            bal_socket* probe = nullptr;
+            if (bal_create(&probe, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP)) {
+                const bool connected = bal_connect(probe, bench_addr, opts.port.c_str());
+                [[maybe_unused]] auto unused = bal_close(&probe, true);
+                if (connected) {
+                    return true;
+                }
+            }
+            bal_sleep_msec(100);
+        }
+
+        return false;
+    }
+} // !namespace
+
+int main(int argc, char** argv)
+{
+    bench_options opts;
+
+    try {
+        if (!parse_args(argc, argv, opts)) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    } catch (std::exception&) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+#if defined(__WIN__)
+    if (opts.server == "child") {
+        fprintf(stderr, "warning: --server child is not supported; using inproc\n");
+        opts.server = "inproc";
+    }
+#else
+    pid_t child = 0;
+    if (opts.server == "child") {
+        child = start_child_server(opts);
+        if (-1 == child) {
+            fprintf(stderr, "error: fork failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+#endif
+
+    if (opts.mode == "idle") {
+        const bal_allocator alloc {&counting_calloc, &counting_free, nullptr};
+        if (!bal_set_allocator(&alloc)) {
+            fprintf(stderr, "error: failed to install allocator: %s\n", last_error().c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool ok = false;
+    try {
+        initializer balinit {opts.server == "inproc" ? opts.reactors : 1};
+        unique_ptr<any_echo_server> server;
+
+        if (opts.server == "inproc") {
+            server = make_unique<any_echo_server>(opts);
+        }
+
+        if (!wait_for_server(opts)) {
+            fprintf(stderr, "error: no server listening on %s:%s\n", bench_addr,
+                opts.port.c_str());
+        } else if (opts.mode == "churn") {
+            ok = run_churn(opts, *server->get());
+        } else if (opts.mode == "idle") {
+            ok = run_idle(opts);
+        } else {
+            ok = run_echo(opts);
+        }
+    } catch (bal::exception& ex) {
+        fprintf(stderr, "error: %s\n", ex.what());
+    }
+
+#if !defined(__WIN__)
+    stop_child_server(child);
+#endif
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
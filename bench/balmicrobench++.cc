@@ -0,0 +1,180 @@
+/*
+ * balmicrobench++.cc
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "balmicrobench.h"
+#include <bal.hh>
+
+using namespace bal;
+
+namespace
+{
+    /** The static_socket equivalent of the scoped_socket below. */
+    class bench_static_socket : public static_socket<bench_static_socket>
+    {
+    public:
+        bool on_read()
+        {
+            bench_sink = bench_sink + 1;
+            return true;
+        }
+    };
+
+    template<class TSocket>
+    void bench_handler(bal_reactor* r, TSocket& sock, const char* kind)
+    {
+        /* registering installs the wrapper's callback. the socket never
+         * connects, so the events thread leaves it out of poll. */
+        sock.create(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sock.async_poll(BAL_EVT_READ);
+
+        bal_socket* s = sock.get();
+        char name[64] {};
+
+        (void)snprintf(name, sizeof(name), "%s handler", kind);
+        if (bench_selected(name)) {
+            bal_async_cb volatile proc = s->state.proc;
+            const auto start = bench_now_ns();
+            for (int n = 0; n < BENCH_ITERATIONS; n++) {
+                proc(s, BAL_EVT_READ);
+            }
+            bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+        }
+
+        (void)snprintf(name, sizeof(name), "dispatch + %s handler", kind);
+        if (bench_selected(name)) {
+            const auto start = bench_now_ns();
+            for (int n = 0; n < BENCH_ITERATIONS; n++) {
+                _bal_dispatch_events(r, s->sd, s, BAL_EVT_READ, 0ULL);
+            }
+            bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+        }
+
+        (void)snprintf(name, sizeof(name), "%s socket size", kind);
+        if (bench_selected(name)) {
+            (void)printf("%-32s %10zu bytes\n", name, sizeof(TSocket));
+        }
+    }
+} // !namespace
+
+void bench_cxx_handlers(bal_reactor* r)
+{
+    try {
+        scoped_socket sock;
+        sock.handlers().on_read = [](scoped_socket*)
+        {
+            bench_sink = bench_sink + 1;
+            return true;
+        };
+        bench_handler(r, sock, "c++");
+
+        bench_static_socket static_sock;
+        bench_handler(r, static_sock, "c++ static");
+
+        /* what accepting a connection and moving it into a container costs in
+         * handler setup, with closures that capture too much to be stored
+         * inline (as balserver's would if they captured its state). */
+        uint64_t state[3] {};
+        auto on_read = [&state, r, s = &sock](scoped_socket*)
+        {
+            state[0] += bal_bitsinmask(s->get(), BAL_EVT_READ) ? 1 : 0;
+            return nullptr != r;
+        };
+        auto on_close = [&state, r, s = &sock](scoped_socket* closed)
+        {
+            state[1] += closed == s ? 1 : 0;
+            return nullptr != r;
+        };
+
+        if (bench_selected("c++ per-socket handlers")) {
+            const auto start = bench_now_ns();
+            for (int n = 0; n < BENCH_ITERATIONS; n++) {
+                scoped_socket accepted;
+                accepted.handlers().on_read  = on_read;
+                accepted.handlers().on_close = on_close;
+                accepted.handlers().on_error = on_close;
+                scoped_socket stored;
+                stored = std::move(accepted);
+            }
+            bench_report("c++ per-socket handlers", bench_now_ns() - start,
+                BENCH_ITERATIONS);
+        }
+
+        if (bench_selected("c++ shared handlers")) {
+            handler_set<scoped_socket> handlers;
+            handlers.on_read  = on_read;
+            handlers.on_close = on_close;
+            handlers.on_error = on_close;
+            const auto shared = std::move(handlers).share();
+
+            const auto start = bench_now_ns();
+            for (int n = 0; n < BENCH_ITERATIONS; n++) {
+                scoped_socket accepted;
+                accepted.set_handlers(shared);
+                scoped_socket stored;
+                stored = std::move(accepted);
+            }
+            bench_report("c++ shared handlers", bench_now_ns() - start,
+                BENCH_ITERATIONS);
+        }
+    } catch (bal::exception& ex) {
+        fprintf(stderr, "error: %s\n", ex.what());
+    }
+}
+
+void bench_cxx_results(bal_socket* s)
+{
+    std::array<char, 64> buf {};
+
+    if (bench_selected("c++ recv (EAGAIN), exception")) {
+        manual_socket sock;
+        [[maybe_unused]] const auto* unused = sock.attach(s);
+
+        const auto start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++) {
+            try {
+                bench_sink = bench_sink + static_cast<uint64_t>(sock.recv(buf));
+            } catch (bal::exception&) {
+                bench_sink = bench_sink + 1;
+            }
+        }
+        bench_report("c++ recv (EAGAIN), exception", bench_now_ns() - start,
+            BENCH_ITERATIONS);
+        [[maybe_unused]] const auto* detached = sock.detach();
+    }
+
+    if (bench_selected("c++ recv (EAGAIN), result")) {
+        socket_base<false, result_policy> sock;
+        [[maybe_unused]] const auto* unused = sock.attach(s);
+
+        const auto start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++) {
+            const auto read = sock.recv(buf);
+            bench_sink = bench_sink + static_cast<uint64_t>(read ? *read : read.os_error_code());
+        }
+        bench_report("c++ recv (EAGAIN), result", bench_now_ns() - start,
+            BENCH_ITERATIONS);
+        [[maybe_unused]] const auto* detached = sock.detach();
+    }
+}
@@ -0,0 +1,453 @@
+/*
+ * balmicrobench.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "balmicrobench.h"
+#include <stdlib.h>
+
+/** Loopback port used by the benchmarks. */
+#define BENCH_PORT "6980"
+
+/** A connected pair of non-blocking sockets. */
+typedef struct {
+    bal_socket* listener;
+    bal_socket* client;
+    bal_socket* server;
+} bench_conn;
+
+volatile uint64_t bench_sink = 0;
+
+/** Name filters from the command line; with none, every benchmark runs. */
+static int bench_filter_count = 0;
+static char** bench_filters    = NULL;
+
+uint64_t bench_now_ns(void)
+{
+#if defined(__WIN__)
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER now         = {0};
+    if (0 == freq.QuadPart)
+        (void)QueryPerformanceFrequency(&freq);
+    (void)QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts = {0};
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+bool bench_selected(const char* name)
+{
+    if (0 == bench_filter_count)
+        return true;
+
+    for (int n = 0; n < bench_filter_count; n++) {
+        if (NULL != strstr(name, bench_filters[n]))
+            return true;
+    }
+
+    return false;
+}
+
+void bench_report(const char* name, uint64_t elapsed_ns, uint64_t ops)
+{
+    (void)printf("%-32s %10.1f ns/op (%" PRIu64 " ops)\n", name,
+        (double)elapsed_ns / (double)ops, ops);
+}
+
+void bench_c_handler(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    bench_sink += events;
+}
+
+static bool bench_connect(bench_conn* conn)
+{
+    bal_sockaddr addr = {0};
+    bool ok = bal_create(&conn->listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok = ok && bal_set_reuseaddr(conn->listener, 1);
+    ok = ok && bal_bind(conn->listener, "127.0.0.1", BENCH_PORT);
+    ok = ok && bal_listen(conn->listener, SOMAXCONN);
+    ok = ok && bal_create(&conn->client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok = ok && bal_connect(conn->client, "127.0.0.1", BENCH_PORT);
+    ok = ok && bal_accept(conn->listener, &conn->server, &addr);
+    ok = ok && bal_set_io_mode(conn->server, true);
+    return ok;
+}
+
+static void bench_disconnect(bench_conn* conn)
+{
+    if (NULL != conn->server)
+        (void)bal_close(&conn->server, true);
+    if (NULL != conn->client)
+        (void)bal_close(&conn->client, true);
+    if (NULL != conn->listener)
+        (void)bal_close(&conn->listener, true);
+}
+
+/** Cost of a bare recv() on a socket with nothing to read. */
+static void bench_raw_recv_eagain(const bench_conn* conn)
+{
+    const char* name = "raw recv (EAGAIN)";
+    if (!bench_selected(name))
+        return;
+
+    char buf[64];
+    uint64_t start = bench_now_ns();
+    for (int n = 0; n < BENCH_ITERATIONS; n++)
+        (void)recv(conn->server->sd, buf, sizeof(buf), 0);
+    bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+}
+
+/** Cost of bal_recv on a socket with nothing to read, including whatever
+ * bookkeeping libbal does for the resulting EAGAIN. */
+static void bench_bal_recv_eagain(const bench_conn* conn)
+{
+    const char* name = "bal_recv (EAGAIN)";
+    if (!bench_selected(name))
+        return;
+
+    char buf[64];
+    uint64_t start = bench_now_ns();
+    for (int n = 0; n < BENCH_ITERATIONS; n++)
+        (void)bal_recv(conn->server, buf, sizeof(buf), 0);
+    bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+}
+
+/** Translation of the flags poll returns, in the proportions a busy
+ * connection produces them. */
+static void bench_pollflags_to_events(void)
+{
+    const char* name = "_bal_pollflags_to_events";
+    if (!bench_selected(name))
+        return;
+
+    static const short flags[] = {
+        POLLIN, POLLIN, POLLIN, POLLOUT, POLLIN | POLLOUT, POLLIN | POLLHUP,
+        POLLERR | POLLHUP, POLLNVAL
+    };
+
+    uint64_t sum   = 0;
+    uint64_t start = bench_now_ns();
+    for (int n = 0; n < BENCH_ITERATIONS; n++)
+        sum += _bal_pollflags_to_events(flags[(size_t)n % _bal_countof(flags)]);
+    bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    bench_sink += sum;
+}
+
+/** Translation of event masks into flags for poll, as done for every
+ * registered socket on every event loop iteration. */
+static void bench_mask_to_pollflags(void)
+{
+    const char* name = "_bal_mask_to_pollflags";
+    if (!bench_selected(name))
+        return;
+
+    static const uint32_t masks[] = {
+        BAL_EVT_NORMAL, BAL_EVT_NORMAL, BAL_EVT_NORMAL | BAL_EVT_WRITE,
+        BAL_EVT_CLIENT, BAL_EVT_CONNECT | BAL_EVT_CONNFAIL, BAL_EVT_ALL
+    };
+
+    uint64_t sum   = 0;
+    uint64_t start = bench_now_ns();
+    for (int n = 0; n < BENCH_ITERATIONS; n++)
+        sum += (uint16_t)_bal_mask_to_pollflags(masks[(size_t)n % _bal_countof(masks)]);
+    bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    bench_sink += sum;
+}
+
+/** Cost of invoking the C callback through the socket's function pointer,
+ * and of getting there via _bal_dispatch_events (with and without latency
+ * histograms). The socket isn't registered, so the reactor is a stand-in. */
+static void bench_c_dispatch(bal_reactor* r, bal_socket* s)
+{
+    s->state.proc = &bench_c_handler;
+    s->state.mask = BAL_EVT_NORMAL;
+
+    if (bench_selected("c handler")) {
+        bal_async_cb volatile proc = s->state.proc;
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            proc(s, BAL_EVT_READ);
+        bench_report("c handler", bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+
+    if (bench_selected("dispatch + c handler")) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            _bal_dispatch_events(r, s->sd, s, BAL_EVT_READ, 0ULL);
+        bench_report("dispatch + c handler", bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+
+    if (bench_selected("dispatch + c handler (hist)")) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            _bal_dispatch_events(r, s->sd, s, BAL_EVT_READ, bench_now_ns());
+        bench_report("dispatch + c handler (hist)", bench_now_ns() - start,
+            BENCH_ITERATIONS);
+    }
+
+    s->state.proc = NULL;
+    s->state.mask = 0U;
+}
+
+/** The socket list operations, on a list of `count` sockets. Keys are looked
+ * up uniformly, so finds and removals walk half the list on average. */
+static void bench_list(size_t count)
+{
+    char name[64];
+    bal_list* lst     = NULL;
+    bal_socket* socks = calloc(count + 1, sizeof(bal_socket));
+    int iterations    = (int)(BENCH_ITERATIONS * 16 / count);
+
+    if (NULL == socks || !_bal_list_create(&lst)) {
+        (void)fprintf(stderr, "error: failed to create list\n");
+        free(socks);
+        return;
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        socks[n].sd = (bal_descriptor)(n + 3);
+        (void)_bal_list_add(lst, socks[n].sd, &socks[n]);
+    }
+
+    (void)snprintf(name, sizeof(name), "list add+remove (n=%zu)", count);
+    if (bench_selected(name)) {
+        bal_socket* extra = &socks[count];
+        extra->sd         = (bal_descriptor)(count + 3);
+        uint64_t start    = bench_now_ns();
+        for (int n = 0; n < iterations; n++) {
+            bal_socket* removed = NULL;
+            (void)_bal_list_add(lst, extra->sd, extra);
+            (void)_bal_list_remove(lst, extra->sd, &removed);
+        }
+        bench_report(name, bench_now_ns() - start, (uint64_t)iterations);
+    }
+
+    (void)snprintf(name, sizeof(name), "list find (n=%zu)", count);
+    if (bench_selected(name)) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < iterations; n++) {
+            bal_socket* found = NULL;
+            (void)_bal_list_find(lst, (bal_descriptor)((size_t)n % count + 3), &found);
+            bench_sink += (uintptr_t)found;
+        }
+        bench_report(name, bench_now_ns() - start, (uint64_t)iterations);
+    }
+
+    (void)snprintf(name, sizeof(name), "list count (n=%zu)", count);
+    if (bench_selected(name)) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < iterations; n++)
+            bench_sink += _bal_list_count(lst);
+        bench_report(name, bench_now_ns() - start, (uint64_t)iterations);
+    }
+
+    (void)snprintf(name, sizeof(name), "list iterate/node (n=%zu)", count);
+    if (bench_selected(name)) {
+        int passes     = iterations / 16 + 1;
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < passes; n++) {
+            bal_descriptor key = 0;
+            bal_socket* val    = NULL;
+            _bal_list_reset_iterator(lst);
+            while (_bal_list_iterate(lst, &key, &val))
+                bench_sink += (uint64_t)key;
+        }
+        bench_report(name, bench_now_ns() - start, (uint64_t)passes * count);
+    }
+
+    (void)_bal_list_destroy(&lst);
+    free(socks);
+}
+
+/** Address resolution, the way bal_bind (numeric) and bal_connect (host
+ * names) do it, and the reverse lookup done by bal_get_addrstrings. */
+static void bench_addrinfo(const bal_socket* s)
+{
+    const char* name = "_bal_get_addrinfo (numeric)";
+    if (bench_selected(name)) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_SLOW_ITERATIONS; n++) {
+            struct addrinfo* ai = NULL;
+            if (_bal_get_addrinfo(AI_NUMERICHOST, AF_INET, SOCK_STREAM, "127.0.0.1",
+                BENCH_PORT, &ai))
+                freeaddrinfo(ai);
+        }
+        bench_report(name, bench_now_ns() - start, BENCH_SLOW_ITERATIONS);
+    }
+
+    name = "_bal_get_addrinfo (localhost)";
+    if (bench_selected(name)) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_SLOW_ITERATIONS; n++) {
+            struct addrinfo* ai = NULL;
+            if (_bal_get_addrinfo(0, AF_INET, SOCK_STREAM, "localhost", BENCH_PORT, &ai))
+                freeaddrinfo(ai);
+        }
+        bench_report(name, bench_now_ns() - start, BENCH_SLOW_ITERATIONS);
+    }
+
+    name = "_bal_getnameinfo (numeric)";
+    bal_sockaddr addr = {0};
+    if (bench_selected(name) && bal_get_peer_addr(s, &addr)) {
+        char host[NI_MAXHOST];
+        char port[NI_MAXSERV];
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_SLOW_ITERATIONS; n++)
+            bench_sink += (uint64_t)_bal_getnameinfo(_BAL_NI_NODNS, &addr, host, port);
+        bench_report(name, bench_now_ns() - start, BENCH_SLOW_ITERATIONS);
+    }
+}
+
+/** Recording an error (which every failing call does), and retrieving it
+ * along with its formatted message. */
+static void bench_errors(void)
+{
+    const char* name = "__bal_set_error";
+    if (bench_selected(name)) {
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            bench_sink += (uint64_t)_bal_seterror(_BAL_E_INVALIDARG);
+        bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+
+    name = "_bal_get_error";
+    if (bench_selected(name)) {
+        bal_error err  = {0};
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            bench_sink += (uint64_t)_bal_get_error(&err, false);
+        bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+
+    name = "__bal_set_error + _bal_get_error";
+    if (bench_selected(name)) {
+        bal_error err  = {0};
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++) {
+            (void)_bal_seterror(_BAL_E_INVALIDARG);
+            bench_sink += (uint64_t)_bal_get_error(&err, false);
+        }
+        bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+
+    name = "_bal_get_error_codes";
+    if (bench_selected(name)) {
+        bal_error_codes codes = {0};
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < BENCH_ITERATIONS; n++)
+            bench_sink += (uint64_t)_bal_get_error_codes(&codes);
+        bench_report(name, bench_now_ns() - start, BENCH_ITERATIONS);
+    }
+}
+
+/** Searching a 4 KiB line for its delimiter, and checksumming it, with and
+ * without the SIMD/SSE4.2 code picked at run time. */
+static void bench_scan(void)
+{
+    static uint8_t line[4096];
+    memset(line, 'x', sizeof(line));
+    line[sizeof(line) - 1] = '\n';
+
+    const int iterations = BENCH_ITERATIONS / 16;
+    static const struct {
+        const char* name;
+        bool fast;
+    } variants[] = {
+        {"_bal_find_delim (4 KiB, scalar)", false},
+        {"_bal_find_delim (4 KiB, simd)", true}
+    };
+
+    for (size_t v = 0; v < _bal_countof(variants); v++) {
+        if (!bench_selected(variants[v].name))
+            continue;
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < iterations; n++)
+            bench_sink += _bal_find_delim(line, sizeof(line), '\n', variants[v].fast);
+        bench_report(variants[v].name, bench_now_ns() - start, (uint64_t)iterations);
+    }
+
+    static const struct {
+        const char* name;
+        bool fast;
+    } crcs[] = {
+        {"_bal_crc32c (4 KiB, table)", false},
+        {"_bal_crc32c (4 KiB, sse4.2)", true}
+    };
+
+    for (size_t v = 0; v < _bal_countof(crcs); v++) {
+        if (!bench_selected(crcs[v].name))
+            continue;
+        uint64_t start = bench_now_ns();
+        for (int n = 0; n < iterations; n++)
+            bench_sink += _bal_crc32c((uint32_t)n, line, sizeof(line), crcs[v].fast);
+        bench_report(crcs[v].name, bench_now_ns() - start, (uint64_t)iterations);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench_filter_count = argc - 1;
+    bench_filters      = argv + 1;
+
+    if (!bal_init()) {
+        (void)fprintf(stderr, "error: bal_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_conn conn = {NULL, NULL, NULL};
+    if (!bench_connect(&conn)) {
+        bal_error err = {0};
+        (void)bal_get_error(&err);
+        (void)fprintf(stderr, "error: failed to connect over loopback: %s\n",
+            err.message);
+        bench_disconnect(&conn);
+        (void)bal_cleanup();
+        return EXIT_FAILURE;
+    }
+
+    /* stands in for a real reactor in the dispatch benchmarks; the sockets
+     * they use are never polled, so no events thread touches them. */
+    static bal_reactor reactor;
+
+    bench_raw_recv_eagain(&conn);
+    bench_bal_recv_eagain(&conn);
+    bench_pollflags_to_events();
+    bench_mask_to_pollflags();
+    bench_c_dispatch(&reactor, conn.server);
+    bench_cxx_handlers(&reactor);
+    bench_cxx_results(conn.server);
+    bench_list(16);
+    bench_list(1024);
+    bench_addrinfo(conn.client);
+    bench_errors();
+    bench_scan();
+
+    bench_disconnect(&conn);
+    (void)bal_cleanup();
+
+    return EXIT_SUCCESS;
+}
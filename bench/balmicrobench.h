@@ -0,0 +1,69 @@
+/*
+ * balmicrobench.h
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _BAL_MICROBENCH_H_INCLUDED
+# define _BAL_MICROBENCH_H_INCLUDED
+
+# include "bal.h"
+
+# if defined(__cplusplus)
+extern "C" {
+# endif
+
+/** Number of iterations for each benchmark. */
+# define BENCH_ITERATIONS 1000000
+
+/** Number of iterations for benchmarks that make system or resolver calls. */
+# define BENCH_SLOW_ITERATIONS 20000
+
+/** Results are accumulated here so that the compiler can't discard the work
+ * being timed. */
+extern volatile uint64_t bench_sink;
+
+/** Returns a monotonic timestamp, in nanoseconds. */
+uint64_t bench_now_ns(void);
+
+/** True if the benchmark named `name` was selected on the command line. */
+bool bench_selected(const char* name);
+
+/** Prints the average time taken by each of `ops` operations. */
+void bench_report(const char* name, uint64_t elapsed_ns, uint64_t ops);
+
+/** The async I/O callback used by the C handler benchmarks. */
+void bench_c_handler(bal_socket* s, uint32_t events);
+
+/** Compares the C++ wrapper's event handlers against the raw C callback,
+ * dispatching through the supplied reactor. */
+void bench_cxx_handlers(bal_reactor* r);
+
+/** Compares failing calls (EAGAIN from recv on `s`) under the C++ wrapper's
+ * throwing default_policy and its result_policy. */
+void bench_cxx_results(bal_socket* s);
+
+# if defined(__cplusplus)
+}
+# endif
+
+#endif /* !_BAL_MICROBENCH_H_INCLUDED */
@@ -27,6 +27,7 @@
 # define _BAL_H_INCLUDED
 
 # include "bal/internal.h"
+# include "bal/alloc.h"
 # include "bal/errors.h"
 # include "bal/types.h"
 # include "bal/helpers.h"
@@ -40,9 +41,17 @@ bool bal_init(void);
 bool bal_cleanup(void);
 bool bal_isinitialized(void);
 
+bool bal_set_allocator(const bal_allocator* alloc);
+
+bool bal_set_reactor_count(size_t count);
+size_t bal_get_reactor_count(void);
+bool bal_set_reactor(bal_socket* s, size_t reactor);
+
 bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask);
 
 bool bal_create(bal_socket** s, uintptr_t user_data, int addr_fam, int type, int proto);
+bool bal_create_ex(bal_socket** s, uintptr_t user_data, int addr_fam, int type, int proto,
+    const bal_socket_opts* opts);
 bool bal_auto_socket(bal_socket** s, uintptr_t user_data, int addr_fam, int proto,
     const char* host, const char* srv);
 void bal_destroy(bal_socket** s);
@@ -53,8 +62,27 @@ bool bal_connect(bal_socket* s, const char* host, const char* port);
 bool bal_connect_addrlist(bal_socket* s, bal_addrlist* al);
 
 ssize_t bal_send(const bal_socket* s, const void* data, bal_iolen len, int flags);
+ssize_t bal_sendv(const bal_socket* s, const bal_iovec* iov, size_t count, int flags);
 ssize_t bal_recv(const bal_socket* s, void* data, bal_iolen len, int flags);
 
+bool bal_send_async(bal_socket* s, const void* data, bal_iolen len, bal_free_cb free_cb);
+size_t bal_get_send_pending(const bal_socket* s);
+bool bal_set_send_watermarks(bal_socket* s, size_t high, size_t low);
+bool bal_get_send_watermarks(const bal_socket* s, size_t* high, size_t* low);
+
+bool bal_pause_read(bal_socket* s);
+bool bal_resume_read(bal_socket* s);
+bool bal_is_read_paused(const bal_socket* s);
+
+bool bal_async_recv(bal_socket* s, bal_data_cb on_data);
+
+bool bal_set_framing(bal_socket* s, const bal_framing* framing);
+bool bal_async_frames(bal_socket* s, bal_frame_cb on_frame);
+bool bal_send_frame(bal_socket* s, const void* data, size_t len);
+bool bal_async_lines(bal_socket* s, bal_frame_cb on_line, char delim, uint32_t flags);
+
+uint32_t bal_crc32c(uint32_t crc, const void* data, size_t len);
+
 ssize_t bal_sendto(const bal_socket* s, const char* host, const char* port, const void* data,
     bal_iolen len, int flags);
 ssize_t bal_sendto_addr(const bal_socket* s, const bal_sockaddr* sa, const void* data,
@@ -66,7 +94,18 @@ bool bal_bind(const bal_socket* s, const char* addr, const char* srv);
 bool bal_bindall(const bal_socket* s, const char* srv);
 
 bool bal_listen(bal_socket* s, int backlog);
+bool bal_listen_sharded(bal_socket** socks, size_t count, int addr_fam,
+    const char* addr, const char* srv, int backlog, uint32_t flags);
 bool bal_accept(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr);
+bool bal_accept_ex(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr,
+    const bal_socket_opts* opts);
+/* these accept up to `max` connections from a non-blocking listener, stopping
+ * when the backlog is empty; a blocking listener blocks for one connection,
+ * and yields at most that one. */
+ssize_t bal_accept_many(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddrs,
+    size_t max);
+ssize_t bal_accept_many_async(const bal_socket* s, bal_socket** res,
+    bal_sockaddr* resaddrs, size_t max, bal_async_cb proc, uint32_t mask);
 
 bool bal_get_option(const bal_socket* s, int level, int name, void* optval, socklen_t len);
 bool bal_set_option(const bal_socket* s, int level, int name, const void* optval, socklen_t len);
@@ -107,9 +146,12 @@ size_t bal_get_recvqueue_size(const bal_socket* s);
 int bal_get_sock_error(const bal_socket* s);
 int bal_get_error(bal_error* err);
 int bal_get_error_ext(bal_error* err);
+int bal_get_error_codes(bal_error_codes* codes);
+int bal_format_error(const bal_error_codes* codes, bal_error* err);
 
 bool bal_is_readable(const bal_socket* s);
 bool bal_is_writable(const bal_socket* s);
+ssize_t bal_check_readiness(bal_socket** socks, uint32_t* out, size_t n, int timeout_ms);
 bool bal_is_listening(const bal_socket* s);
 
 bool bal_resolve_host(const char* host, bal_addrlist* out);
@@ -123,21 +165,47 @@ bool bal_reset_addrlist(bal_addrlist* addrs);
 const bal_sockaddr* bal_enum_addrlist(bal_addrlist* addrs);
 bool bal_free_addrlist(bal_addrlist* addrs);
 
+bool bal_get_slab_stats(bal_slab_stats* out);
+bool bal_get_recv_pool_stats(bal_slab_stats* out);
+
+bool bal_set_recv_idle_reclaim(uint32_t msec);
+uint32_t bal_get_recv_idle_reclaim(void);
+
+bool bal_get_stats(bal_stats* out);
+bool bal_get_reactor_stats(size_t reactor, bal_reactor_stats* out);
+bool bal_get_socket_stats(const bal_socket* s, bal_socket_stats* out);
+
+bool bal_set_histograms(bool enable);
+bool bal_get_histograms(bal_loop_histograms* out, bool reset);
+bool bal_get_reactor_histograms(size_t reactor, bal_loop_histograms* out, bool reset);
+uint64_t bal_histogram_percentile(const bal_histogram* h, double percentile);
+
 void bal_thread_yield(void);
 void bal_sleep_msec(uint32_t msec);
 
 static inline
 void bal_addtomask(bal_socket* s, uint32_t bits)
 {
-    if (_bal_okptr(s))
+    if (_bal_okptr(s)) {
+        /* write events now belong to the caller, even if the send queue
+         * added BAL_EVT_WRITE first. */
+        if (bal_isbitset(bits, BAL_EVT_WRITE))
+            bal_setbitslow(&s->state.bits, BAL_S_SENDQ);
         bal_setbitshigh(&s->state.mask, bits);
+    }
 }
 
 static inline
 void bal_remfrommask(bal_socket* s, uint32_t bits)
 {
-    if (_bal_okptr(s))
+    if (_bal_okptr(s)) {
+        /* BAL_EVT_WRITE stays while bal_send_async has data queued. */
+        if (bal_isbitset(bits, BAL_EVT_WRITE) && NULL != s->state.sendq.head) {
+            bal_setbitshigh(&s->state.bits, BAL_S_SENDQ);
+            bal_setbitslow(&bits, BAL_EVT_WRITE);
+        }
         bal_setbitslow(&s->state.mask, bits);
+    }
 }
 
 static inline
@@ -146,6 +214,18 @@ bool bal_bitsinmask(const bal_socket* s, uint32_t bits)
     return _bal_okptr(s) ? bal_isbitset(s->state.mask, bits) : false;
 }
 
+static inline
+void bal_setiovec(bal_iovec* iov, const void* data, size_t len)
+{
+# if defined(__WIN__)
+    iov->buf = (CHAR*)data;
+    iov->len = (ULONG)len;
+# else
+    iov->iov_base = (void*)data;
+    iov->iov_len  = len;
+# endif
+}
+
 # if defined(__cplusplus)
 }
 # endif
@@ -33,8 +33,14 @@
 # include <cstdlib>
 # include <cstring>
 # include <vector>
+# include <deque>
+# include <array>
+# include <algorithm>
 # include <atomic>
+# include <limits>
+# include <memory>
 # include <string>
+# include <utility>
 # include <version>
 
 # if defined(__has_include)
@@ -48,6 +54,16 @@
 #  define source_location std::source_location
 # endif
 
+# if defined(__cpp_impl_coroutine) && __HAS_INCLUDE(<coroutine>)
+#  include <coroutine>
+#  define __HAVE_COROUTINES__
+# endif
+
+# if defined(__cpp_lib_ranges) && __HAS_INCLUDE(<ranges>)
+#  include <ranges>
+#  define __HAVE_RANGES__
+# endif
+
 # if defined(__cpp_lib_bit_cast) && __HAS_INCLUDE(<bit>)
 #  include <bit>
 #  define bit_cast std::bit_cast
@@ -182,6 +198,75 @@ namespace bal
         }
     };
 
+    /** The outcome of an operation under result_policy: the operation's
+     * return value, and if it failed, the codes of the error (no message is
+     * formatted unless get_error is called). */
+    template<typename T>
+    class result
+    {
+    public:
+        result(const T& value) noexcept : _value(value) { } // NOLINT: implicit
+        result(const T& value, const bal_error_codes& err) noexcept
+            : _value(value), _err(err) { }
+
+        /** Fails with the last error that occurred on this thread. */
+        static result from_last_error(const T& value) noexcept
+        {
+            bal_error_codes err {};
+            [[maybe_unused]] auto unused = bal_get_error_codes(&err);
+            return from_error_codes(value, err);
+        }
+
+        /** Fails with `err` (captured earlier, e.g. on another thread). */
+        static result from_error_codes(const T& value, bal_error_codes err) noexcept
+        {
+            if (err.code <= BAL_E_NOERROR) {
+                err.code = BAL_E_UNKNOWN;
+            }
+            return {value, err};
+        }
+
+        bool has_value() const noexcept { return 0 == _err.code; }
+        explicit operator bool() const noexcept { return has_value(); }
+
+        /** The return value, which is only meaningful if has_value(). */
+        const T& operator*() const noexcept { return _value; }
+
+        const T& value() const
+        {
+            if (!has_value()) {
+                throw exception(get_error());
+            }
+            return _value;
+        }
+
+        T value_or(const T& other) const noexcept
+        {
+            return has_value() ? _value : other;
+        }
+
+        /** The libbal error code (BAL_E_*), or 0 on success. */
+        int error_code() const noexcept { return _err.code; }
+
+        /** The OS error code (e.g. ECONNREFUSED), if error_code() is
+         * BAL_E_PLATFORM; otherwise 0. */
+        int os_error_code() const noexcept { return _err.os_code; }
+
+        const bal_error_codes& get_error_codes() const noexcept { return _err; }
+
+        /** Formats the error's message. */
+        error get_error() const
+        {
+            bal_error err {};
+            [[maybe_unused]] auto unused = bal_format_error(&_err, &err);
+            return {_err.code, err.message};
+        }
+
+    private:
+        T _value {};
+        bal_error_codes _err {};
+    };
+
     class policy
     {
     protected:
@@ -192,6 +277,10 @@ namespace bal
         static constexpr bool throw_on_error() noexcept {
             return true;
         }
+
+        /** What an operation returning T returns under this policy. */
+        template<typename T>
+        using result_type = T;
     };
 
     class default_policy : public policy
@@ -201,15 +290,37 @@ namespace bal
         ~default_policy() override = default;
     };
 
+    /** Operations return result<T> instead of throwing, so expected failures
+     * (e.g. a refused connection, or EAGAIN) cost neither an exception nor a
+     * formatted message. */
+    class result_policy : public policy
+    {
+    public:
+        result_policy() = default;
+        ~result_policy() override = default;
+
+        static constexpr bool throw_on_error() noexcept {
+            return false;
+        }
+
+        template<typename T>
+        using result_type = result<T>;
+    };
+
     template<class T>
     concept DerivedFromPolicy = std::derived_from<T, policy>;
 
     template<DerivedFromPolicy TPolicy, typename T>
-    inline T throw_on_policy(const T& value, const T& invalid)
+    using policy_result = typename TPolicy::template result_type<T>;
+
+    template<DerivedFromPolicy TPolicy, typename T>
+    inline policy_result<TPolicy, T> throw_on_policy(const T& value, const T& invalid)
     {
         if (value == invalid) {
             if constexpr(TPolicy::throw_on_error()) {
                 throw exception(error::from_last_error());
+            } else if constexpr(std::is_same_v<policy_result<TPolicy, T>, result<T>>) {
+                return result<T>::from_last_error(value);
             }
         }
         return value;
@@ -225,6 +336,13 @@ namespace bal
             }
         }
 
+        explicit initializer(size_t reactors)
+        {
+            if (!bal_isinitialized() && (!bal_set_reactor_count(reactors) || !bal_init())) {
+                throw exception(error::from_last_error());
+            }
+        }
+
         initializer(const initializer&) = delete;
         initializer(initializer&&) = delete;
 
@@ -237,38 +355,238 @@ namespace bal
         initializer& operator=(initializer&&) = delete;
     };
 
-    template<bool RAII, DerivedFromPolicy TPolicy>
-    class socket_base
+# if defined(__HAVE_RANGES__)
+    /** A contiguous range of trivially copyable elements (std::span,
+     * std::array, std::vector, std::string, a plain array...), which can be
+     * sent or received as-is. */
+    template<class T>
+    concept ContiguousBuffer = std::ranges::contiguous_range<T>
+        && std::ranges::sized_range<T>
+        && std::is_trivially_copyable_v<std::ranges::range_value_t<T>>;
+# endif
+
+    /** A chain of reference-counted slices of memory, which can be appended,
+     * split and consumed without copying the bytes; sending one maps onto
+     * vectored I/O (bal_sendv). Each slice keeps its owner alive for as long as
+     * it is in a chain. */
+    class iobuf
     {
     public:
-        using async_io_cb = std::function<bool(socket_base*)>;
+        iobuf() = default;
 
-        socket_base()
+        static iobuf copy(const void* data, size_t len)
         {
-            set_default_event_handlers();
+            iobuf buf;
+            if (len > 0UL) {
+                std::shared_ptr<char[]> owner = std::make_shared<char[]>(len);
+                memcpy(owner.get(), data, len);
+                buf.append(owner, owner.get(), len);
+            }
+            return buf;
         }
 
-        socket_base(const socket_base&) = delete;
+        /** Appends `len` bytes at `data`, which belong to (and must stay valid
+         * for as long as) `owner`. */
+        void append(std::shared_ptr<const void> owner, const void* data, size_t len)
+        {
+            if (len > 0UL) {
+                _slices.push_back({std::move(owner), static_cast<const char*>(data), len});
+                _size += len;
+            }
+        }
 
-        socket_base(socket_base&& other) noexcept
+        void append(const std::shared_ptr<const std::string>& str)
+        {
+            append(str, str->data(), str->size());
+        }
+
+        /** Appends the slices of `other`, sharing their owners. */
+        void append(const iobuf& other)
+        {
+            _slices.insert(_slices.end(), other._slices.begin(), other._slices.end());
+            _size += other._size;
+        }
+
+        /** Removes the first `len` bytes (or all of them) and returns them as a
+         * new chain. */
+        iobuf split(size_t len)
+        {
+            iobuf front;
+            len = std::min(len, _size);
+            while (len > 0UL) {
+                auto& first = _slices.front();
+                if (first.len <= len) {
+                    len -= first.len;
+                    front._size += first.len;
+                    _size -= first.len;
+                    front._slices.push_back(std::move(first));
+                    _slices.pop_front();
+                } else {
+                    front._slices.push_back({first.owner, first.data, len});
+                    front._size += len;
+                    first.data += len;
+                    first.len  -= len;
+                    _size      -= len;
+                    len = 0UL;
+                }
+            }
+            return front;
+        }
+
+        /** Discards the first `len` bytes (or all of them). */
+        void consume(size_t len)
+        {
+            len = std::min(len, _size);
+            _size -= len;
+            while (len > 0UL) {
+                auto& first = _slices.front();
+                if (first.len <= len) {
+                    len -= first.len;
+                    _slices.pop_front();
+                } else {
+                    first.data += len;
+                    first.len  -= len;
+                    len = 0UL;
+                }
+            }
+        }
+
+        void clear() noexcept
+        {
+            _slices.clear();
+            _size = 0UL;
+        }
+
+        size_t size() const noexcept
+        {
+            return _size;
+        }
+
+        bool empty() const noexcept
+        {
+            return 0UL == _size;
+        }
+
+        size_t slice_count() const noexcept
+        {
+            return _slices.size();
+        }
+
+        /** Fills up to `max` entries of `iov` with the leading slices; returns
+         * the number filled. */
+        size_t fill_iovec(bal_iovec* iov, size_t max) const noexcept
+        {
+            const size_t count = std::min(max, _slices.size());
+            for (size_t n = 0UL; n < count; n++) {
+                bal_setiovec(&iov[n], _slices[n].data, _slices[n].len);
+            }
+            return count;
+        }
+
+        /** Copies the contents into a contiguous string (e.g. for logging). */
+        std::string to_string() const
+        {
+            std::string str;
+            str.reserve(_size);
+            for (const auto& slice : _slices) {
+                str.append(slice.data, slice.len);
+            }
+            return str;
+        }
+
+    private:
+        struct slice
+        {
+            std::shared_ptr<const void> owner;
+            const char* data = nullptr;
+            size_t len = 0UL;
+        };
+
+        std::deque<slice> _slices;
+        size_t _size = 0UL;
+    };
+
+# if defined(__HAVE_COROUTINES__)
+    /** A coroutine that starts running at once and is never awaited (e.g. one
+     * per connection); its frame is freed when it finishes. */
+    class task
+    {
+    public:
+        struct promise_type
+        {
+            task get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept { }
+
+            void unhandled_exception() noexcept
+            {
+                try {
+                    throw;
+                } catch (bal::exception& ex) {
+                    _bal_dbglog("error: caught exception: '%s'!", ex.what());
+                } catch (...) {
+                    std::terminate();
+                }
+            }
+        };
+    };
+
+    /** An I/O operation a coroutine is suspended on. It lives in the
+     * coroutine's frame, and is parked with the socket until one of `events`
+     * arrives and `complete` returns true. */
+    struct io_op
+    {
+        uint32_t events = 0U;
+        bool (*complete)(io_op* op, uint32_t events) = nullptr;
+        std::coroutine_handle<> waiter {};
+    };
+# endif
+
+    /** The operations common to every socket type. TDerived supplies the
+     * event handlers, by way of _dispatch_io, _dispatch_data, _dispatch_frame,
+     * _dispatch_line and default_event_mask (see socket_base and
+     * static_socket). */
+    template<class TDerived, bool RAII, DerivedFromPolicy TPolicy>
+    class basic_socket
+    {
+    public:
+        /** What an operation returning T returns under TPolicy. */
+        template<typename T>
+        using result_type = policy_result<TPolicy, T>;
+
+        basic_socket() = default;
+        basic_socket(const basic_socket&) = delete;
+
+        basic_socket(basic_socket&& other) noexcept
         {
-            *this = other;
+            *this = std::move(other);
         }
 
-        socket_base(int addr_fam, int type, int proto) requires RAII : socket_base()
+        /* the creating constructors throw if creation fails under a throwing
+         * policy; under any other (e.g. result_policy), a failure leaves the
+         * socket invalid, so check is_valid(). */
+        basic_socket(int addr_fam, int type, int proto) requires RAII
         {
             [[maybe_unused]]
             auto unused = create(addr_fam, type, proto);
         }
 
-        socket_base(int addr_fam, int proto, const std::string& host,
-            const std::string& srv) requires RAII : socket_base()
+        basic_socket(int addr_fam, int type, int proto, const bal_socket_opts& opts)
+            requires RAII
+        {
+            [[maybe_unused]]
+            auto unused = create(addr_fam, type, proto, opts);
+        }
+
+        basic_socket(int addr_fam, int proto, const std::string& host,
+            const std::string& srv) requires RAII
         {
             [[maybe_unused]]
             auto unused = create(addr_fam, proto, host, srv);
         }
 
-        virtual ~socket_base()
+        virtual ~basic_socket()
         {
             if constexpr(RAII) {
                 if (is_valid()) {
@@ -278,26 +596,16 @@ namespace bal
             }
         }
 
-        socket_base& operator=(socket_base&) = delete;
+        basic_socket& operator=(basic_socket&) = delete;
 
-        socket_base& operator=(socket_base&& rhs) noexcept
+        basic_socket& operator=(basic_socket&& rhs) noexcept
         {
+# if defined(__HAVE_COROUTINES__)
+            /* a suspended coroutine would be left waiting on the old object. */
+            BAL_ASSERT(nullptr == rhs._read_op.load() && nullptr == rhs._write_op.load());
+# endif
             [[maybe_unused]] const auto* unused = attach(rhs.detach());
-
-            on_read          = rhs.on_read;
-            on_write         = rhs.on_write;
-            on_connect       = rhs.on_connect;
-            on_conn_fail     = rhs.on_conn_fail;
-            on_incoming_conn = rhs.on_incoming_conn;
-            on_close         = rhs.on_close;
-            on_priority      = rhs.on_priority;
-            on_error         = rhs.on_error;
-            on_invalid       = rhs.on_invalid;
-            on_oob_read      = rhs.on_oob_read;
-            on_oob_write     = rhs.on_oob_write;
-
-            rhs.set_default_event_handlers();
-
+            _registered = std::exchange(rhs._registered, false);
             return *this;
         }
 
@@ -320,6 +628,7 @@ namespace bal
         {
             bal_socket* tmp = _s;
             _s = s;
+            _registered = false;
 
             if (tmp != nullptr) {
                 tmp->user_data = 0;
@@ -338,7 +647,7 @@ namespace bal
             return ret;
         }
 
-        bool create(int addr_fam, int type, int proto)
+        result_type<bool> create(int addr_fam, int type, int proto)
         {
             [[maybe_unused]] const auto* existing = detach();
             BAL_ASSERT(existing == nullptr);
@@ -347,7 +656,16 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool create(int addr_fam, int proto, const std::string& host,
+        result_type<bool> create(int addr_fam, int type, int proto, const bal_socket_opts& opts)
+        {
+            [[maybe_unused]] const auto* existing = detach();
+            BAL_ASSERT(existing == nullptr);
+
+            const auto ret = bal_create_ex(&_s, to_user_data(), addr_fam, type, proto, &opts);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> create(int addr_fam, int proto, const std::string& host,
             const std::string& srv)
         {
             const auto ret =
@@ -356,254 +674,750 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool close(bool destroy = true)
+        result_type<bool> close(bool destroy = true)
         {
-            if (!is_valid()) {
-                return false;
+            /* under result_policy, an invalid socket fails with BAL_E_BADSOCKET. */
+            if constexpr(!std::is_same_v<result_type<bool>, result<bool>>) {
+                if (!is_valid()) {
+                    return false;
+                }
             }
 
             const auto ret = bal_close(&_s, destroy);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool shutdown(int how)
+        result_type<bool> set_reactor(size_t reactor)
         {
-            const auto ret = bal_shutdown(_s, how);
+            const auto ret = bal_set_reactor(_s, reactor);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool async_poll(uint32_t mask = BAL_EVT_NORMAL)
+        result_type<bool> shutdown(int how)
         {
-            if (!is_valid()) {
-                return false;
-            }
-
-            const auto ret = bal_async_poll(_s, &socket_base::_on_async_io, mask);
+            const auto ret = bal_shutdown(_s, how);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool deregister_async_poll() noexcept
+        result_type<bool> async_poll(uint32_t mask = TDerived::default_event_mask())
         {
-            return is_valid() ? bal_async_poll(_s, nullptr, 0U) : false;
-        }
+            /* under result_policy, an invalid socket fails with BAL_E_BADSOCKET. */
+            if constexpr(!std::is_same_v<result_type<bool>, result<bool>>) {
+                if (!is_valid()) {
+                    return false;
+                }
+            }
 
-        bool connect(const std::string& host, const std::string& port)
-        {
-            const auto ret = bal_connect(_s, host.c_str(), port.c_str());
+            const auto ret = bal_async_poll(_s, &basic_socket::_on_async_io, mask);
+            if (ret) {
+                _registered = 0U != mask;
+            }
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        ssize_t send(const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
-        {
-            const auto ret = bal_send(_s, data, len, flags);
-            return throw_on_policy<TPolicy>(ret, -1L);
-        }
-
-        ssize_t sendto(const std::string& host, const std::string& port,
-            const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
-        {
-            const auto ret =
-                bal_sendto(_s, host.c_str(), port.c_str(), data, len, flags);
-            return throw_on_policy<TPolicy>(ret, -1L);
-        }
-
-        ssize_t recv(void* data, bal_iolen len, int flags) const
-        {
-            const auto ret = bal_recv(_s, data, len, flags);
-            return throw_on_policy<TPolicy>(ret, -1L);
-        }
-
-        ssize_t recvfrom(void* data, bal_iolen len, int flags, address& whence) const
+        /* does nothing unless async_poll registered the socket, so that the
+         * destructors of socket_base and basic_socket may both call it. */
+        bool deregister_async_poll() noexcept
         {
-            whence.clear();
-
-            bal_sockaddr tmp {};
-            const auto ret = bal_recvfrom(_s, data, len, flags, &tmp);
-            if (ret) {
-                whence = tmp;
+            if (!is_valid() || !_registered) {
+                return false;
             }
 
-            return throw_on_policy<TPolicy>(ret, -1L);
+            _registered = false;
+            return bal_async_poll(_s, nullptr, 0U);
         }
 
-        bool bind(const std::string& addr, const std::string& srv) const
+        result_type<bool> async_recv(bool enable = true)
         {
-            const auto ret = bal_bind(_s, addr.c_str(), srv.c_str());
+            const auto ret = bal_async_recv(_s, enable ? &basic_socket::_on_async_data : nullptr);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool bind_all(const std::string& srv) const
+        result_type<bool> set_framing(const bal_framing& framing)
         {
-            const auto ret = bal_bindall(_s, srv.c_str());
+            const auto ret = bal_set_framing(_s, &framing);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool listen(int backlog = SOMAXCONN)
+        result_type<bool> async_frames(bool enable = true)
         {
-            const auto ret = bal_listen(_s, backlog);
+            const auto ret = bal_async_frames(_s, enable ? &basic_socket::_on_async_frame : nullptr);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool accept(socket_base& client_sock, address& client_addr) const
+        result_type<bool> async_lines(bool enable = true, char delim = '\n', uint32_t flags = 0U)
         {
-            [[maybe_unused]] const auto* existing = client_sock.detach();
-            BAL_ASSERT(existing == nullptr);
-
-            client_addr.clear();
-
-            bal_socket* s = nullptr;
-            bal_sockaddr addr {};
-            const auto ret = bal_accept(_s, &s, &addr);
-            if (ret) {
-                [[maybe_unused]] const auto* unused = client_sock.attach(s);
-                client_addr = addr;
-            }
-
+            const auto ret = bal_async_lines(_s, enable ? &basic_socket::_on_async_line : nullptr,
+                delim, flags);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_option(int level, int name, void* optval, socklen_t len) const
+        result_type<bool> send_frame(const void* data, size_t len)
         {
-            const auto ret = bal_get_option(_s, level, name, optval, len);
+            const auto ret = bal_send_frame(_s, data, len);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_option(int level, int name, const void* optval, socklen_t len) const
+        result_type<bool> connect(const std::string& host, const std::string& port)
         {
-            const auto ret = bal_set_option(_s, level, name, optval, len);
+            const auto ret = bal_connect(_s, host.c_str(), port.c_str());
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_broadcast(int* value) const
+        result_type<ssize_t> send(const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
         {
-            const auto ret = bal_get_broadcast(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
+            const auto ret = bal_send(_s, data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
         }
 
-        bool set_broadcast(int value) const
+# if defined(__HAVE_RANGES__)
+        /** Sends the bytes of `buf` (note that a string literal includes its
+         * terminating null). */
+        template<ContiguousBuffer TBuffer>
+        result_type<ssize_t> send(const TBuffer& buf) const
         {
-            const auto ret = bal_set_broadcast(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
+            return send(std::ranges::data(buf), _buffer_len(buf), MSG_NOSIGNAL);
         }
+# endif
 
-        bool get_debug(int* value) const
+        /** Sends as much of `buf` as the socket will take in one call, and
+         * consumes what was sent from it; returns the number of bytes sent. */
+        result_type<ssize_t> send(iobuf& buf, int flags = MSG_NOSIGNAL) const
         {
-            const auto ret = bal_get_debug(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+            if (buf.empty()) {
+                return 0L;
+            }
 
-        bool set_debug(int value) const
-        {
-            const auto ret = bal_set_debug(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
+            std::array<bal_iovec, _iobuf_batch> iov {};
+            const size_t count = buf.fill_iovec(iov.data(), iov.size());
+            const auto ret = bal_sendv(_s, iov.data(), count, flags);
+            if (ret > 0L) {
+                buf.consume(static_cast<size_t>(ret));
+            }
+            return throw_on_policy<TPolicy>(ret, -1L);
         }
 
-        bool get_linger(bal_linger* seconds) const
+        result_type<bool> send_async(const void* data, bal_iolen len, bal_free_cb free_cb = nullptr)
         {
-            const auto ret = bal_get_linger(_s, seconds);
+            const auto ret = bal_send_async(_s, data, len, free_cb);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_linger(bal_linger seconds) const
+        size_t get_send_pending() const noexcept
         {
-            const auto ret = bal_set_linger(_s, seconds);
-            return throw_on_policy<TPolicy>(ret, false);
+            return bal_get_send_pending(_s);
         }
 
-        bool get_keepalive(int* value) const
+        result_type<bool> get_send_watermarks(size_t* high, size_t* low) const
         {
-            const auto ret = bal_get_keepalive(_s, value);
+            const auto ret = bal_get_send_watermarks(_s, high, low);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_keepalive(int value) const
+        result_type<bool> set_send_watermarks(size_t high, size_t low)
         {
-            const auto ret = bal_set_keepalive(_s, value);
+            const auto ret = bal_set_send_watermarks(_s, high, low);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_oobinline(int* value) const
+        result_type<bool> pause_read()
         {
-            const auto ret = bal_get_oobinline(_s, value);
+            const auto ret = bal_pause_read(_s);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_oobinline(int value) const
+        result_type<bool> resume_read()
         {
-            const auto ret = bal_set_oobinline(_s, value);
+            const auto ret = bal_resume_read(_s);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_reuseaddr(int* value) const
+        bool is_read_paused() const noexcept
         {
-            const auto ret = bal_get_reuseaddr(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
+            return bal_is_read_paused(_s);
         }
 
-        bool set_reuseaddr(int value) const
-        {
-            const auto ret = bal_set_reuseaddr(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+# if defined(__HAVE_COROUTINES__)
+        /* awaitables: each tries its operation at once, and only suspends the
+         * coroutine if the socket isn't ready. it is then resumed on the
+         * reactor's thread, from the event that completes the operation. the
+         * socket must be registered with async_poll, and should have no
+         * on_close/on_error handlers that would close it behind the coroutine's
+         * back; a socket can have one receive (or accept) and one send (or
+         * connect) pending at a time. */
 
-        bool get_sendbuf_size(int* value) const
+        class recv_awaiter : public io_op
         {
-            const auto ret = bal_get_sendbuf_size(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+        public:
+            recv_awaiter(basic_socket* sock, void* data, bal_iolen len) noexcept
+                : _sock(sock), _data(data), _len(len)
+            {
+                events   = BAL_EVT_READ | BAL_EVT_CLOSE | BAL_EVT_ERROR | BAL_EVT_INVALID;
+                complete = &recv_awaiter::_complete;
+            }
 
-        bool set_sendbuf_size(int value) const
-        {
-            const auto ret = bal_set_sendbuf_size(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+            bool await_ready() noexcept
+            {
+                return _try_recv();
+            }
 
-        bool get_recvbuf_size(int* value) const
-        {
-            const auto ret = bal_get_recvbuf_size(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                waiter = handle;
+                _sock->_park(_sock->_read_op, this, BAL_EVT_READ);
+            }
 
-        bool set_recvbuf_size(int value) const
-        {
-            const auto ret = bal_set_recvbuf_size(_s, value);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+            /** Returns the number of bytes read, or zero if the peer closed the
+             * connection. */
+            result_type<ssize_t> await_resume()
+            {
+                return throw_on_policy<TPolicy>(_result, -1L);
+            }
 
-        bool get_send_timeout(bal_tvsec* sec, bal_tvusec* usec) const
-        {
-            const auto ret = bal_get_send_timeout(_s, sec, usec);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+        private:
+            bool _try_recv() noexcept
+            {
+                _result = bal_recv(_sock->_s, _data, _len, 0);
+                return -1 != _result || !_sock->is_valid() || !_bal_would_block();
+            }
 
-        bool set_send_timeout(bal_tvsec sec, bal_tvusec usec) const
-        {
-            const auto ret = bal_set_send_timeout(_s, sec, usec);
-            return throw_on_policy<TPolicy>(ret, false);
-        }
+            static bool _complete(io_op* op, uint32_t) noexcept
+            {
+                return static_cast<recv_awaiter*>(op)->_try_recv();
+            }
 
-        bool get_recv_timeout(bal_tvsec* sec, bal_tvusec* usec) const
+            basic_socket* _sock = nullptr;
+            void* _data        = nullptr;
+            bal_iolen _len     = 0;
+            ssize_t _result    = -1;
+        };
+
+        class send_awaiter : public io_op
+        {
+        public:
+            send_awaiter(basic_socket* sock, const void* data, size_t len) noexcept
+                : _sock(sock), _data(static_cast<const char*>(data)), _len(len)
+            {
+                events   = BAL_EVT_WRITE | BAL_EVT_CLOSE | BAL_EVT_ERROR | BAL_EVT_INVALID;
+                complete = &send_awaiter::_complete;
+            }
+
+            bool await_ready() noexcept
+            {
+                return _try_send();
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                waiter = handle;
+                _added_write = !bal_bitsinmask(_sock->_s, BAL_EVT_WRITE);
+                _sock->_park(_sock->_write_op, this, BAL_EVT_WRITE);
+            }
+
+            /** Returns true once all of the data has been sent. */
+            result_type<bool> await_resume()
+            {
+                return throw_on_policy<TPolicy>(!_failed, false);
+            }
+
+        private:
+            bool _try_send() noexcept
+            {
+                constexpr size_t max_chunk = std::numeric_limits<bal_iolen>::max();
+
+                while (_sent < _len) {
+                    const auto chunk = static_cast<bal_iolen>(std::min(_len - _sent, max_chunk));
+                    const auto sent  = bal_send(_sock->_s, _data + _sent, chunk, MSG_NOSIGNAL);
+                    if (sent > 0) {
+                        _sent += static_cast<size_t>(sent);
+                    } else if (-1 == sent && _sock->is_valid() && _bal_would_block()) {
+                        return false;
+                    } else {
+                        _failed = true;
+                        break;
+                    }
+                }
+
+                return true;
+            }
+
+            static bool _complete(io_op* op, uint32_t) noexcept
+            {
+                auto* self = static_cast<send_awaiter*>(op);
+                if (!self->_try_send()) {
+                    return false;
+                }
+
+                if (self->_added_write) {
+                    bal_remfrommask(self->_sock->_s, BAL_EVT_WRITE);
+                }
+                return true;
+            }
+
+            basic_socket* _sock = nullptr;
+            const char* _data  = nullptr;
+            size_t _len        = 0;
+            size_t _sent       = 0;
+            bool _failed       = false;
+            bool _added_write  = false;
+        };
+
+        class connect_awaiter : public io_op
+        {
+        public:
+            connect_awaiter(basic_socket* sock, const char* host, const char* port) noexcept
+                : _sock(sock), _host(host), _port(port)
+            {
+                events   = BAL_EVT_CONNECT | BAL_EVT_CONNFAIL;
+                complete = &connect_awaiter::_complete;
+            }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                waiter = handle;
+
+                /* parked first: the connect may complete before bal_connect
+                 * returns, after which this frame can't be touched. */
+                basic_socket* sock = _sock;
+                sock->_park(sock->_write_op, this, BAL_EVT_CONNECT | BAL_EVT_CONNFAIL);
+                if (bal_connect(sock->_s, _host, _port)) {
+                    return true;
+                }
+
+                /* nothing will complete a connect that failed to start. */
+                io_op* expected = this;
+                [[maybe_unused]] const auto reclaimed =
+                    sock->_write_op.compare_exchange_strong(expected, nullptr);
+                BAL_ASSERT(reclaimed);
+                _failed = true;
+                return false;
+            }
+
+            /** Returns true if the connection was established, or false if it
+             * was refused or timed out (under result_policy, a failed result
+             * carrying the socket's error, e.g. ECONNREFUSED). */
+            result_type<bool> await_resume()
+            {
+                if (_failed) {
+                    return throw_on_policy<TPolicy>(false, false);
+                }
+                if constexpr(std::is_same_v<result_type<bool>, result<bool>>) {
+                    if (!_connected) {
+                        return result<bool>::from_error_codes(false, _err);
+                    }
+                }
+                return _connected;
+            }
+
+        private:
+            static bool _complete(io_op* op, uint32_t events) noexcept
+            {
+                auto* self       = static_cast<connect_awaiter*>(op);
+                self->_connected = bal_isbitset(events, BAL_EVT_CONNECT);
+                if (!self->_connected) {
+                    /* the events thread has just recorded SO_ERROR as its last
+                     * error. */
+                    [[maybe_unused]] auto unused = bal_get_error_codes(&self->_err);
+                }
+                return true;
+            }
+
+            basic_socket* _sock = nullptr;
+            const char* _host  = nullptr;
+            const char* _port  = nullptr;
+            bal_error_codes _err {};
+            bool _connected    = false;
+            bool _failed       = false;
+        };
+
+        template<class TClient>
+        class accept_awaiter : public io_op
+        {
+        public:
+            accept_awaiter(basic_socket* sock, TClient& client_sock,
+                address& client_addr) noexcept
+                : _sock(sock), _client_sock(client_sock), _client_addr(client_addr)
+            {
+                events   = BAL_EVT_ACCEPT | BAL_EVT_ERROR | BAL_EVT_INVALID;
+                complete = &accept_awaiter::_complete;
+            }
+
+            bool await_ready() noexcept
+            {
+                return _try_accept();
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                waiter = handle;
+                _sock->_park(_sock->_read_op, this, BAL_EVT_ACCEPT);
+            }
+
+            /** Returns true once `client_sock` holds the accepted connection. */
+            result_type<bool> await_resume()
+            {
+                return throw_on_policy<TPolicy>(_accepted, false);
+            }
+
+        private:
+            bool _try_accept() noexcept
+            {
+                bal_socket* s = nullptr;
+                bal_sockaddr addr {};
+                if (bal_accept(_sock->_s, &s, &addr)) {
+                    [[maybe_unused]] const auto* existing = _client_sock.attach(s);
+                    BAL_ASSERT(existing == nullptr);
+                    _client_addr = addr;
+                    _accepted    = true;
+                    return true;
+                }
+
+                return !_sock->is_valid() || !_bal_would_block();
+            }
+
+            static bool _complete(io_op* op, uint32_t) noexcept
+            {
+                return static_cast<accept_awaiter*>(op)->_try_accept();
+            }
+
+            basic_socket* _sock = nullptr;
+            TClient& _client_sock;
+            address& _client_addr;
+            bool _accepted = false;
+        };
+
+        /** co_await: receives up to `len` bytes. */
+        recv_awaiter async_recv(void* data, bal_iolen len) noexcept
+        {
+            return {this, data, len};
+        }
+
+        /** co_await: sends all `len` bytes, suspending whenever the socket
+         * can't take more (don't mix with send_async). */
+        send_awaiter async_send_all(const void* data, size_t len) noexcept
+        {
+            return {this, data, len};
+        }
+
+# if defined(__HAVE_RANGES__)
+        /** co_await: receives up to the size of `buf` into it. */
+        template<ContiguousBuffer TBuffer>
+        recv_awaiter async_recv(TBuffer& buf) noexcept
+        {
+            return {this, std::ranges::data(buf), _buffer_len(buf)};
+        }
+
+        /** co_await: sends all of `buf` (which must outlive the co_await
+         * expression). */
+        template<ContiguousBuffer TBuffer>
+        send_awaiter async_send_all(const TBuffer& buf) noexcept
+        {
+            return {this, std::ranges::data(buf), static_cast<size_t>(_buffer_len(buf))};
+        }
+# endif
+
+        /** co_await: connects to `host`:`port` (which must outlive the
+         * co_await expression). */
+        connect_awaiter async_connect(const std::string& host, const std::string& port) noexcept
+        {
+            return {this, host.c_str(), port.c_str()};
+        }
+
+        /** co_await: accepts a connection into `client_sock`. */
+        template<class TClient = TDerived>
+        accept_awaiter<TClient> async_accept(TClient& client_sock, address& client_addr) noexcept
+        {
+            return {this, client_sock, client_addr};
+        }
+# endif
+
+        result_type<ssize_t> sendto(const std::string& host, const std::string& port,
+            const void* data, bal_iolen len, int flags = MSG_NOSIGNAL) const
+        {
+            const auto ret =
+                bal_sendto(_s, host.c_str(), port.c_str(), data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        result_type<ssize_t> recv(void* data, bal_iolen len, int flags) const
+        {
+            const auto ret = bal_recv(_s, data, len, flags);
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+# if defined(__HAVE_RANGES__)
+        /** Receives up to the size of `buf` into it. */
+        template<ContiguousBuffer TBuffer>
+        result_type<ssize_t> recv(TBuffer& buf) const
+            requires (!std::is_const_v<std::remove_reference_t<std::ranges::range_reference_t<TBuffer>>>)
+        {
+            return recv(std::ranges::data(buf), _buffer_len(buf), 0);
+        }
+# endif
+
+        result_type<ssize_t> recvfrom(void* data, bal_iolen len, int flags, address& whence) const
+        {
+            whence.clear();
+
+            bal_sockaddr tmp {};
+            const auto ret = bal_recvfrom(_s, data, len, flags, &tmp);
+            if (ret) {
+                whence = tmp;
+            }
+
+            return throw_on_policy<TPolicy>(ret, -1L);
+        }
+
+        result_type<bool> bind(const std::string& addr, const std::string& srv) const
+        {
+            const auto ret = bal_bind(_s, addr.c_str(), srv.c_str());
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> bind_all(const std::string& srv) const
+        {
+            const auto ret = bal_bindall(_s, srv.c_str());
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> listen(int backlog = SOMAXCONN)
+        {
+            const auto ret = bal_listen(_s, backlog);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        template<class TClient = TDerived>
+        result_type<bool> accept(TClient& client_sock, address& client_addr) const
+        {
+            [[maybe_unused]] const auto* existing = client_sock.detach();
+            BAL_ASSERT(existing == nullptr);
+
+            client_addr.clear();
+
+            bal_socket* s = nullptr;
+            bal_sockaddr addr {};
+            const auto ret = bal_accept(_s, &s, &addr);
+            if (ret) {
+                [[maybe_unused]] const auto* unused = client_sock.attach(s);
+                client_addr = addr;
+            }
+
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        template<class TClient = TDerived>
+        result_type<bool> accept(TClient& client_sock, address& client_addr,
+            const bal_socket_opts& opts) const
+        {
+            [[maybe_unused]] const auto* existing = client_sock.detach();
+            BAL_ASSERT(existing == nullptr);
+
+            client_addr.clear();
+
+            bal_socket* s = nullptr;
+            bal_sockaddr addr {};
+            const auto ret = bal_accept_ex(_s, &s, &addr, &opts);
+            if (ret) {
+                [[maybe_unused]] const auto* unused = client_sock.attach(s);
+                client_addr = addr;
+            }
+
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        /* accepts at most one connection per call if the socket is blocking
+         * (see bal_accept_many). */
+        template<typename TFunc>
+        result_type<ssize_t> accept_many(size_t max, TFunc&& on_accepted) const
+        {
+            constexpr size_t batch = 16;
+            std::array<bal_socket*, batch> socks {};
+            std::array<bal_sockaddr, batch> addrs {};
+
+            ssize_t total = 0;
+            while (static_cast<size_t>(total) < max) {
+                const auto want = std::min(max - static_cast<size_t>(total), batch);
+                const auto ret  = bal_accept_many(_s, socks.data(), addrs.data(), want);
+                if (-1 == ret) {
+                    if (0 == total) {
+                        total = -1;
+                    }
+                    break;
+                }
+
+                ssize_t n = 0;
+                try {
+                    for (; n < ret; n++) {
+                        TDerived client_sock;
+                        [[maybe_unused]] const auto* unused = client_sock.attach(socks[n]);
+                        address client_addr {};
+                        client_addr = addrs[n];
+                        on_accepted(client_sock, client_addr);
+                    }
+                } catch (...) {
+                    /* the sockets not yet handed to on_accepted would leak. */
+                    for (ssize_t k = n + 1; k < ret; k++) {
+                        [[maybe_unused]] auto unused = bal_close(&socks[k], true);
+                    }
+                    throw;
+                }
+
+                total += ret;
+                if (static_cast<size_t>(ret) < want) {
+                    break;
+                }
+            }
+
+            return throw_on_policy<TPolicy>(total, -1L);
+        }
+
+        result_type<bool> get_option(int level, int name, void* optval, socklen_t len) const
+        {
+            const auto ret = bal_get_option(_s, level, name, optval, len);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_option(int level, int name, const void* optval, socklen_t len) const
+        {
+            const auto ret = bal_set_option(_s, level, name, optval, len);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_broadcast(int* value) const
+        {
+            const auto ret = bal_get_broadcast(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_broadcast(int value) const
+        {
+            const auto ret = bal_set_broadcast(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_debug(int* value) const
+        {
+            const auto ret = bal_get_debug(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_debug(int value) const
+        {
+            const auto ret = bal_set_debug(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_linger(bal_linger* seconds) const
+        {
+            const auto ret = bal_get_linger(_s, seconds);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_linger(bal_linger seconds) const
+        {
+            const auto ret = bal_set_linger(_s, seconds);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_keepalive(int* value) const
+        {
+            const auto ret = bal_get_keepalive(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_keepalive(int value) const
+        {
+            const auto ret = bal_set_keepalive(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_oobinline(int* value) const
+        {
+            const auto ret = bal_get_oobinline(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_oobinline(int value) const
+        {
+            const auto ret = bal_set_oobinline(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_reuseaddr(int* value) const
+        {
+            const auto ret = bal_get_reuseaddr(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_reuseaddr(int value) const
+        {
+            const auto ret = bal_set_reuseaddr(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_sendbuf_size(int* value) const
+        {
+            const auto ret = bal_get_sendbuf_size(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_sendbuf_size(int value) const
+        {
+            const auto ret = bal_set_sendbuf_size(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_recvbuf_size(int* value) const
+        {
+            const auto ret = bal_get_recvbuf_size(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_recvbuf_size(int value) const
+        {
+            const auto ret = bal_set_recvbuf_size(_s, value);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_send_timeout(bal_tvsec* sec, bal_tvusec* usec) const
+        {
+            const auto ret = bal_get_send_timeout(_s, sec, usec);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> set_send_timeout(bal_tvsec sec, bal_tvusec usec) const
+        {
+            const auto ret = bal_set_send_timeout(_s, sec, usec);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        result_type<bool> get_recv_timeout(bal_tvsec* sec, bal_tvusec* usec) const
         {
             const auto ret = bal_get_recv_timeout(_s, sec, usec);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_recv_timeout(bal_tvsec sec, bal_tvusec usec) const
+        result_type<bool> set_recv_timeout(bal_tvsec sec, bal_tvusec usec) const
         {
             const auto ret = bal_set_recv_timeout(_s, sec, usec);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool set_io_mode(bool async) const
+        result_type<bool> set_io_mode(bool async) const
         {
             const auto ret = bal_set_io_mode(_s, async);
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        size_t get_recvqueue_size() const
+        result_type<size_t> get_recvqueue_size() const
         {
             const auto ret = bal_get_recvqueue_size(_s);
-            return throw_on_policy<TPolicy>(ret, 0);
+            return throw_on_policy<TPolicy>(ret, size_t {0});
         }
 
         error get_error(bool extended) const
@@ -615,25 +1429,67 @@ namespace bal
                 err.code = bal_get_error(&err);
             }
 
-            return {err.code, err.message};
+            return {err.code, err.message};
+        }
+
+        bool is_readable() const noexcept
+        {
+            return bal_is_readable(_s);
+        }
+
+        bool is_writable() const noexcept
+        {
+            return bal_is_writable(_s);
+        }
+
+        bool is_listening() const noexcept
+        {
+            return bal_is_listening(_s);
+        }
+
+        result_type<bool> get_stats(bal_socket_stats& stats) const
+        {
+            const auto ret = bal_get_socket_stats(_s, &stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static result_type<bool> get_library_stats(bal_stats& stats)
+        {
+            const auto ret = bal_get_stats(&stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static result_type<bool> get_reactor_stats(size_t reactor, bal_reactor_stats& stats)
+        {
+            const auto ret = bal_get_reactor_stats(reactor, &stats);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool is_readable() const noexcept
+        static result_type<bool> set_histograms(bool enable)
         {
-            return bal_is_readable(_s);
+            const auto ret = bal_set_histograms(enable);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool is_writable() const noexcept
+        static result_type<bool> get_histograms(bal_loop_histograms& hist, bool reset = false)
         {
-            return bal_is_writable(_s);
+            const auto ret = bal_get_histograms(&hist, reset);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool is_listening() const noexcept
+        static result_type<bool> get_recv_pool_stats(bal_slab_stats& stats)
         {
-            return bal_is_listening(_s);
+            const auto ret = bal_get_recv_pool_stats(&stats);
+            return throw_on_policy<TPolicy>(ret, false);
+        }
+
+        static result_type<bool> set_recv_idle_reclaim(uint32_t msec)
+        {
+            const auto ret = bal_set_recv_idle_reclaim(msec);
+            return throw_on_policy<TPolicy>(ret, false);
         }
 
-        static bool resolve_host(const std::string& host, address_list& addrs)
+        static result_type<bool> resolve_host(const std::string& host, address_list& addrs)
         {
             addrs.clear();
 
@@ -647,7 +1503,7 @@ namespace bal
             return throw_on_policy<TPolicy>(ret, false);
         }
 
-        bool get_peer_addr(address& peer_addr)
+        result_type<bool> get_peer_addr(address& peer_addr)
         {
             peer_addr.clear();
 
@@ -669,9 +1525,9 @@ namespace bal
             }
         }
 
-        static socket_base* from_user_data(bal_socket* s)
+        static TDerived* from_user_data(bal_socket* s)
         {
-            return bit_cast<socket_base*>(s->user_data);
+            return static_cast<TDerived*>(bit_cast<basic_socket*>(s->user_data));
         }
 
         uintptr_t to_user_data() const
@@ -679,46 +1535,11 @@ namespace bal
             return bit_cast<uintptr_t>(this);
         }
 
-        async_io_cb on_read;
-        async_io_cb on_write;
-        async_io_cb on_connect;
-        async_io_cb on_conn_fail;
-        async_io_cb on_incoming_conn;
-        async_io_cb on_close;
-        async_io_cb on_priority;
-        async_io_cb on_error;
-        async_io_cb on_invalid;
-        async_io_cb on_oob_read;
-        async_io_cb on_oob_write;
-
-        void set_default_event_handlers()
-        {
-            on_read = nullptr;
-            on_write = nullptr;
-            on_connect = nullptr;
-            on_conn_fail = nullptr;
-            on_incoming_conn = nullptr;
-            on_close = [](socket_base* sock)
-            {
-                [[maybe_unused]] const auto closed = sock->close();
-                return false;
-            };
-            on_priority = nullptr;
-            on_error = [](socket_base* sock)
-            {
-                [[maybe_unused]] const auto closed = sock->close();
-                return false;
-            };
-            on_invalid = nullptr;
-            on_oob_read = nullptr;
-            on_oob_write = nullptr;
-        }
-
     protected:
         static void _on_async_io(bal_socket* s, uint32_t events)
         {
             try {
-                socket_base* self = from_user_data(s);
+                TDerived* self = from_user_data(s);
                 BAL_ASSERT(self != nullptr);
 
                 if (self == nullptr) {
@@ -728,91 +1549,531 @@ namespace bal
                     return;
                 }
 
-                auto print_early_return = [s, self](uint32_t evt)
-                {
-# if defined(BAL_DBGLOG)
-                    _bal_dbglog("early return for socket " BAL_SOCKET_SPEC " (0x%"
-                        PRIxPTR ", evt = %08" PRIx32 ", self = 0x%" PRIxPTR ")",
-                        s->sd, bit_cast<uintptr_t>(s), evt, bit_cast<uintptr_t>(self));
-# else
-                    BAL_UNUSED(s);
-                    BAL_UNUSED(self);
-                    BAL_UNUSED(evt);
-# endif
-                };
-
-                if (bal_isbitset(events, BAL_EVT_READ) && self->on_read &&
-                    !self->on_read(self)) {
-                    print_early_return(BAL_EVT_READ);
+# if defined(__HAVE_COROUTINES__)
+                /* a resumed coroutine may have closed or destroyed the socket,
+                 * so its handlers aren't called for the same events. */
+                if (self->_complete_io_ops(events)) {
                     return;
                 }
+# endif
 
-                if (bal_isbitset(events, BAL_EVT_WRITE) && self->on_write &&
-                    !self->on_write(self)) {
-                    print_early_return(BAL_EVT_WRITE);
-                    return;
-                }
+                self->_dispatch_io(events);
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+        }
 
-                if (bal_isbitset(events, BAL_EVT_CONNECT) && self->on_connect &&
-                    !self->on_connect(self)) {
-                    print_early_return(BAL_EVT_CONNECT);
-                    return;
-                }
+        static size_t _on_async_data(bal_socket* s, const void* data, size_t len)
+        {
+            try {
+                TDerived* self = from_user_data(s);
+                BAL_ASSERT(self != nullptr);
 
-                if (bal_isbitset(events, BAL_EVT_CONNFAIL) && self->on_conn_fail &&
-                    !self->on_conn_fail(self)) {
-                    print_early_return(BAL_EVT_CONNFAIL);
-                    return;
+                if (self != nullptr) {
+                    return self->_dispatch_data(data, len);
                 }
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
 
-                if (bal_isbitset(events, BAL_EVT_ACCEPT) && self->on_incoming_conn &&
-                    !self->on_incoming_conn(self)) {
-                    print_early_return(BAL_EVT_ACCEPT);
-                    return;
-                }
+            return 0;
+        }
 
-                if (bal_isbitset(events, BAL_EVT_CLOSE) && self->on_close &&
-                    !self->on_close(self)) {
-                    print_early_return(BAL_EVT_CLOSE);
-                    return;
-                }
+        static void _on_async_frame(bal_socket* s, const void* data, size_t len)
+        {
+            try {
+                TDerived* self = from_user_data(s);
+                BAL_ASSERT(self != nullptr);
 
-                if (bal_isbitset(events, BAL_EVT_PRIORITY) && self->on_priority &&
-                    !self->on_priority(self)) {
-                    print_early_return(BAL_EVT_PRIORITY);
-                    return;
+                if (self != nullptr) {
+                    self->_dispatch_frame(data, len);
                 }
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+        }
 
-                if (bal_isbitset(events, BAL_EVT_ERROR) && self->on_error &&
-                    !self->on_error(self)) {
-                    print_early_return(BAL_EVT_ERROR);
-                    return;
+        static void _on_async_line(bal_socket* s, const void* data, size_t len)
+        {
+            try {
+                TDerived* self = from_user_data(s);
+                BAL_ASSERT(self != nullptr);
+
+                if (self != nullptr) {
+                    self->_dispatch_line(data, len);
                 }
+            } catch (bal::exception& ex) {
+                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+        }
 
-                if (bal_isbitset(events, BAL_EVT_INVALID) && self->on_invalid &&
-                    !self->on_invalid(self)) {
-                    print_early_return(BAL_EVT_INVALID);
-                    return;
+    private:
+        /* the most slices of an iobuf passed to bal_sendv in one call. */
+        static constexpr size_t _iobuf_batch = 64UL;
+
+# if defined(__HAVE_RANGES__)
+        template<ContiguousBuffer TBuffer>
+        static bal_iolen _buffer_len(const TBuffer& buf) noexcept
+        {
+            return static_cast<bal_iolen>(std::ranges::size(buf)
+                * sizeof(std::ranges::range_value_t<TBuffer>));
+        }
+# endif
+
+# if defined(__HAVE_COROUTINES__)
+        void _park(std::atomic<io_op*>& slot, io_op* op, uint32_t bits) noexcept
+        {
+            [[maybe_unused]] const auto* pending = slot.exchange(op, std::memory_order_acq_rel);
+            BAL_ASSERT(nullptr == pending);
+            if (!bal_bitsinmask(_s, bits)) {
+                bal_addtomask(_s, bits);
+            }
+        }
+
+        /* completes (and then resumes) the coroutines whose operations these
+         * events finish; returns true if any were resumed. */
+        bool _complete_io_ops(uint32_t events) noexcept
+        {
+            std::array<std::coroutine_handle<>, 2> ready {};
+            size_t count = 0;
+
+            for (auto* slot : {&_read_op, &_write_op}) {
+                io_op* op = slot->load(std::memory_order_acquire);
+                if (nullptr == op || 0U == (events & op->events) ||
+                    !slot->compare_exchange_strong(op, nullptr, std::memory_order_acq_rel)) {
+                    continue;
                 }
 
-                if (bal_isbitset(events, BAL_EVT_OOBREAD) && self->on_oob_read &&
-                    !self->on_oob_read(self)) {
-                    print_early_return(BAL_EVT_OOBREAD);
-                    return;
+                if (op->complete(op, events)) {
+                    ready.at(count++) = op->waiter;
+                } else {
+                    slot->store(op, std::memory_order_release);
                 }
+            }
 
-                if (bal_isbitset(events, BAL_EVT_OOBWRITE) && self->on_oob_write &&
-                    !self->on_oob_write(self)) {
-                    print_early_return(BAL_EVT_OOBWRITE);
-                    return;
+            for (size_t n = 0; n < count; n++) {
+                ready.at(n).resume();
+            }
+
+            return count > 0;
+        }
+
+        std::atomic<io_op*> _read_op {nullptr};
+        std::atomic<io_op*> _write_op {nullptr};
+# endif
+        bal_socket* _s = nullptr;
+        bool _registered = false;
+    };
+
+    /** Event handlers that any number of sockets can share, rather than each
+     * holding copies of the same closures (see socket_base::set_handlers). A
+     * set is immutable once shared. As with a socket's own handlers, close and
+     * error events close the socket unless those handlers are replaced. */
+    template<class TSocket>
+    struct handler_set
+    {
+        using async_io_cb = std::function<bool(TSocket*)>;
+        using async_data_cb = std::function<size_t(TSocket*, const void*, size_t)>;
+        using async_frame_cb = std::function<void(TSocket*, const void*, size_t)>;
+
+        static bool close_socket(TSocket* sock)
+        {
+            [[maybe_unused]] const auto closed = sock->close();
+            return false;
+        }
+
+        std::shared_ptr<const handler_set> share() &&
+        {
+            return std::make_shared<const handler_set>(std::move(*this));
+        }
+
+        async_io_cb on_read;
+        async_io_cb on_write;
+        async_io_cb on_connect;
+        async_io_cb on_conn_fail;
+        async_io_cb on_incoming_conn;
+        async_io_cb on_close = &handler_set::close_socket;
+        async_io_cb on_priority;
+        async_io_cb on_error = &handler_set::close_socket;
+        async_io_cb on_invalid;
+        async_io_cb on_oob_read;
+        async_io_cb on_oob_write;
+        async_io_cb on_write_blocked;
+        async_io_cb on_write_drained;
+        async_data_cb on_data;
+        async_frame_cb on_frame;
+        async_frame_cb on_line;
+    };
+
+    /** A socket whose event handlers are the std::function members of a
+     * handler_set: its own, which is only allocated once handlers() is called,
+     * and optionally one shared with other sockets (see set_handlers). */
+    template<bool RAII, DerivedFromPolicy TPolicy>
+    class socket_base : public basic_socket<socket_base<RAII, TPolicy>, RAII, TPolicy>
+    {
+        using base = basic_socket<socket_base, RAII, TPolicy>;
+        friend base;
+
+    public:
+        using handlers_type = handler_set<socket_base>;
+        using shared_handlers = std::shared_ptr<const handlers_type>;
+        using async_io_cb = typename handlers_type::async_io_cb;
+        using async_data_cb = typename handlers_type::async_data_cb;
+        using async_frame_cb = typename handlers_type::async_frame_cb;
+
+        socket_base() = default;
+
+        socket_base(const socket_base&) = delete;
+
+        socket_base(socket_base&& other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        socket_base(int addr_fam, int type, int proto) requires RAII
+            : base(addr_fam, type, proto) { }
+
+        socket_base(int addr_fam, int type, int proto, const bal_socket_opts& opts)
+            requires RAII : base(addr_fam, type, proto, opts) { }
+
+        socket_base(int addr_fam, int proto, const std::string& host,
+            const std::string& srv) requires RAII : base(addr_fam, proto, host, srv) { }
+
+        ~socket_base() override
+        {
+            /* before the handlers are destroyed. */
+            if constexpr(RAII) {
+                [[maybe_unused]] auto unused = this->deregister_async_poll();
+            }
+        }
+
+        socket_base& operator=(socket_base&) = delete;
+
+        socket_base& operator=(socket_base&& rhs) noexcept
+        {
+            base::operator=(std::move(rhs));
+
+            _own      = std::move(rhs._own);
+            _handlers = std::move(rhs._handlers);
+
+            return *this;
+        }
+
+        static constexpr uint32_t default_event_mask() noexcept
+        {
+            return BAL_EVT_NORMAL;
+        }
+
+        /** This socket's own handlers, allocated on the first call. Any that
+         * are set take precedence over the shared ones. Without a shared set,
+         * close and error events close the socket unless those handlers are
+         * replaced (or set to nullptr). */
+        handlers_type& handlers()
+        {
+            if (!_own) {
+                _own = std::make_unique<handlers_type>();
+                if (_handlers) {
+                    _own->on_close = nullptr;
+                    _own->on_error = nullptr;
                 }
-            } catch (bal::exception& ex) {
-                _bal_dbglog("error: caught exception: '%s'!", ex.what());
+            }
+
+            return *_own;
+        }
+
+        void set_default_event_handlers() noexcept
+        {
+            _own.reset();
+        }
+
+        /** Shares `handlers` with other sockets; nothing is copied. This
+         * socket's own handlers are released, and any set afterwards take
+         * precedence over the shared ones. */
+        void set_handlers(shared_handlers handlers) noexcept
+        {
+            _own.reset();
+            _handlers = std::move(handlers);
+        }
+
+        const shared_handlers& get_handlers() const noexcept
+        {
+            return _handlers;
+        }
+
+    protected:
+        void _dispatch_io(uint32_t events)
+        {
+            auto print_early_return = [this](uint32_t evt)
+            {
+# if defined(BAL_DBGLOG)
+                _bal_dbglog("early return for socket " BAL_SOCKET_SPEC " (0x%"
+                    PRIxPTR ", evt = %08" PRIx32 ", self = 0x%" PRIxPTR ")",
+                    this->get_descriptor(), bit_cast<uintptr_t>(this->get()), evt,
+                    bit_cast<uintptr_t>(this));
+# else
+                BAL_UNUSED(evt);
+# endif
+            };
+
+            if (bal_isbitset(events, BAL_EVT_READ) &&
+                !_call_io(&handlers_type::on_read)) {
+                print_early_return(BAL_EVT_READ);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WRITE) &&
+                !_call_io(&handlers_type::on_write)) {
+                print_early_return(BAL_EVT_WRITE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CONNECT) &&
+                !_call_io(&handlers_type::on_connect)) {
+                print_early_return(BAL_EVT_CONNECT);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CONNFAIL) &&
+                !_call_io(&handlers_type::on_conn_fail)) {
+                print_early_return(BAL_EVT_CONNFAIL);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_ACCEPT) &&
+                !_call_io(&handlers_type::on_incoming_conn)) {
+                print_early_return(BAL_EVT_ACCEPT);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_CLOSE) &&
+                !_call_io(&handlers_type::on_close)) {
+                print_early_return(BAL_EVT_CLOSE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_PRIORITY) &&
+                !_call_io(&handlers_type::on_priority)) {
+                print_early_return(BAL_EVT_PRIORITY);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_ERROR) &&
+                !_call_io(&handlers_type::on_error)) {
+                print_early_return(BAL_EVT_ERROR);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_INVALID) &&
+                !_call_io(&handlers_type::on_invalid)) {
+                print_early_return(BAL_EVT_INVALID);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_OOBREAD) &&
+                !_call_io(&handlers_type::on_oob_read)) {
+                print_early_return(BAL_EVT_OOBREAD);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_OOBWRITE) &&
+                !_call_io(&handlers_type::on_oob_write)) {
+                print_early_return(BAL_EVT_OOBWRITE);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WBLOCKED) &&
+                !_call_io(&handlers_type::on_write_blocked)) {
+                print_early_return(BAL_EVT_WBLOCKED);
+                return;
+            }
+
+            if (bal_isbitset(events, BAL_EVT_WDRAINED) &&
+                !_call_io(&handlers_type::on_write_drained)) {
+                print_early_return(BAL_EVT_WDRAINED);
+                return;
+            }
+        }
+
+        size_t _dispatch_data(const void* data, size_t len)
+        {
+            const auto* cb = _find(&handlers_type::on_data);
+            return cb ? (*cb)(this, data, len) : 0;
+        }
+
+        void _dispatch_frame(const void* data, size_t len)
+        {
+            if (const auto* cb = _find(&handlers_type::on_frame)) {
+                (*cb)(this, data, len);
+            }
+        }
+
+        void _dispatch_line(const void* data, size_t len)
+        {
+            if (const auto* cb = _find(&handlers_type::on_line)) {
+                (*cb)(this, data, len);
             }
         }
 
     private:
-        bal_socket* _s = nullptr;
+        /* the handlers in effect when a socket has neither its own nor shared
+         * ones. */
+        static const handlers_type& _default_handlers()
+        {
+            static const handlers_type defaults;
+            return defaults;
+        }
+
+        /* this socket's own handler, else the shared (or default) one; null if
+         * there is neither. */
+        template<class TCallback>
+        const TCallback* _find(TCallback handlers_type::* member) const noexcept
+        {
+            if (_own && (*_own).*member) {
+                return &((*_own).*member);
+            }
+
+            /* without a shared set, the defaults are copied into _own. */
+            const handlers_type* fallback = _handlers ? _handlers.get()
+                : (_own ? nullptr : &_default_handlers());
+            if (fallback && (*fallback).*member) {
+                return &((*fallback).*member);
+            }
+
+            return nullptr;
+        }
+
+        /* true if there is no handler. */
+        bool _call_io(async_io_cb handlers_type::* member)
+        {
+            const auto* cb = _find(member);
+            return cb ? (*cb)(this) : true;
+        }
+
+        std::unique_ptr<handlers_type> _own;
+        shared_handlers _handlers;
+    };
+
+    /** A socket whose event handlers are member functions of TDerived, which
+     * derives from it. Handlers are found by name at compile time and called
+     * directly (not through std::function), and the default mask passed to
+     * async_poll only includes the events that TDerived handles:
+     *
+     *   bool on_read(), on_write(), on_connect(), on_conn_fail(),
+     *        on_incoming_conn(), on_close(), on_priority(), on_error(),
+     *        on_invalid(), on_oob_read(), on_oob_write(), on_write_blocked(),
+     *        on_write_drained()
+     *   size_t on_data(const void* data, size_t len)
+     *   void on_frame(const void* data, size_t len)
+     *   void on_line(const void* data, size_t len)
+     *
+     * As with socket_base, the socket is closed on close or error events that
+     * have no handler. Handlers must be public, and TDerived must be default
+     * constructible to accept into. If its handlers use its own members, its
+     * destructor should call deregister_async_poll before they are destroyed. */
+    template<class TDerived, bool RAII = true, DerivedFromPolicy TPolicy = default_policy>
+    class static_socket : public basic_socket<TDerived, RAII, TPolicy>
+    {
+        using base = basic_socket<TDerived, RAII, TPolicy>;
+        friend base;
+
+    public:
+        using base::base;
+
+        static constexpr uint32_t default_event_mask() noexcept
+        {
+            uint32_t mask = BAL_EVT_CLOSE | BAL_EVT_ERROR;
+# define _BAL_STATIC_MASK(evt, handler) \
+            if constexpr (requires(TDerived& d) { d.handler; }) { \
+                mask |= (evt); \
+            }
+            _BAL_STATIC_MASK(BAL_EVT_READ, on_read())
+            _BAL_STATIC_MASK(BAL_EVT_READ, on_data(nullptr, 0))
+            _BAL_STATIC_MASK(BAL_EVT_READ, on_frame(nullptr, 0))
+            _BAL_STATIC_MASK(BAL_EVT_READ, on_line(nullptr, 0))
+            _BAL_STATIC_MASK(BAL_EVT_WRITE, on_write())
+            _BAL_STATIC_MASK(BAL_EVT_CONNECT, on_connect())
+            _BAL_STATIC_MASK(BAL_EVT_CONNFAIL, on_conn_fail())
+            _BAL_STATIC_MASK(BAL_EVT_ACCEPT, on_incoming_conn())
+            _BAL_STATIC_MASK(BAL_EVT_PRIORITY, on_priority())
+            _BAL_STATIC_MASK(BAL_EVT_INVALID, on_invalid())
+            _BAL_STATIC_MASK(BAL_EVT_OOBREAD, on_oob_read())
+            _BAL_STATIC_MASK(BAL_EVT_OOBWRITE, on_oob_write())
+            _BAL_STATIC_MASK(BAL_EVT_WBLOCKED, on_write_blocked())
+            _BAL_STATIC_MASK(BAL_EVT_WDRAINED, on_write_drained())
+# undef _BAL_STATIC_MASK
+            return mask;
+        }
+
+    protected:
+        void _dispatch_io(uint32_t events)
+        {
+            auto* self = static_cast<TDerived*>(this);
+            BAL_UNUSED(self);
+
+# define _BAL_STATIC_DISPATCH(evt, handler) \
+            if constexpr (requires(TDerived& d) { d.handler(); }) { \
+                if (bal_isbitset(events, (evt)) && !self->handler()) { \
+                    return; \
+                } \
+            }
+# define _BAL_STATIC_DISPATCH_OR_CLOSE(evt, handler) \
+            if (bal_isbitset(events, (evt))) { \
+                if constexpr (requires(TDerived& d) { d.handler(); }) { \
+                    if (!self->handler()) { \
+                        return; \
+                    } \
+                } else { \
+                    [[maybe_unused]] const auto closed = this->close(); \
+                    return; \
+                } \
+            }
+            _BAL_STATIC_DISPATCH(BAL_EVT_READ, on_read)
+            _BAL_STATIC_DISPATCH(BAL_EVT_WRITE, on_write)
+            _BAL_STATIC_DISPATCH(BAL_EVT_CONNECT, on_connect)
+            _BAL_STATIC_DISPATCH(BAL_EVT_CONNFAIL, on_conn_fail)
+            _BAL_STATIC_DISPATCH(BAL_EVT_ACCEPT, on_incoming_conn)
+            _BAL_STATIC_DISPATCH_OR_CLOSE(BAL_EVT_CLOSE, on_close)
+            _BAL_STATIC_DISPATCH(BAL_EVT_PRIORITY, on_priority)
+            _BAL_STATIC_DISPATCH_OR_CLOSE(BAL_EVT_ERROR, on_error)
+            _BAL_STATIC_DISPATCH(BAL_EVT_INVALID, on_invalid)
+            _BAL_STATIC_DISPATCH(BAL_EVT_OOBREAD, on_oob_read)
+            _BAL_STATIC_DISPATCH(BAL_EVT_OOBWRITE, on_oob_write)
+            _BAL_STATIC_DISPATCH(BAL_EVT_WBLOCKED, on_write_blocked)
+            _BAL_STATIC_DISPATCH(BAL_EVT_WDRAINED, on_write_drained)
+# undef _BAL_STATIC_DISPATCH_OR_CLOSE
+# undef _BAL_STATIC_DISPATCH
+        }
+
+        size_t _dispatch_data(const void* data, size_t len)
+        {
+            if constexpr (requires(TDerived& d) { d.on_data(data, len); }) {
+                return static_cast<TDerived*>(this)->on_data(data, len);
+            } else {
+                BAL_UNUSED(data);
+                BAL_UNUSED(len);
+                return 0;
+            }
+        }
+
+        void _dispatch_frame(const void* data, size_t len)
+        {
+            if constexpr (requires(TDerived& d) { d.on_frame(data, len); }) {
+                static_cast<TDerived*>(this)->on_frame(data, len);
+            } else {
+                BAL_UNUSED(data);
+                BAL_UNUSED(len);
+            }
+        }
+
+        void _dispatch_line(const void* data, size_t len)
+        {
+            if constexpr (requires(TDerived& d) { d.on_line(data, len); }) {
+                static_cast<TDerived*>(this)->on_line(data, len);
+            } else {
+                BAL_UNUSED(data);
+                BAL_UNUSED(len);
+            }
+        }
     };
 
     using scoped_socket = socket_base<true, default_policy>;
@@ -0,0 +1,93 @@
+/*
+ * alloc.h
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _BAL_ALLOC_H_INCLUDED
+# define _BAL_ALLOC_H_INCLUDED
+
+# include "types.h"
+
+# if defined(__cplusplus)
+extern "C" {
+# endif
+
+/** The number of objects carved out of each chunk obtained by a bal_slab. */
+# define BAL_SLAB_CHUNK_OBJS 64
+
+/** The alignment of objects handed out by a bal_slab. */
+# define BAL_SLAB_ALIGN 16
+
+/** Rounds `size` up to the nearest multiple of BAL_SLAB_ALIGN. */
+# define _BAL_SLAB_ROUNDUP(size) \
+    (((size) + (BAL_SLAB_ALIGN - 1)) & ~((size_t)BAL_SLAB_ALIGN - 1))
+
+/** Static initializer for a bal_slab that hands out objects of `size` bytes,
+ * `objs` per chunk. */
+# define BAL_SLAB_INIT_CHUNK(size, objs) \
+    {BAL_MUTEX_INIT, _BAL_SLAB_ROUNDUP(size), (objs), NULL, NULL, {0}}
+
+/** Static initializer for a bal_slab that hands out objects of `size` bytes. */
+# define BAL_SLAB_INIT(size) BAL_SLAB_INIT_CHUNK(size, BAL_SLAB_CHUNK_OBJS)
+
+/** Allocates zero-filled memory for `num` objects of `size` bytes each, using
+ * the allocator set by bal_set_allocator (or calloc, if none was set). */
+void* _bal_calloc(size_t num, size_t size);
+
+/** Releases memory obtained from _bal_calloc. */
+void _bal_free(void* ptr);
+
+/** Replaces the allocator used by _bal_calloc/_bal_free. NULL restores the C
+ * runtime's calloc/free. */
+bool _bal_set_allocator(const bal_allocator* alloc);
+
+/** Allocates a zero-filled object from the slab, obtaining a new chunk from the
+ * heap if the free list is empty. */
+void* _bal_slab_alloc(bal_slab* slab);
+
+/** Obtains a new chunk from the heap and pushes its objects onto the free list.
+ * The caller must hold the slab's mutex. */
+bool _bal_slab_grow(bal_slab* slab);
+
+/** Returns an object obtained from _bal_slab_alloc to the front of the free list. */
+void _bal_slab_free(bal_slab* slab, void* obj);
+
+/** Returns all chunks to the heap, if no objects are currently in use. */
+bool _bal_slab_release(bal_slab* slab);
+
+/** Copies the slab's allocation counters. */
+bool _bal_slab_get_stats(bal_slab* slab, bal_slab_stats* out);
+
+/** Allocates a bal_socket for descriptor `sd` from the slab of the reactor it
+ * will belong to: that of `parent` (e.g. a listener), if pinned, or else the
+ * one picked by its descriptor. */
+bal_socket* _bal_socket_alloc(bal_descriptor sd, const bal_socket* parent);
+
+/** Returns a bal_socket to the slab it came from and sets the pointer to NULL. */
+void _bal_socket_free(bal_socket** s);
+
+# if defined(__cplusplus)
+}
+# endif
+
+#endif /* !_BAL_ALLOC_H_INCLUDED */
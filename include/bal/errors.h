@@ -33,12 +33,18 @@ extern "C" {
 # endif
 
 int _bal_get_error(bal_error* err, bool extended);
+int _bal_get_error_codes(bal_error_codes* codes);
+int _bal_format_error(const bal_error_codes* codes, bal_error* err);
 bool __bal_set_error(int code, const char* func, const char* file, uint32_t line);
-void __bal_set_os_error(int code, const char* message, const char* func,
-    const char* file, uint32_t line);
 bool __bal_handle_error(int code, const char* func, const char* file,
     uint32_t line, bool gai);
 
+/** Returns the portion of a path following the last separator. */
+const char* _bal_basename(const char* file);
+
+/** Formats the OS (or getaddrinfo) message for `code` into `buf`. */
+void _bal_format_os_error(int code, bool gai, char* buf, size_t len);
+
 /** Creates a libbal-specific error code from a positive integer that would
  * otherwise likely collide with OS-level error codes. Supports values
  * 1..255 inclusive. */
@@ -62,6 +68,7 @@ enum
     BAL_E_INTERNAL   = 13, /**< An internal error has occurred */
     BAL_E_UNAVAIL    = 14, /**< Feature is disabled or unavailable */
     BAL_E_PLATFORM   = 15, /**< Platform error code %d (%s) */
+    BAL_E_INUSE      = 16, /**< Resource is in use */
     BAL_E_UNKNOWN    = 255 /**< An unknown error has occurred */
 };
 
@@ -81,6 +88,7 @@ enum
 # define _BAL_E_INTERNAL   _bal_mk_error(BAL_E_INTERNAL)
 # define _BAL_E_UNAVAIL    _bal_mk_error(BAL_E_UNAVAIL)
 # define _BAL_E_PLATFORM   _bal_mk_error(BAL_E_PLATFORM)
+# define _BAL_E_INUSE      _bal_mk_error(BAL_E_INUSE)
 # define _BAL_E_UNKNOWN    _bal_mk_error(BAL_E_UNKNOWN)
 
 /** Determines if the input is a packed error created by _bal_mk_error. */
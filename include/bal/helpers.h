@@ -28,6 +28,7 @@
 
 # include "types.h"
 # include "errors.h"
+# include "alloc.h"
 
 /** Allows a parameter to be unreferenced without compiler warnings. */
 # define BAL_UNUSED(var) (void)(var)
@@ -45,12 +46,12 @@ bool _bal_strsame(const char* lhs, const char* rhs, size_t len)
 # endif
 }
 
-/** Sets the specified pointer-to-pointer's value to NULL after free(). */
+/** Sets the specified pointer-to-pointer's value to NULL after _bal_free(). */
 static inline
 void __bal_safefree(void** pp)
 {
     if (pp && *pp) {
-        free(*pp);
+        _bal_free(*pp);
         *pp = NULL;
     }
 }
@@ -82,6 +83,70 @@ void __bal_safefree(void** pp)
       (void)snprintf(dst, _n, __VA_ARGS__); \
     } while (false)
 
+/** True if the last socket call failed because it would have blocked. */
+static inline
+bool _bal_would_block(void)
+{
+# if defined(__WIN__)
+    return WSAEWOULDBLOCK == WSAGetLastError();
+# else
+    return EAGAIN == errno || EWOULDBLOCK == errno;
+# endif
+}
+
+/** Updates a socket's I/O counters after a send/recv family call that
+ * returned `ret`. Must be called before anything can clobber errno. */
+static inline
+void _bal_count_io(const bal_socket* s, ssize_t ret, bool sent)
+{
+    bal_socket_stats* stats = &((bal_socket*)s)->state.stats;
+    stats->syscalls++;
+    if (ret > 0) {
+        if (sent)
+            stats->bytes_sent += (uint64_t)ret;
+        else
+            stats->bytes_recvd += (uint64_t)ret;
+    } else if (-1 == ret && _bal_would_block()) {
+        stats->eagains++;
+    }
+}
+
+/** Returns the index of the bal_histogram bucket that holds `value`. */
+static inline
+size_t _bal_hist_index(uint64_t value)
+{
+    if (value < (1ULL << BAL_HIST_SUB_BITS))
+        return (size_t)value;
+
+# if defined(__GNUC__)
+    unsigned msb = 63U - (unsigned)__builtin_clzll(value);
+# else
+    unsigned msb = 0U;
+    for (uint64_t v = value; v > 1ULL; v >>= 1)
+        msb++;
+# endif
+    if (msb >= BAL_HIST_MAX_BITS)
+        return BAL_HIST_BUCKETS - 1;
+
+    return ((size_t)(msb - BAL_HIST_SUB_BITS + 1U) << BAL_HIST_SUB_BITS) +
+        (size_t)((value >> (msb - BAL_HIST_SUB_BITS)) &
+            ((1ULL << BAL_HIST_SUB_BITS) - 1ULL));
+}
+
+/** Records a value (in nanoseconds) in a histogram. */
+static inline
+void _bal_hist_record(bal_histogram* h, uint64_t value)
+{
+    if (0ULL == h->count || value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+
+    h->count++;
+    h->sum += value;
+    h->buckets[_bal_hist_index(value)]++;
+}
+
 /** getnameinfo flags: do not perform DNS queries. */
 # define _BAL_NI_NODNS (NI_NUMERICHOST | NI_NUMERICSERV)
 
@@ -41,8 +41,46 @@ bool _bal_sanity(void);
 bool _bal_init_asyncpoll(void);
 bool _bal_cleanup_asyncpoll(void);
 
+/** Joins a reactor's events thread and destroys its list and mutex. The `die`
+ * flag must already be set. */
+bool _bal_stop_reactor(bal_reactor* r);
+
+/** Returns the reactor that owns the socket, assigning one by descriptor if
+ * the socket has not been pinned to a reactor. */
+bal_reactor* _bal_get_reactor(bal_socket* s);
+
+/** Pins `s` to the same reactor as `parent` (if the latter is pinned). */
+void _bal_inherit_reactor(bal_socket* s, const bal_socket* parent);
+
+/** Copies a reactor's counters, filling in its registry size and adding the
+ * I/O counters of its registered sockets. */
+void _bal_get_reactor_stats(bal_reactor* r, bal_reactor_stats* out);
+
+/** Adds each counter in `src` to the corresponding counter in `dst`. */
+void _bal_add_socket_stats(bal_socket_stats* dst, const bal_socket_stats* src);
+
+/** Returns a monotonic timestamp, in nanoseconds. */
+uint64_t _bal_now_ns(void);
+
+/** Returns the largest value that falls in a bal_histogram bucket. */
+uint64_t _bal_hist_bucket_max(size_t index);
+
+/** Adds the contents of a reactor's histograms to `out`, then clears them if
+ * `reset` is true. */
+void _bal_get_reactor_histograms(bal_reactor* r, bal_loop_histograms* out,
+    bool reset);
+
+/** Adds the contents of `src` to `dst`. */
+void _bal_merge_histogram(bal_histogram* dst, const bal_histogram* src);
+
+/** Releases everything the socket holds and frees it; the caller has removed
+ * it from its reactor (whose mutex it holds, if async I/O is active). */
 void _bal_destroy(bal_socket** s);
 
+/** True if a handler has closed or destroyed the socket during its dispatch,
+ * which must then stop using the socket's descriptor and buffers. */
+bool _bal_is_gone(const bal_socket* s);
+
 bool _bal_get_addrinfo(int flags, int addr_fam, int type, const char* host,
     const char* port, struct addrinfo** res);
 bool _bal_getnameinfo(int flags, const bal_sockaddr* in, char* host, char* port);
@@ -52,18 +90,134 @@ bool _bal_is_closed_conn(const bal_socket* s);
 
 uint32_t _bal_on_pending_conn_io(bal_socket* s, uint32_t* events);
 
+/** Polls a single socket for `events` without waiting; `revents` receives the
+ * returned flags. */
+bool _bal_poll_one(const bal_socket* s, short events, short* revents);
+
 uint32_t _bal_pollflags_to_events(short flags);
 short _bal_mask_to_pollflags(uint32_t mask);
 
+/** Retrieves a socket option from the cache, calling getsockopt and caching the
+ * result on a miss. `opt` is a single BAL_OPT_* bit. */
+bool _bal_get_cached_opt(const bal_socket* s, uint32_t opt, void* optval);
+
+/** Sets a socket option and caches the value that was applied. */
+bool _bal_set_cached_opt(const bal_socket* s, uint32_t opt, const void* optval);
+
+/** Drops the cached value (if any) for the specified option. */
+void _bal_invalidate_opt(const bal_socket* s, int level, int name);
+
+/** Applies every option selected in `opts->mask` to the socket. */
+bool _bal_apply_opts(bal_socket* s, const bal_socket_opts* opts);
+
+/** Appends the unsent part of a buffer to the socket's send queue (copying it
+ * if `free_cb` is NULL), and adds write interest. The caller must hold the
+ * socket's reactor mutex. */
+bool _bal_sendq_push(bal_socket* s, const void* data, size_t len, size_t offset,
+    bal_free_cb free_cb);
+
+/** Sends as much of the queue as the socket will take, and drops write interest
+ * added for it once it is empty. Returns false on a hard error. The caller must
+ * hold the socket's reactor mutex. */
+bool _bal_sendq_flush(bal_socket* s);
+
+/** Flushes the send queue of a writable socket. Returns BAL_EVT_WDRAINED if the
+ * queue drained to its low watermark (and the event is in the mask); sets
+ * BAL_EVT_ERROR in `events` on a hard error. */
+uint32_t _bal_on_sendq_io(bal_socket* s, uint32_t* events);
+
+/** Returns true (once) when the send queue grows past its high watermark. */
+bool _bal_sendq_check_high(bal_socket* s);
+
+/** Queues events that don't come from polling for the events thread to deliver
+ * (those in the mask at the time) to the socket's callback, so that it is never
+ * called on the raising thread. The caller must hold the socket's reactor
+ * mutex. */
+void _bal_raise_events(bal_socket* s, uint32_t events);
+
+/** Receives into the socket's pooled buffer and passes the unconsumed data to
+ * its bal_async_recv callback, until the socket is drained (or after
+ * BAL_RECV_MAX_READS reads). Returns BAL_EVT_CLOSE if the peer closed the
+ * connection (and the event is in the mask); sets BAL_EVT_ERROR in `events`
+ * on failure. The caller must hold the socket's reactor mutex. */
+uint32_t _bal_on_data_io(bal_socket* s, uint32_t* events);
+
+/** The size of the receive buffers in size class `cls`. */
+# define _BAL_RECV_BUF_SIZE(cls) ((size_t)BAL_RECV_BUF_MIN << (cls))
+
+/** Returns the smallest receive buffer size class that holds `bytes` (or the
+ * biggest, if none does). */
+size_t _bal_recv_class(size_t bytes);
+
+/** Ensures the socket holds a receive buffer with room after its unconsumed
+ * data: takes one of the wanted size class from the pool, moves the data to the
+ * front, or moves it to a buffer of the next class. */
+bool _bal_recvbuf_make_room(bal_socket* s);
+
+/** Updates the size class the socket's next receive buffer is taken from,
+ * given the bytes received for the latest read event. */
+void _bal_recvbuf_adapt(bal_socket* s, size_t got);
+
+/** Returns the socket's receive buffer to the pool if it holds no unconsumed
+ * data (or if `discard` is true). */
+void _bal_recvbuf_release(bal_socket* s, bool discard);
+
+/** The period after which empty receive buffers are reclaimed (zero: as soon as
+ * they are empty). */
+uint_fast32_t _bal_get_recv_idle_ms(void);
+
+/** Builds the CRC32C lookup table, and picks the CRC32C and delimiter scanning
+ * code best suited to the CPU. */
+void _bal_frame_init(void);
+
+/** Continues a CRC32C over `data` (using the SSE4.2 instruction if `hw` is
+ * true and the CPU has it). */
+uint32_t _bal_crc32c(uint32_t crc, const void* data, size_t len, bool hw);
+
+/** Reads a `width` byte unsigned length prefix. */
+uint64_t _bal_frame_get_uint(const uint8_t* p, size_t width, bool big_endian);
+
+/** Writes a `width` byte unsigned length prefix. */
+void _bal_frame_put_uint(uint8_t* p, size_t width, bool big_endian, uint64_t val);
+
+/** The bal_data_cb installed by bal_async_frames: splits the stream into frames
+ * and hands each whole one to the socket's bal_frame_cb. Returns BAL_DATA_ERROR
+ * if a frame is too big or fails its CRC. */
+size_t _bal_frame_on_data(bal_socket* s, const void* data, size_t len);
+
+/** Returns the offset of the first `delim` in `data` (or `len` if there is
+ * none), using SSE2/AVX2 if `simd` is true and the CPU has them. */
+size_t _bal_find_delim(const void* data, size_t len, uint8_t delim, bool simd);
+
+/** The bal_data_cb installed by bal_async_lines: hands each complete line to
+ * the socket's bal_frame_cb, resuming the search for a delimiter where the
+ * last one left off. Returns BAL_DATA_ERROR if a line can't fit in the
+ * biggest receive buffer. */
+size_t _bal_line_on_data(bal_socket* s, const void* data, size_t len);
+
+/** Discards any partially assembled frame or scanned line, and restores the
+ * low watermark. */
+void _bal_frame_reset(bal_socket* s);
+
+/** Keeps BAL_EVT_WRITE in the mask while the send queue is non-empty, after the
+ * mask has been replaced. */
+void _bal_sendq_keep_write(bal_socket* s);
+
+/** Discards (and releases) everything in the send queue. */
+void _bal_sendq_clear(bal_socket* s);
+
 bal_threadret _bal_eventthread(void* ctx);
 
-void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events);
+/** `woke_ns` is the time at which poll returned, or zero if latency histograms
+ * are not being recorded. */
+void _bal_dispatch_events(bal_reactor* r, bal_descriptor sd, bal_socket* s,
+    uint32_t events, uint64_t woke_ns);
 
 /** Creates a new list. */
 bool _bal_list_create(bal_list** lst);
 
-/** Creates a node and assigns key and value to it. */
-bool _bal_list_create_node(bal_list_node** node, bal_descriptor key, bal_socket* val);
+/** Points `node` at the node embedded in `val` and assigns key and value to it. */
+bool _bal_list_init_node(bal_list_node** node, bal_descriptor key, bal_socket* val);
 
 /** Appends a node with the supplied key and value to the end of the list. */
 bool _bal_list_add(bal_list* lst, bal_descriptor key, bal_socket* val);
@@ -87,17 +241,18 @@ void _bal_list_reset_iterator(bal_list* lst);
 /** Calls `func` for each node in the list, passing `ctx`. */
 bool _bal_list_iterate_func(bal_list* lst, void* ctx, bal_list_iter_cb cb);
 
-/** Finds a node by key, and destroys it if found. */
+/** Finds a node by key, and unlinks it if found. */
 bool _bal_list_remove(bal_list* lst, bal_descriptor key, bal_socket** val);
 
-/** Removes and deallocates all nodes from the list, leaving the list empty. */
+/** Unlinks all nodes from the list, leaving the list empty. */
 bool _bal_list_remove_all(bal_list* lst);
 
-/** Deallocates any nodes in the list and deallocates the list. */
+/** Unlinks any nodes in the list and deallocates the list. */
 bool _bal_list_destroy(bal_list** lst);
 
-/** Deallocates a node and set prev/next pointers on its neighbors accordingly. */
-bool _bal_list_destroy_node(bal_list_node** node);
+/** Unlinks a node and sets prev/next pointers on its neighbors accordingly. The
+ * node's memory belongs to the bal_socket it is embedded in. */
+bool _bal_list_unlink_node(bal_list_node** node);
 
 /** Callback for finding nodes by key. */
 bool __bal_list_find_key(bal_descriptor key, bal_socket* val, void* ctx);
@@ -117,11 +272,28 @@ bool _bal_mutex_destroy(bal_mutex* mutex);
 # if defined(__HAVE_STDATOMICS__)
 bool _bal_get_boolean(const atomic_bool* boolean);
 void _bal_set_boolean(atomic_bool* boolean, bool value);
+size_t _bal_get_size(const atomic_size_t* size);
 # else
 bool _bal_get_boolean(const bool* boolean);
 void _bal_set_boolean(bool* boolean, bool value);
+size_t _bal_get_size(const volatile size_t* size);
 # endif
 
+/** Adds one to (or subtracts one from) a counter shared between threads, and
+ * raises `peak` to the counter's new value if that is higher. */
+# if defined(__HAVE_STDATOMICS__)
+void _bal_count_peak(atomic_size_t* count, atomic_size_t* peak, bool add);
+# else
+void _bal_count_peak(volatile size_t* count, volatile size_t* peak, bool add);
+# endif
+
+/** Counts a socket being added to (or removed from) a reactor's list, for the
+ * library-wide peak. */
+void _bal_count_registration(bool add);
+
+/** Closes a descriptor that was never wrapped in a bal_socket. */
+void _bal_close_descriptor(bal_descriptor sd);
+
 /** Runs the specified function exactly once. */
 bool _bal_once(bal_once* once, bal_once_fn func);
 
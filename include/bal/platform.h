@@ -83,6 +83,7 @@
 
 #  if defined(__linux__)
 #   include <sys/syscall.h>
+#   include <linux/filter.h>
 #  elif defined(__sun)
 #   include <sys/filio.h>
 #   include <stropts.h>
@@ -110,6 +111,7 @@
 #  include <pthread.h>
 #  include <sched.h>
 #  include <poll.h>
+#  include <sys/uio.h>
 
 #  if !defined(__STDC_NO_ATOMICS__) && !defined(__cplusplus)
 #   include <stdatomic.h>
@@ -125,6 +127,9 @@ typedef size_t bal_iolen;
 /** The type used in the linger struct. */
 typedef int bal_linger;
 
+/** The scatter/gather buffer type (see bal_sendv and bal_setiovec). */
+typedef struct iovec bal_iovec;
+
 /** The type used for struct timeval::tv_sec. */
 typedef time_t bal_tvsec;
 
@@ -204,6 +209,9 @@ typedef int bal_iolen;
 /** The type used in the linger struct. */
 typedef u_short bal_linger;
 
+/** The scatter/gather buffer type (see bal_sendv and bal_setiovec). */
+typedef WSABUF bal_iovec;
+
 /** The type used for struct timeval::tv_sec. */
 typedef long bal_tvsec;
 
@@ -275,6 +283,7 @@ typedef unsigned bal_threadret;
 # include <stdio.h>
 # include <stdarg.h>
 # include <stdbool.h>
+# include <stddef.h>
 # include <stdint.h>
 # include <inttypes.h>
 # include <assert.h>
@@ -298,13 +307,92 @@ typedef unsigned bal_threadret;
 # define BAL_EVT_INVALID  0x00000100U
 # define BAL_EVT_OOBREAD  0x00000200U
 # define BAL_EVT_OOBWRITE 0x00000400U
-# define BAL_EVT_ALL      0x000007ffU /**< Includes all available event types. */
-# define BAL_EVT_NORMAL   0x000001bdU /**< Excludes write, oob [r/w], priority. */
-# define BAL_EVT_CLIENT   0x000001bfU /**< Excludes oob [r/w], priority. */
+# define BAL_EVT_WBLOCKED 0x00000800U /**< Send queue grew past its high watermark. */
+# define BAL_EVT_WDRAINED 0x00001000U /**< Send queue drained to its low watermark. */
+# define BAL_EVT_ALL      0x00001fffU /**< Includes all available event types. */
+# define BAL_EVT_NORMAL   0x000019bdU /**< Excludes write, oob [r/w], priority. */
+# define BAL_EVT_CLIENT   0x000019bfU /**< Excludes oob [r/w], priority. */
+# define BAL_EVT_COUNT    13          /**< Number of distinct event types. */
 
 # define BAL_S_CONNECT    0x00000001U
 # define BAL_S_LISTEN     0x00000002U
 # define BAL_S_CLOSE      0x00000004U
+# define BAL_S_NONBLOCK   0x00000008U
+# define BAL_S_REACTOR    0x00000010U
+# define BAL_S_IDLE       0x00000020U /**< Stream socket not yet connecting or
+                                           listening; left out of the poll set. */
+# define BAL_S_SENDQ      0x00000040U /**< BAL_EVT_WRITE is in the mask only to flush
+                                           the send queue. */
+# define BAL_S_WBLOCKED   0x00000080U /**< Send queue is above its high watermark
+                                           (until it drains to the low one). */
+# define BAL_S_DESTROY    0x00000100U /**< Destroyed by one of its handlers; freed
+                                           once its dispatch returns. */
+
+/** The maximum number of async I/O reactors (see bal_set_reactor_count). */
+# define BAL_MAX_REACTORS 64
+
+/** The size of the smallest receive buffer lent to sockets by bal_async_recv;
+ * each of the BAL_RECV_BUF_CLASSES size classes is twice the previous one. */
+# define BAL_RECV_BUF_MIN 2048
+
+/** The number of receive buffer size classes. */
+# define BAL_RECV_BUF_CLASSES 6
+
+/** The size of the largest receive buffer. */
+# define BAL_RECV_BUF_MAX (BAL_RECV_BUF_MIN << (BAL_RECV_BUF_CLASSES - 1))
+
+/** The most buffers bal_sendv hands to the OS in one call; the rest of a
+ * longer array is left for the next call, as with any short write. */
+# define BAL_IOV_MAX 1024
+
+/** The most reads bal_async_recv performs for one read event, so that a busy
+ * socket can't starve the others in its reactor. */
+# define BAL_RECV_MAX_READS 8
+
+/** Returned by a bal_async_recv callback to report malformed data: raises
+ * BAL_EVT_ERROR and pauses reads (see bal_pause_read). */
+# define BAL_DATA_ERROR ((size_t)-1)
+
+/** bal_framing: the length prefix and CRC are big-endian (little-endian if
+ * not set). */
+# define BAL_FRAME_BIG_ENDIAN 0x00000001U
+
+/** bal_framing: each payload is followed by its CRC32C (see bal_crc32c). */
+# define BAL_FRAME_CRC32C     0x00000002U
+
+/** The largest payload accepted by default if the prefix is 4 or 8 bytes wide. */
+# define BAL_FRAME_MAX_DEFAULT (16U * 1024U * 1024U)
+
+/** bal_async_lines: a carriage return preceding the delimiter is not part of
+ * the line (for CRLF-delimited protocols). */
+# define BAL_LINE_CRLF 0x00000001U
+
+/** bal_listen_sharded: steer each connection to the listener whose index
+ * matches the CPU that received it (modulo the number of listeners). */
+# define BAL_SHARD_STEER_CPU 0x00000001U
+
+/** Latency histogram resolution: each power-of-two range of values is split
+ * into 2^BAL_HIST_SUB_BITS linear buckets (a relative error of at most 12.5%). */
+# define BAL_HIST_SUB_BITS 3
+
+/** Latencies of 2^BAL_HIST_MAX_BITS nanoseconds (~18 minutes) or more are
+ * recorded in the last histogram bucket. */
+# define BAL_HIST_MAX_BITS 40
+
+/** The number of buckets in a bal_histogram. */
+# define BAL_HIST_BUCKETS \
+    ((BAL_HIST_MAX_BITS - BAL_HIST_SUB_BITS + 1) << BAL_HIST_SUB_BITS)
+
+# define BAL_OPT_BROADCAST 0x00000001U
+# define BAL_OPT_DEBUG     0x00000002U
+# define BAL_OPT_LINGER    0x00000004U
+# define BAL_OPT_KEEPALIVE 0x00000008U
+# define BAL_OPT_OOBINLINE 0x00000010U
+# define BAL_OPT_REUSEADDR 0x00000020U
+# define BAL_OPT_SNDBUF    0x00000040U
+# define BAL_OPT_RCVBUF    0x00000080U
+# define BAL_OPT_SNDTIMEO  0x00000100U
+# define BAL_OPT_RCVTIMEO  0x00000200U
 
 # define BAL_MAGIC        0x45004500U
 
@@ -314,6 +402,29 @@ typedef unsigned bal_threadret;
 #  define __HAVE_SO_ACCEPTCONN__
 # endif
 
+# if defined(__linux__) || defined(__BSD__)
+#  define __HAVE_ACCEPT4__
+#  define __HAVE_SOCK_NONBLOCK__
+# endif
+
+# if defined(SO_REUSEPORT)
+#  define __HAVE_SO_REUSEPORT__
+# endif
+
+# if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#  define __HAVE_REUSEPORT_CBPF__
+# endif
+
+# if defined(SO_RCVLOWAT) && !defined(__WIN__)
+#  define __HAVE_SO_RCVLOWAT__
+# endif
+
+# if (defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))) || \
+    (defined(_M_X64) && defined(_MSC_VER))
+#  define __HAVE_SSE42_CRC32C__
+#  define __HAVE_X86_SIMD_SCAN__
+# endif
+
 # if defined(__WIN__) && defined(__STDC_SECURE_LIB__)
 #  define __HAVE_STDC_SECURE_OR_EXT1__
 # elif defined(__STDC_LIB_EXT1__)
@@ -37,6 +37,7 @@ extern volatile bool _bal_async_poll_init;
 # endif
 
 extern bal_as_container _bal_as_container;
+extern bal_allocator _bal_allocator;
 extern bal_state _bal_state;
 
 #endif /* !_BAL_STATE_H_INCLUDED */
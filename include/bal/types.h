@@ -36,6 +36,14 @@ struct bal_socket; /* forward declaration. */
 /** bal_async_poll callback. */
 typedef void (*bal_async_cb)(struct bal_socket*, uint32_t);
 
+/** Releases a buffer handed to bal_send_async once it has been sent. */
+typedef void (*bal_free_cb)(void* data);
+
+/** bal_async_recv callback. Returns the number of bytes consumed (at most
+ * `len`); the rest is passed again, followed by newer data, next time. */
+typedef size_t (*bal_data_cb)(struct bal_socket*, const void* /*data*/,
+    size_t /*len*/);
+
 /** List iteration callback. Returns false to stop iteration. */
 typedef bool (*bal_list_iter_cb)(bal_descriptor /*key*/,
     struct bal_socket* /*val*/, void* /*ctx*/);
@@ -43,16 +51,131 @@ typedef bool (*bal_list_iter_cb)(bal_descriptor /*key*/,
 /** Worker thread callback. */
 typedef bal_threadret (*bal_thread_cb)(void*);
 
+/* Node type for bal_list. Embedded in each bal_socket, so that registering a
+ * socket for async I/O does not require an allocation. */
+typedef struct _bal_list_node {
+    bal_descriptor key;
+    struct bal_socket* val;
+    struct _bal_list_node *prev;
+    struct _bal_list_node *next;
+} bal_list_node;
+
+/* A buffer queued by bal_send_async. */
+typedef struct _bal_send_buf {
+    struct _bal_send_buf* next;
+    const uint8_t* data; /* Start of the buffer. */
+    size_t len;          /* Length of the buffer. */
+    size_t offset;       /* Bytes already sent. */
+    bal_free_cb free_cb; /* Releases `data`; NULL if it was copied in after this header. */
+} bal_send_buf;
+
+/* Data waiting for its socket to become writable. */
+typedef struct {
+    bal_send_buf* head;
+    bal_send_buf* tail;
+    size_t bytes; /* Unsent bytes in the queue. */
+    size_t high;  /* High watermark; zero if watermarks are disabled. */
+    size_t low;   /* Low watermark. */
+} bal_send_queue;
+
+/** bal_async_frames and bal_async_lines callback. `frame` points into the
+ * receive buffer (or a buffer the frame was assembled in), and is valid only
+ * during the call. */
+typedef void (*bal_frame_cb)(struct bal_socket*, const void* /*frame*/,
+    size_t /*len*/);
+
+/** Length-prefixed framing options (see bal_set_framing). The prefix holds the
+ * payload's length, excluding the prefix and CRC. */
+typedef struct {
+    size_t prefix_size; /**< Width of the length prefix: 1, 2, 4 or 8 bytes. */
+    size_t max_frame;   /**< Largest payload accepted (0 = the most the prefix can
+                             express, capped at BAL_FRAME_MAX_DEFAULT). */
+    uint32_t flags;     /**< BAL_FRAME_* flags. */
+} bal_framing;
+
+/* Framing state of a socket (see bal_set_framing, bal_async_frames and
+ * bal_async_lines). */
+typedef struct {
+    bal_framing opts;      /* Options; prefix_size is zero if framing is off. */
+    bal_frame_cb on_frame; /* Receives each complete frame (or line). */
+    uint8_t* big;          /* A frame too big for a receive buffer, being assembled. */
+    size_t big_len;        /* Bytes `big` holds when complete (payload and CRC). */
+    size_t big_have;       /* Bytes of it received so far. */
+    size_t lowat;          /* SO_RCVLOWAT last set (zero or one: the default). */
+    uint8_t delim;         /* Byte that ends each line. */
+    uint32_t line_flags;   /* BAL_LINE_* flags. */
+    size_t scanned;        /* Unconsumed bytes already known to hold no delimiter. */
+} bal_framer;
+
+/* A receive buffer lent to a socket by bal_async_recv, and the history that
+ * sizes the next one. */
+typedef struct {
+    uint8_t* data;    /* NULL while the socket holds no buffer. */
+    size_t start;     /* Offset of the first unconsumed byte. */
+    size_t end;       /* Offset just past the last received byte. */
+    size_t cls;       /* Size class of `data`. */
+    size_t want_cls;  /* Size class recent read events call for. */
+    size_t shrink;    /* Consecutive read events that fit the class below. */
+    uint64_t last_ns; /* When data last arrived (if idle reclaim is enabled). */
+} bal_recv_buf;
+
+/** Per-socket I/O counters. Updated without synchronization by whichever
+ * thread performs the I/O, so values read while I/O is in flight are
+ * approximate. */
+typedef struct {
+    uint64_t bytes_sent;             /**< Bytes accepted by send/sendto. */
+    uint64_t bytes_recvd;            /**< Bytes returned by recv/recvfrom. */
+    uint64_t syscalls;               /**< send/recv family calls made. */
+    uint64_t eagains;                /**< Calls that would have blocked. */
+    uint64_t events[BAL_EVT_COUNT];  /**< Events dispatched, indexed by bit
+                                          position (BAL_EVT_READ = 0). */
+} bal_socket_stats;
+
+/** Socket options applied in one pass by bal_create_ex/bal_accept_ex. Only
+ * the options whose BAL_OPT_* bits are set in `mask` are applied. */
+typedef struct {
+    uint32_t mask;               /**< Options to apply (BAL_OPT_*). */
+    int broadcast;               /**< SO_BROADCAST. */
+    int debug;                   /**< SO_DEBUG. */
+    struct linger linger;        /**< SO_LINGER. */
+    int keepalive;               /**< SO_KEEPALIVE. */
+    int oobinline;               /**< SO_OOBINLINE. */
+    int reuseaddr;               /**< SO_REUSEADDR. */
+    int sendbuf_size;            /**< SO_SNDBUF. */
+    int recvbuf_size;            /**< SO_RCVBUF. */
+    struct timeval send_timeout; /**< SO_SNDTIMEO. */
+    struct timeval recv_timeout; /**< SO_RCVTIMEO. */
+} bal_socket_opts;
+
 typedef struct bal_socket {
-    bal_descriptor sd;     /**< Socket descriptor. */
-    int addr_fam;          /**< Address family (e.g. AF_INET). */
-    int type;              /**< Socket type (e.g., SOCK_STREAM). */
-    int proto;             /**< Protocol (e.g., IPPROTO_TCP). */
-    uintptr_t user_data;   /**< Any user-supplied data that is desired. */
-    struct {               /**< Internal socket state data. */
-        uint32_t mask;     /**< Async I/O event mask. */
-        uint32_t bits;     /**< State bitmask. */
-        bal_async_cb proc; /**< Async I/O event callback. */
+    bal_descriptor sd;      /**< Socket descriptor. */
+    int addr_fam;           /**< Address family (e.g. AF_INET). */
+    int type;               /**< Socket type (e.g., SOCK_STREAM). */
+    int proto;              /**< Protocol (e.g., IPPROTO_TCP). */
+    uintptr_t user_data;    /**< Any user-supplied data that is desired. */
+    struct {                /**< Internal socket state data. */
+        uint32_t mask;      /**< Async I/O event mask. */
+        uint32_t bits;      /**< State bitmask. */
+        bal_async_cb proc;  /**< Async I/O event callback. */
+        bal_list_node node; /**< Async I/O registry linkage. */
+        bal_socket_opts opts; /**< Cached option values (mask = valid entries). */
+        size_t reactor;     /**< Index of the owning async I/O reactor. */
+        size_t slab;        /**< Index of the slab the socket came from. */
+        bal_socket_stats stats; /**< I/O counters. */
+        uint64_t reg;       /**< Registration number (unique within a reactor),
+                                 assigned by bal_async_poll. */
+        bal_send_queue sendq; /**< Data queued by bal_send_async. */
+        uint32_t pending;   /**< Events raised outside of polling, awaiting
+                                 delivery by the events thread. */
+# if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
+        atomic_bool read_paused; /**< Read interest suspended by bal_pause_read
+                                      (which any thread may call). */
+# else
+        volatile bool read_paused;
+# endif
+        bal_data_cb on_data; /**< bal_async_recv callback. */
+        bal_recv_buf recvb; /**< Received data not yet consumed by `on_data`. */
+        bal_framer framer;  /**< Length-prefixed framing state. */
     } state;
 } bal_socket;
 
@@ -79,28 +202,29 @@ typedef struct {
     char message[BAL_MAXERRORFMT];
 } bal_error;
 
-/** The internal error type. */
+/** The codes of an error, without its message (which bal_format_error will
+ * produce on demand). */
+typedef struct {
+    int code;       /**< The libbal error code (BAL_E_*). */
+    int os_code;    /**< The OS or getaddrinfo code, if code is BAL_E_PLATFORM. */
+    bool gai;       /**< true if `os_code` came from getaddrinfo. */
+} bal_error_codes;
+
+/** The internal error type. Only codes and locations are recorded when an
+ * error occurs; messages are formatted on demand by _bal_get_error. */
 typedef struct {
     int code;
     struct {
         const char* func;
-        const char* file;
+        const char* file;   /**< __file__ as supplied (not yet reduced to a basename). */
         uint32_t line;
     } loc;
     struct {
         int code;
-        char msg[BAL_MAXERROR];
+        bool gai;           /**< true if `code` came from getaddrinfo. */
     } os;
 } bal_thread_error_info;
 
-/* Node type for bal_list. */
-typedef struct _bal_list_node {
-    bal_descriptor key;
-    bal_socket* val;
-    struct _bal_list_node *prev;
-    struct _bal_list_node *next;
-} bal_list_node;
-
 /* List of socket descriptors and associated state data. */
 typedef struct {
     bal_list_node* head;
@@ -118,15 +242,149 @@ typedef struct {
     bool found;
 } bal_list_find_data;
 
+/** Heap allocation hooks. Set with bal_set_allocator before bal_init. */
 typedef struct {
-    bal_list* lst;        /** List of active socket descriptors and their states. */
-    bal_mutex mutex;      /** Mutex for access to `lst`. */
-    bal_thread thread;    /** Asynchronous I/O events thread. */
+    /** Returns zero-filled memory for `num` objects of `size` bytes each, or
+     * NULL on failure. */
+    void* (*calloc_fn)(size_t num, size_t size, void* ctx);
+    /** Releases memory obtained from `calloc_fn`. Must accept NULL. */
+    void (*free_fn)(void* ptr, void* ctx);
+    /** Passed through to each hook unmodified. */
+    void* ctx;
+} bal_allocator;
+
+/** Fixed-size object allocator statistics. */
+typedef struct {
+    size_t allocs;   /**< Number of objects handed out since initialization. */
+    size_t frees;    /**< Number of objects returned since initialization. */
+    size_t in_use;   /**< Number of objects currently handed out. */
+    size_t peak;     /**< Highest value of `in_use` observed. */
+    size_t chunks;   /**< Number of chunks obtained from the heap. */
+    size_t capacity; /**< Number of objects the chunks can hold in total. */
+} bal_slab_stats;
+
+/* Free list entry; overlays the first bytes of an unused object. */
+typedef struct _bal_slab_free {
+    struct _bal_slab_free* next;
+} bal_slab_free;
+
+/* Header of a chunk of objects obtained from the heap. */
+typedef struct _bal_slab_chunk {
+    struct _bal_slab_chunk* next;
+} bal_slab_chunk;
+
+/* Fixed-size object allocator. Objects are carved out of chunks, and freed
+ * objects are pushed onto the front of the free list, so that the next
+ * allocation reuses the most recently touched memory. */
+typedef struct {
+    bal_mutex mutex;        /** Mutex for access to the chunks and free list. */
+    size_t obj_size;        /** Size of each object, in bytes. */
+    size_t chunk_objs;      /** Number of objects per chunk. */
+    bal_slab_chunk* chunks; /** Chunks obtained from the heap. */
+    bal_slab_free* free;    /** Unused objects, most recently freed first. */
+    bal_slab_stats stats;   /** Allocation counters. */
+} bal_slab;
+
+/** Async I/O reactor counters. Kept by the reactor's events thread while it
+ * holds the reactor's mutex. */
+typedef struct {
+    uint64_t iterations;   /**< Event loop iterations. */
+    uint64_t wakeups;      /**< Polls that returned ready descriptors. */
+    uint64_t ready;        /**< Ready descriptors, summed over all wakeups. */
+    uint64_t max_ready;    /**< Most ready descriptors in a single wakeup. */
+    uint64_t dispatch_ns;  /**< Time spent dispatching events. */
+    uint64_t sockets;      /**< Sockets currently registered. */
+    uint64_t peak_sockets; /**< Most sockets registered at once (as of the start of
+                                an event loop iteration). */
+    bal_socket_stats io;   /**< I/O by sockets destroyed while assigned to
+                                this reactor, plus registered sockets. */
+} bal_reactor_stats;
+
+/** Library-wide counters: the sum of every reactor's counters. */
+typedef struct {
+    size_t reactors;         /**< Number of reactors. */
+    bal_reactor_stats total; /**< Aggregated counters (max_ready is the
+                                  maximum; peak_sockets is the most sockets
+                                  registered with all reactors at once). */
+} bal_stats;
+
+/** A log-linear latency histogram. Values are in nanoseconds; see
+ * BAL_HIST_SUB_BITS and bal_histogram_percentile. */
+typedef struct {
+    uint64_t count;                     /**< Number of recorded values. */
+    uint64_t min;                       /**< Smallest value (if count > 0). */
+    uint64_t max;                       /**< Largest value. */
+    uint64_t sum;                       /**< Sum of all values. */
+    uint64_t buckets[BAL_HIST_BUCKETS]; /**< Value counts per bucket. */
+} bal_histogram;
+
+/** Event loop latency histograms, recorded while enabled by bal_set_histograms. */
+typedef struct {
+    bal_histogram poll_wait;      /**< Time spent blocked in poll. */
+    bal_histogram dispatch_delay; /**< Time from poll returning until each
+                                       callback starts. */
+    bal_histogram callback[BAL_EVT_COUNT]; /**< Callback durations, indexed by
+                                                event bit position (BAL_EVT_READ = 0). */
+    bal_histogram loop_lag;       /**< How late each iteration began relative
+                                       to when the previous one planned it (its
+                                       timeout, or right after dispatching). */
+} bal_loop_histograms;
+
+/** A socket's place in a reactor's poll set, recorded while the set is built
+ * so that poll results go to the registration they were polled for. */
+typedef struct {
+    bal_descriptor sd; /**< The socket's descriptor (the pollfd's is -1 while idle). */
+    uint64_t reg;      /**< The socket's registration number. */
+} bal_poll_reg;
+
+/** An async I/O reactor: an events thread and the sockets registered with it. */
+typedef struct {
+    bal_list* lst;            /** List of active socket descriptors and their states. */
+    bal_mutex mutex;          /** Mutex for access to `lst`, `stats` and `hist`. */
+    bal_thread thread;        /** Asynchronous I/O events thread. */
+    size_t index;             /** Position in bal_as_container::reactors. */
+    bal_reactor_stats stats;  /** Counters (`sockets` and live I/O filled on read). */
+    bal_loop_histograms hist; /** Latency histograms. */
+    uint64_t regs;            /** Number of sockets ever registered. */
+    bal_socket* dispatching;  /** The socket whose events are being dispatched. */
+} bal_reactor;
+
+typedef struct {
+    bal_reactor* reactors; /** Reactors (allocated at initialization). */
+    size_t count;          /** Number of reactors. */
 # if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
     atomic_bool die;
 # else
     volatile bool die;
 # endif
+# if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
+    atomic_bool histograms; /** Whether latency histograms are recorded. */
+# else
+    volatile bool histograms;
+# endif
+    bal_slab slabs[BAL_MAX_REACTORS]; /** Allocators for bal_socket objects, one
+                                         per reactor (by index). */
+    bal_slab recv_bufs[BAL_RECV_BUF_CLASSES]; /** Pools of bal_async_recv buffers,
+                                                 by size class. */
+# if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
+    atomic_uint_fast32_t recv_idle_ms; /** See bal_set_recv_idle_reclaim. */
+# else
+    volatile uint_fast32_t recv_idle_ms;
+# endif
+# if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
+    atomic_size_t slab_in_use; /** Sockets allocated from all slabs. */
+    atomic_size_t slab_peak;   /** Highest value of `slab_in_use` observed. */
+# else
+    volatile size_t slab_in_use;
+    volatile size_t slab_peak;
+# endif
+# if defined(__HAVE_STDATOMICS__) && !defined(__cplusplus)
+    atomic_size_t registered;      /** Sockets registered with all reactors. */
+    atomic_size_t peak_registered; /** Highest value of `registered` observed. */
+# else
+    volatile size_t registered;
+    volatile size_t peak_registered;
+# endif
 } bal_as_container;
 
 typedef struct {
@@ -49,7 +49,7 @@ int main(int argc, char** argv)
         initializer balinit;
         scoped_socket main_sock {AF_INET, SOCK_STREAM, IPPROTO_TCP};
 
-        main_sock.on_connect = [](scoped_socket* sock)
+        main_sock.handlers().on_connect = [](scoped_socket* sock)
         {
             address peer_addr {};
             sock->get_peer_addr(peer_addr);
@@ -60,7 +60,7 @@ int main(int argc, char** argv)
             return true;
         };
 
-        main_sock.on_conn_fail = [](const scoped_socket* sock)
+        main_sock.handlers().on_conn_fail = [](const scoped_socket* sock)
         {
             const auto err = sock->get_error(false);
             PRINT_SD("connection failed! errror: %s", sock->get_descriptor(),
@@ -69,33 +69,27 @@ int main(int argc, char** argv)
             return false;
         };
 
-        main_sock.on_read = [&sb = send_buffer](scoped_socket* sock)
+        main_sock.handlers().on_data = [&sb = send_buffer](scoped_socket* sock,
+            const void* data, size_t len)
         {
-            std::array<char, read_buf_size> buf {};
-            if (ssize_t read = sock->recv(buf.data(), buf.size() - 1, 0); read > 0) {
-                PRINT_SD("read %ld bytes: '%s'", sock->get_descriptor(), read, buf.data());
-                std::stringstream strm {"Enter text to send (or '"};
-                strm << quit_msg << "')";
-                sb = get_input_line(strm.str(), helo_msg);
-                if (_bal_strsame(sb.c_str(), quit_msg, 4)) {
-                    sb.clear();
-                    quit();
-                } else {
-                    sock->want_write_events(true);
-                }
-            } else if (-1 == read) {
-                const auto err = sock->get_error(false);
-                PRINT_SD("read error %d (%s)!", sock->get_descriptor(), err.code,
-                    err.message.c_str());
+            const string msg {static_cast<const char*>(data), len};
+            PRINT_SD("read %zu bytes: '%s'", sock->get_descriptor(), len, msg.c_str());
+            std::stringstream strm {"Enter text to send (or '"};
+            strm << quit_msg << "')";
+            sb = get_input_line(strm.str(), helo_msg);
+            if (_bal_strsame(sb.c_str(), quit_msg, 4)) {
+                sb.clear();
+                quit();
+            } else {
+                sock->want_write_events(true);
             }
-            return true;
+            return len;
         };
 
-        main_sock.on_write = [&sb = send_buffer](scoped_socket* sock)
+        main_sock.handlers().on_write = [&sb = send_buffer](scoped_socket* sock)
         {
             if (!sb.empty()) {
-                if (ssize_t sent = sock->send(sb.data(), sb.size(),
-                    MSG_NOSIGNAL); sent > 0) {
+                if (ssize_t sent = sock->send(sb); sent > 0) {
                     PRINT_SD("wrote %ld bytes", sock->get_descriptor(), sent);
                 } else {
                     const auto err = sock->get_error(false);
@@ -109,14 +103,14 @@ int main(int argc, char** argv)
             return true;
         };
 
-        main_sock.on_close = [](const scoped_socket* sock)
+        main_sock.handlers().on_close = [](const scoped_socket* sock)
         {
             PRINT_SD("connection closed.", sock->get_descriptor());
             quit();
             return false;
         };
 
-        main_sock.on_error = [](const scoped_socket* sock)
+        main_sock.handlers().on_error = [](const scoped_socket* sock)
         {
             const auto err = sock->get_error(false);
             PRINT_SD("error: %d (%s)!", sock->get_descriptor(), err.code, err.message.c_str());
@@ -125,6 +119,7 @@ int main(int argc, char** argv)
         };
 
         main_sock.async_poll(BAL_EVT_CLIENT);
+        main_sock.async_recv();
 
         string remote_host = get_input_line("Enter server hostname", localaddr);
         PRINT("connecting to %s:%s...", remote_host.c_str(), portnum);
@@ -0,0 +1,128 @@
+/*
+ * balcoserver.cc
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "balcommon.hh"
+#include <memory>
+#include <atomic>
+
+using namespace std;
+using namespace bal;
+using namespace bal::common;
+
+#if defined(__HAVE_COROUTINES__)
+static atomic_size_t _clients {0};
+
+/* echoes everything the client sends back to it, until it disconnects. the
+ * socket is owned by this coroutine's frame. */
+static task serve_client(unique_ptr<scoped_socket> client_sock)
+{
+    const auto sd = client_sock->get_descriptor();
+
+    try {
+        array<char, 4096> buf {};
+        for (;;) {
+            const auto read = co_await client_sock->async_recv(buf);
+            if (read <= 0) {
+                PRINT_SD("connection closed", sd);
+                break;
+            }
+
+            PRINT_SD("read %zd bytes; echoing...", sd, read);
+            co_await client_sock->async_send_all(buf.data(), static_cast<size_t>(read));
+        }
+    } catch (bal::exception& ex) {
+        PRINT_SD("connection closed with error: '%s'!", sd, ex.what());
+    }
+
+    client_sock->close();
+    PRINT("now have %zu client(s)", --_clients);
+}
+
+static task accept_clients(scoped_socket& main_sock)
+{
+    try {
+        for (;;) {
+            auto client_sock = make_unique<scoped_socket>();
+            address client_addr;
+            co_await main_sock.async_accept(*client_sock, client_addr);
+
+            /* the coroutine sees the close or error as the result of its
+             * receive or send, so the default handlers mustn't close it. */
+            client_sock->handlers().on_close = nullptr;
+            client_sock->handlers().on_error = nullptr;
+            client_sock->async_poll(BAL_EVT_NORMAL);
+
+            address_info addrinfo = client_addr.get_address_info();
+            PRINT("got connection from %s %s:%s on " BAL_SOCKET_SPEC "; now have %zu"
+                " client(s)", addrinfo.get_type().c_str(), addrinfo.get_addr().c_str(),
+                addrinfo.get_port().c_str(), client_sock->get_descriptor(), ++_clients);
+
+            serve_client(std::move(client_sock));
+        }
+    } catch (bal::exception& ex) {
+        PRINT("error: stopped accepting connections: '%s'!", ex.what());
+    }
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    BAL_UNUSED(argc);
+    BAL_UNUSED(argv);
+
+    try {
+        print_startup_banner("balcoserver");
+
+#if defined(__HAVE_COROUTINES__)
+        if (!initialize()) {
+            throw bal::exception("failed to initialize bal::common");
+        }
+
+        initializer balinit;
+
+        scoped_socket main_sock {AF_INET, SOCK_STREAM, IPPROTO_TCP};
+        main_sock.set_reuseaddr(1);
+        main_sock.bind_all(portnum);
+        main_sock.async_poll(BAL_EVT_NORMAL);
+        main_sock.listen(SOMAXCONN);
+
+        PRINT("listening on %s; ctrl+c to exit...", portnum);
+        accept_clients(main_sock);
+
+        do {
+            bal_sleep_msec(sleep_interval);
+            bal_thread_yield();
+        } while (should_run());
+
+        return EXIT_SUCCESS;
+#else
+        PRINT_0("error: this compiler doesn't support coroutines!");
+        return EXIT_FAILURE;
+#endif
+    } catch (bal::exception& ex) {
+        PRINT("error: caught exception: '%s'!", ex.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -44,47 +44,26 @@ int main(int argc, char** argv)
             throw bal::exception("failed to initialize bal::common");
         }
 
-        string send_buffer;
         initializer balinit;
 
-        auto client_on_read = [&send_buffer](scoped_socket* sock)
+        auto client_on_data = [](scoped_socket* sock, const void* data, size_t len)
         {
-            constexpr size_t buf_size = 2048;
-            std::array<char, buf_size> buf {};
-
-            if (ssize_t read = sock->recv(buf.data(), buf.size() - 1, 0); read > 0) {
-                PRINT_SD("read %ld bytes: '%s'", sock->get_descriptor(), read, buf.data());
-                send_buffer = "You said '";
-                send_buffer += buf.data();
-                send_buffer += "'; acknowledged.";
-                sock->want_write_events(true);
-            } else if (-1 == read) {
-                const auto err = sock->get_error(false);
-                PRINT_SD("read error %d (%s)!", sock->get_descriptor(), err.code,
-                    err.message.c_str());
-            } else {
-                PRINT_SD("read EOF", sock->get_descriptor());
-            }
+            const string msg {static_cast<const char*>(data), len};
+            PRINT_SD("read %zu bytes: '%s'", sock->get_descriptor(), len, msg.c_str());
 
-            return true;
-        };
+            string reply = "You said '";
+            reply += msg;
+            reply += "'; acknowledged.";
 
-        auto client_on_write = [&send_buffer](scoped_socket* sock)
-        {
-            if (!send_buffer.empty()) {
-                if (ssize_t sent = sock->send(send_buffer.data(), send_buffer.size(),
-                    MSG_NOSIGNAL); sent > 0) {
-                    PRINT_SD("wrote %ld bytes", sock->get_descriptor(), sent);
-                } else {
-                    const auto err = sock->get_error(false);
-                    PRINT_SD("write error %d (%s)!", sock->get_descriptor(), err.code,
-                        err.message.c_str());
-                }
-                send_buffer.clear();
+            /* the reply is copied if it can't all be sent right away; the rest
+             * goes out as the socket becomes writable. */
+            if (!sock->send_async(reply.data(), static_cast<bal_iolen>(reply.size()))) {
+                const auto err = sock->get_error(false);
+                PRINT_SD("write error %d (%s)!", sock->get_descriptor(), err.code,
+                    err.message.c_str());
             }
 
-            sock->want_write_events(false);
-            return true;
+            return len;
         };
 
         auto client_on_close = [](scoped_socket* sock)
@@ -101,28 +80,34 @@ int main(int argc, char** argv)
             return false;
         };
 
+        /* every client shares one set of handlers, so accepting a connection
+         * (or moving it into _clients) doesn't copy any closures. */
+        handler_set<scoped_socket> client_handlers;
+        client_handlers.on_data  = client_on_data;
+        client_handlers.on_close = client_on_close;
+        client_handlers.on_error = client_on_error;
+        const auto shared_handlers = std::move(client_handlers).share();
+
         scoped_socket main_sock {AF_INET, SOCK_STREAM, IPPROTO_TCP};
-        main_sock.on_incoming_conn = [=](scoped_socket* sock)
+        main_sock.handlers().on_incoming_conn = [=](scoped_socket* sock)
         {
-            scoped_socket client_sock;
-            address client_addr {};
-            sock->accept(client_sock, client_addr);
-
-            client_sock.on_read  = client_on_read;
-            client_sock.on_write = client_on_write;
-            client_sock.on_close = client_on_close;
-            client_sock.on_error = client_on_error;
-
-            client_sock.async_poll(BAL_EVT_NORMAL);
-
-            address_info addrinfo = client_addr.get_address_info();
-            PRINT("got connection from %s %s:%s on " BAL_SOCKET_SPEC " (0x%" PRIxPTR ");"
-                " now have %zu client(s)", addrinfo.get_type().c_str(),
-                addrinfo.get_addr().c_str(), addrinfo.get_port().c_str(),
-                client_sock.get_descriptor(), bit_cast<uintptr_t>(client_sock.get()),
-                _clients.size() + 1);
-
-            _clients[client_sock.get_descriptor()] = std::move(client_sock);
+            sock->accept_many(SOMAXCONN, [=](scoped_socket& client_sock,
+                const address& client_addr)
+            {
+                client_sock.set_handlers(shared_handlers);
+
+                client_sock.async_poll(BAL_EVT_NORMAL);
+                client_sock.async_recv();
+
+                address_info addrinfo = client_addr.get_address_info();
+                PRINT("got connection from %s %s:%s on " BAL_SOCKET_SPEC " (0x%" PRIxPTR ");"
+                    " now have %zu client(s)", addrinfo.get_type().c_str(),
+                    addrinfo.get_addr().c_str(), addrinfo.get_port().c_str(),
+                    client_sock.get_descriptor(), bit_cast<uintptr_t>(client_sock.get()),
+                    _clients.size() + 1);
+
+                _clients[client_sock.get_descriptor()] = std::move(client_sock);
+            });
             return true;
         };
 
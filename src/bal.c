@@ -27,6 +27,7 @@
 #include "bal/internal.h"
 #include "bal/helpers.h"
 #include "bal/state.h"
+#include "bal/alloc.h"
 
 #if defined(__WIN__)
 # pragma comment(lib, "ws2_32.lib")
@@ -125,6 +126,77 @@ bool bal_cleanup(void)
     return cleanup;
 }
 
+bool bal_set_allocator(const bal_allocator* alloc)
+{
+    bool set = _bal_once(&_bal_static_once_init, &_bal_static_once_init_func);
+    BAL_ASSERT(set);
+
+    if (!set)
+        return _bal_seterror(_BAL_E_INTERNAL);
+
+    _BAL_MUTEX_COUNTER_INIT(setalloc);
+    _BAL_LOCK_MUTEX(&_bal_state.mutex, setalloc);
+
+#if defined(__HAVE_STDATOMICS__)
+    uint_fast32_t magic = atomic_load(&_bal_state.magic);
+#else
+    uint_fast32_t magic = _bal_state.magic;
+#endif
+
+    /* the allocator may only be swapped while nothing allocated by libbal is
+     * live, which can only be guaranteed before initialization. */
+    if (BAL_MAGIC == magic)
+        set = _bal_seterror(_BAL_E_DUPEINIT);
+    else
+        set = _bal_set_allocator(alloc);
+
+    _BAL_UNLOCK_MUTEX(&_bal_state.mutex, setalloc);
+    _BAL_MUTEX_COUNTER_CHECK(setalloc);
+
+    _bal_dbglog("allocator %s %s", NULL != alloc ? "set" : "reset",
+        set ? "succeeded" : "failed");
+
+    return set;
+}
+
+bool bal_set_reactor_count(size_t count)
+{
+    if (count < 1 || count > BAL_MAX_REACTORS)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bool set = _bal_once(&_bal_static_once_init, &_bal_static_once_init_func);
+    BAL_ASSERT(set);
+
+    if (!set)
+        return _bal_seterror(_BAL_E_INTERNAL);
+
+    _BAL_MUTEX_COUNTER_INIT(setreactors);
+    _BAL_LOCK_MUTEX(&_bal_state.mutex, setreactors);
+
+#if defined(__HAVE_STDATOMICS__)
+    uint_fast32_t magic = atomic_load(&_bal_state.magic);
+#else
+    uint_fast32_t magic = _bal_state.magic;
+#endif
+
+    /* the reactors are started by bal_init, and sockets refer to them by index. */
+    if (BAL_MAGIC == magic) {
+        set = _bal_seterror(_BAL_E_DUPEINIT);
+    } else {
+        _bal_as_container.count = count;
+    }
+
+    _BAL_UNLOCK_MUTEX(&_bal_state.mutex, setreactors);
+    _BAL_MUTEX_COUNTER_CHECK(setreactors);
+
+    return set;
+}
+
+size_t bal_get_reactor_count(void)
+{
+    return _bal_as_container.count;
+}
+
 bool bal_isinitialized(void)
 {
 #if defined(__HAVE_STDATOMICS__)
@@ -147,20 +219,22 @@ bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask)
     if (!_bal_okptrnf(proc) && 0U != mask)
         return _bal_seterror(_BAL_E_INVALIDARG);
 
-    bool retval = false;
+    bool retval    = false;
+    bal_reactor* r = _bal_get_reactor(s);
 
     _BAL_MUTEX_COUNTER_INIT(aspoll);
-    _BAL_LOCK_MUTEX(&_bal_as_container.mutex, aspoll);
+    _BAL_LOCK_MUTEX(&r->mutex, aspoll);
 
     if (0U == mask) {
         /* this thread holds the mutex for the list, so it can remove an iterator. */
         bal_socket* d = NULL;
-        bool success  = _bal_list_remove(_bal_as_container.lst, s->sd, &d);
+        bool success  = _bal_list_remove(r->lst, s->sd, &d);
         BAL_ASSERT(NULL != d && s == d);
 
         if (success) {
             /* The iterator is kaput, but s is still allocated. Since this is a
              * removal request (mask = 0), don't close or delete the socket. */
+            _bal_count_registration(false);
             _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list", s->sd, d);
             retval = true;
         } else {
@@ -168,23 +242,27 @@ bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask)
         }
     } else {
         bal_socket* d = NULL;
-        if (_bal_list_find(_bal_as_container.lst, s->sd, &d)) {
+        if (_bal_list_find(r->lst, s->sd, &d)) {
             BAL_ASSERT(NULL != d && s == d);
             s->state.mask = mask;
             s->state.proc = proc;
+            _bal_sendq_keep_write(s);
             retval        = true;
             _bal_dbglog("updated socket "BAL_SOCKET_SPEC" (%p)", s->sd, s);
         } else {
             bool success = false;
-            if (bal_set_io_mode(s, true)) {
+            if (bal_isbitset(s->state.bits, BAL_S_NONBLOCK) || bal_set_io_mode(s, true)) {
                 s->state.mask = mask;
                 s->state.proc = proc;
-                success = _bal_list_add(_bal_as_container.lst, s->sd, s);
+                s->state.reg  = ++r->regs;
+                _bal_sendq_keep_write(s);
+                success = _bal_list_add(r->lst, s->sd, s);
                 retval  = success;
             }
             if (success) {
-                _bal_dbglog("added socket "BAL_SOCKET_SPEC" to list (%p"
-                            ", mask = %08"PRIx32")", s->sd, s, s->state.mask);
+                _bal_count_registration(true);
+                _bal_dbglog("added socket "BAL_SOCKET_SPEC" to reactor %zu (%p"
+                            ", mask = %08"PRIx32")", s->sd, r->index, s, s->state.mask);
             } else {
                 _bal_dbglog("error: failed to add socket "BAL_SOCKET_SPEC
                             " to list!", s->sd);
@@ -192,31 +270,112 @@ bool bal_async_poll(bal_socket* s, bal_async_cb proc, uint32_t mask)
         }
     }
 
-    _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, aspoll);
+    _BAL_UNLOCK_MUTEX(&r->mutex, aspoll);
     _BAL_MUTEX_COUNTER_CHECK(aspoll);
 
     return retval;
 }
 
+bool bal_set_reactor(bal_socket* s, size_t reactor)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    if (reactor >= _bal_as_container.count)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    /* moving a registered socket would leave it in the old reactor's list. */
+    if (_bal_get_boolean(&_bal_async_poll_init)) {
+        bal_reactor* r = _bal_get_reactor(s);
+        bal_socket* d  = NULL;
+
+        _BAL_MUTEX_COUNTER_INIT(setreactor);
+        _BAL_LOCK_MUTEX(&r->mutex, setreactor);
+        bool found = _bal_list_find(r->lst, s->sd, &d);
+        _BAL_UNLOCK_MUTEX(&r->mutex, setreactor);
+        _BAL_MUTEX_COUNTER_CHECK(setreactor);
+
+        if (found)
+            return _bal_seterror(_BAL_E_INUSE);
+    }
+
+    s->state.reactor = reactor;
+    bal_setbitshigh(&s->state.bits, BAL_S_REACTOR);
+
+    return true;
+}
+
 bool bal_create(bal_socket** s, uintptr_t user_data, int addr_fam, int type, int proto)
 {
     bool retval = false;
 
     if (_bal_okptrptr(s)) {
-        *s = calloc(1, sizeof(bal_socket));
-        if (!_bal_okptrnf(*s)) {
+        bal_descriptor sd = socket(addr_fam, type, proto);
+        if (-1 == sd) {
             _bal_handlelasterr();
+            *s = NULL;
         } else {
-            (*s)->sd = socket(addr_fam, type, proto);
-            if (-1 == (*s)->sd) {
-                _bal_handlelasterr();
-                _bal_safefree(s);
+            *s = _bal_socket_alloc(sd, NULL);
+            if (!_bal_okptrnf(*s)) {
+                _bal_close_descriptor(sd);
             } else {
                 (*s)->addr_fam  = addr_fam;
                 (*s)->type      = type;
                 (*s)->proto     = proto;
                 (*s)->user_data = user_data;
                 retval          = true;
+
+                if (SOCK_STREAM == type)
+                    bal_setbitshigh(&(*s)->state.bits, BAL_S_IDLE);
+            }
+        }
+    }
+
+    return retval;
+}
+
+bool bal_create_ex(bal_socket** s, uintptr_t user_data, int addr_fam, int type, int proto,
+    const bal_socket_opts* opts)
+{
+    bool retval = false;
+
+    if (_bal_okptrptr(s)) {
+#if defined(__HAVE_SOCK_NONBLOCK__)
+        bal_descriptor sd = socket(addr_fam, type | SOCK_NONBLOCK | SOCK_CLOEXEC, proto);
+#else
+        bal_descriptor sd = socket(addr_fam, type, proto);
+#endif
+        if (-1 == sd) {
+            _bal_handlelasterr();
+            *s = NULL;
+        } else {
+            *s = _bal_socket_alloc(sd, NULL);
+            if (!_bal_okptrnf(*s)) {
+                _bal_close_descriptor(sd);
+            } else {
+                (*s)->addr_fam  = addr_fam;
+                (*s)->type      = type;
+                (*s)->proto     = proto;
+                (*s)->user_data = user_data;
+
+                if (SOCK_STREAM == type)
+                    bal_setbitshigh(&(*s)->state.bits, BAL_S_IDLE);
+#if defined(__HAVE_SOCK_NONBLOCK__)
+                bal_setbitshigh(&(*s)->state.bits, BAL_S_NONBLOCK);
+                retval = true;
+#else
+                retval = bal_set_io_mode(*s, true);
+# if !defined(__WIN__)
+                if (retval && -1 == fcntl((*s)->sd, F_SETFD, FD_CLOEXEC)) {
+                    _bal_handlelasterr();
+                    retval = false;
+                }
+# endif
+#endif
+                if (retval && NULL != opts)
+                    retval = _bal_apply_opts(*s, opts);
+                if (!retval)
+                    (void)bal_close(s, true);
             }
         }
     }
@@ -260,34 +419,39 @@ bool bal_auto_socket(bal_socket** s, uintptr_t user_data, int addr_fam, int prot
 void bal_destroy(bal_socket** s)
 {
     if (_bal_okptrptr(s) && _bal_okptr(*s)) {
-        _BAL_MUTEX_COUNTER_INIT(destroy);
-        _BAL_LOCK_MUTEX(&_bal_as_container.mutex, destroy);
-
         /* if async I/O is active, just to be safe, ensure that the socket is not
-         * currently in the async I/O list. */
+         * currently in its reactor's list. */
         if (_bal_get_boolean(&_bal_async_poll_init)) {
+            bal_reactor* r = _bal_get_reactor(*s);
+
+            _BAL_MUTEX_COUNTER_INIT(destroy);
+            _BAL_LOCK_MUTEX(&r->mutex, destroy);
+
             bal_socket* d = NULL;
-            bool removed  = _bal_list_remove(_bal_as_container.lst, (*s)->sd, &d);
+            bool removed  = _bal_list_remove(r->lst, (*s)->sd, &d);
 
             if (removed) {
                 BAL_ASSERT(*s == d);
+                _bal_count_registration(false);
                 _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list",
                     (*s)->sd, *s);
             }
-        }
 
-        if (!bal_isbitset((*s)->state.bits, BAL_S_CLOSE)) {
-            _bal_dbglog("warning: freeing possibly open socket "BAL_SOCKET_SPEC
-                        " (%p)", (*s)->sd, *s);
+            if (r->dispatching == *s) {
+                /* one of the socket's own handlers is destroying it, and the
+                 * events thread has yet to return from the dispatch; it frees
+                 * the socket afterwards. */
+                bal_setbitshigh(&(*s)->state.bits, BAL_S_DESTROY);
+                *s = NULL;
+            } else {
+                _bal_destroy(s);
+            }
+
+            _BAL_UNLOCK_MUTEX(&r->mutex, destroy);
+            _BAL_MUTEX_COUNTER_CHECK(destroy);
         } else {
-            _bal_dbglog("freeing socket "BAL_SOCKET_SPEC" (%p)", (*s)->sd, *s);
+            _bal_destroy(s);
         }
-
-        memset(*s, 0, sizeof(bal_socket));
-        _bal_safefree(s);
-
-        _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, destroy);
-        _BAL_MUTEX_COUNTER_CHECK(destroy);
     }
 }
 
@@ -379,6 +543,7 @@ bool bal_connect_addrlist(bal_socket* s, bal_addrlist* al)
 #endif
                 bal_setbitshigh(&s->state.mask, BAL_EVT_WRITE);
                 bal_setbitshigh(&s->state.bits, BAL_S_CONNECT);
+                bal_setbitslow(&s->state.bits, BAL_S_IDLE);
                 retval = true;
                 break;
             } else {
@@ -396,6 +561,36 @@ ssize_t bal_send(const bal_socket* s, const void* data, bal_iolen len, int flags
 
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
         sent = send(s->sd, data, len, flags);
+        _bal_count_io(s, sent, true);
+        if (-1 == sent)
+            _bal_handlelasterr();
+    }
+
+    return sent;
+}
+
+ssize_t bal_sendv(const bal_socket* s, const bal_iovec* iov, size_t count, int flags)
+{
+    ssize_t sent = -1;
+
+    if (_bal_oksock(s) && _bal_okptr(iov) && _bal_oklen(count)) {
+        if (count > BAL_IOV_MAX)
+            count = BAL_IOV_MAX;
+#if defined(__WIN__)
+        DWORD bytes = 0;
+        if (0 == WSASend(s->sd, (LPWSABUF)iov, (DWORD)count, &bytes, (DWORD)flags, NULL, NULL))
+            sent = (ssize_t)bytes;
+#else
+        struct msghdr msg = {0};
+        msg.msg_iov    = (struct iovec*)iov;
+# if defined(__linux__)
+        msg.msg_iovlen = count;
+# else
+        msg.msg_iovlen = (int)count;
+# endif
+        sent = sendmsg(s->sd, &msg, flags);
+#endif
+        _bal_count_io(s, sent, true);
         if (-1 == sent)
             _bal_handlelasterr();
     }
@@ -403,13 +598,340 @@ ssize_t bal_send(const bal_socket* s, const void* data, bal_iolen len, int flags
     return sent;
 }
 
+bool bal_send_async(bal_socket* s, const void* data, bal_iolen len, bal_free_cb free_cb)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s) || !_bal_okptr(data) || !_bal_oklen(len))
+        return false;
+
+    bool retval    = true;
+    size_t offset  = 0;
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(sendasync);
+    _BAL_LOCK_MUTEX(&r->mutex, sendasync);
+
+    /* anything sent now would overtake data that is already queued. while a
+     * connect may be pending, a failed send just means the data has to wait
+     * (a failed connect is reported by its own event). */
+    if (NULL == s->state.sendq.head) {
+        ssize_t sent = send(s->sd, data, len, MSG_NOSIGNAL);
+        _bal_count_io(s, sent, true);
+        if (sent > 0)
+            offset = (size_t)sent;
+        else if (-1 == sent && !_bal_would_block() &&
+            !bal_isbitset(s->state.bits, BAL_S_CONNECT))
+            retval = _bal_handlelasterr();
+    }
+
+    if (retval) {
+        if ((size_t)len == offset) {
+            if (NULL != free_cb)
+                free_cb((void*)data);
+        } else {
+            /* the events thread delivers BAL_EVT_WBLOCKED, as it does
+             * BAL_EVT_WDRAINED; the callback never runs on this thread. */
+            retval = _bal_sendq_push(s, data, (size_t)len, offset, free_cb);
+            if (retval && _bal_sendq_check_high(s))
+                _bal_raise_events(s, BAL_EVT_WBLOCKED);
+        }
+    }
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, sendasync);
+    _BAL_MUTEX_COUNTER_CHECK(sendasync);
+
+    return retval;
+}
+
+size_t bal_get_send_pending(const bal_socket* s)
+{
+    return _bal_okptr(s) ? s->state.sendq.bytes : 0;
+}
+
+bool bal_set_send_watermarks(bal_socket* s, size_t high, size_t low)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s))
+        return false;
+
+    if (0U != high && low >= high)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(watermarks);
+    _BAL_LOCK_MUTEX(&r->mutex, watermarks);
+
+    /* a socket that is already blocked still gets BAL_EVT_WDRAINED, at the
+     * new low watermark (or when the queue empties, if disabled). */
+    s->state.sendq.high = high;
+    s->state.sendq.low  = 0U != high ? low : 0U;
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, watermarks);
+    _BAL_MUTEX_COUNTER_CHECK(watermarks);
+
+    return true;
+}
+
+bool bal_get_send_watermarks(const bal_socket* s, size_t* high, size_t* low)
+{
+    if (!_bal_oksock(s) || !_bal_okptr(high) || !_bal_okptr(low))
+        return false;
+
+    *high = s->state.sendq.high;
+    *low  = s->state.sendq.low;
+
+    return true;
+}
+
+bool bal_pause_read(bal_socket* s)
+{
+    /* no lock: this is typically called for the other socket of a pair, from
+     * the callback of one whose reactor may differ; the flag is atomic, and the
+     * events thread picks the change up when it next polls. */
+    if (!_bal_oksock(s))
+        return false;
+
+    _bal_set_boolean(&s->state.read_paused, true);
+    return true;
+}
+
+bool bal_resume_read(bal_socket* s)
+{
+    if (!_bal_oksock(s))
+        return false;
+
+    _bal_set_boolean(&s->state.read_paused, false);
+    return true;
+}
+
+bool bal_is_read_paused(const bal_socket* s)
+{
+    return _bal_okptr(s) && _bal_get_boolean(&s->state.read_paused);
+}
+
+bool bal_async_recv(bal_socket* s, bal_data_cb on_data)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s))
+        return false;
+
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(asyncrecv);
+    _BAL_LOCK_MUTEX(&r->mutex, asyncrecv);
+
+    /* unconsumed data is kept for a replacement handler, but not once the
+     * socket goes back to plain read events. */
+    if ((_bal_frame_on_data == s->state.on_data || _bal_line_on_data == s->state.on_data) &&
+        on_data != s->state.on_data)
+        _bal_frame_reset(s);
+
+    s->state.on_data = on_data;
+    if (NULL == on_data)
+        _bal_recvbuf_release(s, true);
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, asyncrecv);
+    _BAL_MUTEX_COUNTER_CHECK(asyncrecv);
+
+    return true;
+}
+
+bool bal_set_framing(bal_socket* s, const bal_framing* framing)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s))
+        return false;
+
+    bal_framing opts = {0};
+    if (NULL != framing) {
+        opts = *framing;
+        if ((1U != opts.prefix_size && 2U != opts.prefix_size &&
+             4U != opts.prefix_size && 8U != opts.prefix_size) ||
+            0U != (opts.flags & ~(BAL_FRAME_BIG_ENDIAN | BAL_FRAME_CRC32C)))
+            return _bal_seterror(_BAL_E_INVALIDARG);
+
+        if (0U == opts.max_frame)
+            opts.max_frame = BAL_FRAME_MAX_DEFAULT;
+
+        /* no frame can be longer than its prefix is able to describe. */
+        if (opts.prefix_size < sizeof(uint64_t)) {
+            uint64_t limit = (1ULL << (opts.prefix_size * 8U)) - 1ULL;
+            if ((uint64_t)opts.max_frame > limit)
+                opts.max_frame = (size_t)limit;
+        }
+    }
+
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(setframing);
+    _BAL_LOCK_MUTEX(&r->mutex, setframing);
+
+    /* without a format there are no frames to deliver. */
+    if (NULL == framing && _bal_frame_on_data == s->state.on_data) {
+        _bal_frame_reset(s);
+        s->state.on_data = NULL;
+        _bal_recvbuf_release(s, true);
+    }
+
+    s->state.framer.opts = opts;
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, setframing);
+    _BAL_MUTEX_COUNTER_CHECK(setframing);
+
+    return true;
+}
+
+bool bal_async_frames(bal_socket* s, bal_frame_cb on_frame)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s))
+        return false;
+
+    bool retval    = true;
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(asyncframes);
+    _BAL_LOCK_MUTEX(&r->mutex, asyncframes);
+
+    if (NULL == on_frame) {
+        if (_bal_frame_on_data == s->state.on_data) {
+            _bal_frame_reset(s);
+            s->state.on_data = NULL;
+            _bal_recvbuf_release(s, true);
+        }
+    } else if (0U == s->state.framer.opts.prefix_size) {
+        retval = _bal_seterror(_BAL_E_INVALIDARG);
+    } else {
+        if (_bal_line_on_data == s->state.on_data)
+            _bal_frame_reset(s);
+        s->state.framer.on_frame = on_frame;
+        s->state.on_data         = _bal_frame_on_data;
+    }
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, asyncframes);
+    _BAL_MUTEX_COUNTER_CHECK(asyncframes);
+
+    return retval;
+}
+
+bool bal_async_lines(bal_socket* s, bal_frame_cb on_line, char delim, uint32_t flags)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s))
+        return false;
+
+    if (0U != (flags & ~BAL_LINE_CRLF))
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(asynclines);
+    _BAL_LOCK_MUTEX(&r->mutex, asynclines);
+
+    if (NULL == on_line) {
+        if (_bal_line_on_data == s->state.on_data) {
+            _bal_frame_reset(s);
+            s->state.on_data = NULL;
+            _bal_recvbuf_release(s, true);
+        }
+    } else {
+        /* a different delimiter invalidates what has been scanned. */
+        if (_bal_frame_on_data == s->state.on_data || _bal_line_on_data == s->state.on_data)
+            _bal_frame_reset(s);
+        s->state.framer.on_frame   = on_line;
+        s->state.framer.delim      = (uint8_t)delim;
+        s->state.framer.line_flags = flags;
+        s->state.on_data           = _bal_line_on_data;
+    }
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, asynclines);
+    _BAL_MUTEX_COUNTER_CHECK(asynclines);
+
+    return true;
+}
+
+bool bal_send_frame(bal_socket* s, const void* data, size_t len)
+{
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (!_bal_oksock(s) || (0U != len && !_bal_okptr(data)))
+        return false;
+
+    bal_reactor* r = _bal_get_reactor(s);
+
+    _BAL_MUTEX_COUNTER_INIT(sendframe);
+    _BAL_LOCK_MUTEX(&r->mutex, sendframe);
+    bal_framing opts = s->state.framer.opts;
+    _BAL_UNLOCK_MUTEX(&r->mutex, sendframe);
+    _BAL_MUTEX_COUNTER_CHECK(sendframe);
+
+    if (0U == opts.prefix_size || len > opts.max_frame)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    bool big_endian = bal_isbitset(opts.flags, BAL_FRAME_BIG_ENDIAN);
+    bool crc        = bal_isbitset(opts.flags, BAL_FRAME_CRC32C);
+    size_t total    = opts.prefix_size + len + (crc ? sizeof(uint32_t) : 0U);
+
+    if ((size_t)(bal_iolen)total != total)
+        return _bal_seterror(_BAL_E_BADBUFLEN);
+
+    uint8_t* frame = _bal_calloc(1, total);
+    if (!_bal_okptr(frame))
+        return false;
+
+    _bal_frame_put_uint(frame, opts.prefix_size, big_endian, (uint64_t)len);
+    if (0U != len)
+        memcpy(frame + opts.prefix_size, data, len);
+    if (crc)
+        _bal_frame_put_uint(frame + opts.prefix_size + len, sizeof(uint32_t),
+            big_endian, _bal_crc32c(0U, data, len, true));
+
+    /* the send queue only takes ownership of the frame on success. */
+    if (!bal_send_async(s, frame, (bal_iolen)total, &_bal_free)) {
+        _bal_free(frame);
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t bal_crc32c(uint32_t crc, const void* data, size_t len)
+{
+    bool init = _bal_once(&_bal_static_once_init, &_bal_static_once_init_func);
+    BAL_ASSERT_UNUSED(init, init);
+
+    if (0U == len)
+        return crc;
+
+    if (!_bal_okptr(data))
+        return crc;
+
+    return _bal_crc32c(crc, data, len, true);
+}
+
 ssize_t bal_recv(const bal_socket* s, void* data, bal_iolen len, int flags)
 {
     ssize_t read = -1;
 
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
         read = recv(s->sd, data, len, flags);
-        if (0 >= read)
+        _bal_count_io(s, read, false);
+        /* zero means the peer closed the connection, which isn't an error. */
+        if (-1 == read)
             _bal_handlelasterr();
     }
 
@@ -442,6 +964,7 @@ ssize_t bal_sendto_addr(const bal_socket* s, const bal_sockaddr* sa, const void*
 
     if (_bal_oksock(s) && _bal_okptr(sa) && _bal_okptr(data) && _bal_oklen(len)) {
         sent = sendto(s->sd, data, len, flags, (const struct sockaddr*)sa, _BAL_SASIZE(*sa));
+        _bal_count_io(s, sent, true);
         if (-1 == sent)
             _bal_handlelasterr();
     }
@@ -457,6 +980,7 @@ ssize_t bal_recvfrom(const bal_socket* s, void* data, bal_iolen len, int flags,
     if (_bal_oksock(s) && _bal_okptr(data) && _bal_oklen(len)) {
         socklen_t sasize = sizeof(bal_sockaddr);
         read = recvfrom(s->sd, data, len, flags, (struct sockaddr*)res, &sasize);
+        _bal_count_io(s, read, false);
         if (0 >= read)
             _bal_handlelasterr();
     }
@@ -518,6 +1042,7 @@ bool bal_listen(bal_socket* s, int backlog)
         if (0 == listen(s->sd, backlog)) {
             bal_setbitshigh(&s->state.mask, BAL_EVT_READ);
             bal_setbitshigh(&s->state.bits, BAL_S_LISTEN);
+            bal_setbitslow(&s->state.bits, BAL_S_IDLE);
             retval = true;
         } else {
             _bal_handlelasterr();
@@ -527,33 +1052,231 @@ bool bal_listen(bal_socket* s, int backlog)
     return retval;
 }
 
+bool bal_listen_sharded(bal_socket** socks, size_t count, int addr_fam,
+    const char* addr, const char* srv, int backlog, uint32_t flags)
+{
+#if !defined(__HAVE_SO_REUSEPORT__)
+    BAL_UNUSED(socks);
+    BAL_UNUSED(count);
+    BAL_UNUSED(addr_fam);
+    BAL_UNUSED(addr);
+    BAL_UNUSED(srv);
+    BAL_UNUSED(backlog);
+    BAL_UNUSED(flags);
+    return _bal_seterror(_BAL_E_UNAVAIL);
+#else
+    if (!_bal_okptr(socks) || !_bal_oklen(count) || !_bal_okstr(srv))
+        return false;
+
+# if !defined(__HAVE_REUSEPORT_CBPF__)
+    if (bal_isbitset(flags, BAL_SHARD_STEER_CPU))
+        return _bal_seterror(_BAL_E_UNAVAIL);
+# endif
+
+    bal_socket_opts opts = {0};
+    opts.mask            = BAL_OPT_REUSEADDR;
+    opts.reuseaddr       = 1;
+
+    bool retval = true;
+    size_t n    = 0;
+
+    for (; retval && n < count; n++) {
+        socks[n] = NULL;
+        retval = bal_create_ex(&socks[n], 0, addr_fam, SOCK_STREAM, IPPROTO_TCP, &opts);
+        if (!retval)
+            break;
+
+        int reuse = 1;
+        _bal_eqland(retval, bal_set_option(socks[n], SOL_SOCKET, SO_REUSEPORT, &reuse,
+            sizeof(int)));
+        _bal_eqland(retval, NULL != addr ? bal_bind(socks[n], addr, srv)
+            : bal_bindall(socks[n], srv));
+
+        /* the kernel assigns group indexes in bind order, so listener n is the
+         * one selected when the steering program returns n. */
+        if (retval)
+            retval = bal_set_reactor(socks[n], n % _bal_as_container.count);
+
+        if (!retval) {
+            (void)bal_close(&socks[n], true);
+            break;
+        }
+    }
+
+# if defined(__HAVE_REUSEPORT_CBPF__)
+    if (retval && bal_isbitset(flags, BAL_SHARD_STEER_CPU)) {
+        struct sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)},
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)count},
+            {BPF_RET | BPF_A, 0, 0, 0}
+        };
+        struct sock_fprog prog = {(unsigned short)_bal_countof(code), code};
+        retval = bal_set_option(socks[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+            sizeof(prog));
+    }
+# endif
+
+    /* only start listening once the group is complete and steering is in place,
+     * so that no connection lands on a listener that is about to go away. */
+    for (size_t l = 0; retval && l < count; l++)
+        retval = bal_listen(socks[l], backlog);
+
+    if (!retval) {
+        for (size_t l = 0; l < n && l < count; l++) {
+            if (NULL != socks[l])
+                (void)bal_close(&socks[l], true);
+        }
+    }
+
+    _bal_dbglog("sharded listener on %s:%s (%zu socket(s)) %s", NULL != addr ? addr
+        : "*", srv, count, retval ? "succeeded" : "failed");
+
+    return retval;
+#endif
+}
+
 bool bal_accept(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr)
 {
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okptrptr(res) && _bal_okptr(resaddr)) {
-        *res = calloc(1, sizeof(bal_socket));
-        if (!_bal_okptrnf(*res)) {
-            _bal_handlelasterr();
-        } else {
-            socklen_t sasize = sizeof(bal_sockaddr);
-            bal_descriptor sd = accept(s->sd, (struct sockaddr*)resaddr, &sasize);
-            if (sd > 0) {
-                (*res)->sd       = sd;
+        socklen_t sasize = sizeof(bal_sockaddr);
+        bal_descriptor sd = accept(s->sd, (struct sockaddr*)resaddr, &sasize);
+        if (sd > 0) {
+            *res = _bal_socket_alloc(sd, s);
+            if (!_bal_okptrnf(*res)) {
+                _bal_close_descriptor(sd);
+            } else {
                 (*res)->addr_fam = s->addr_fam;
                 (*res)->type     = s->type;
                 (*res)->proto    = s->proto;
+                _bal_inherit_reactor(*res, s);
                 retval           = true;
-            } else {
-                _bal_handlelasterr();
-                _bal_safefree(res);
             }
+        } else {
+            _bal_handlelasterr();
+            *res = NULL;
         }
     }
 
     return retval;
 }
 
+bool bal_accept_ex(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddr,
+    const bal_socket_opts* opts)
+{
+    bool retval = false;
+
+    if (_bal_okptrptr(res) && _bal_okptr(resaddr)) {
+        ssize_t count = bal_accept_many(s, res, resaddr, 1);
+        if (0 == count) {
+#if defined(__WIN__)
+            (void)_bal_handleerr(WSAEWOULDBLOCK);
+#else
+            (void)_bal_handleerr(EWOULDBLOCK);
+#endif
+        } else if (1 == count) {
+            retval = true;
+            if (NULL != opts && !_bal_apply_opts(*res, opts)) {
+                (void)bal_close(res, true);
+                retval = false;
+            }
+        }
+    }
+
+    return retval;
+}
+
+ssize_t bal_accept_many(const bal_socket* s, bal_socket** res, bal_sockaddr* resaddrs,
+    size_t max)
+{
+    return bal_accept_many_async(s, res, resaddrs, max, NULL, 0U);
+}
+
+ssize_t bal_accept_many_async(const bal_socket* s, bal_socket** res,
+    bal_sockaddr* resaddrs, size_t max, bal_async_cb proc, uint32_t mask)
+{
+    if (!_bal_oksock(s) || !_bal_okptr(res) || !_bal_oklen(max))
+        return -1;
+
+    if (!_bal_okptrnf(proc) && 0U != mask) {
+        _bal_seterror(_BAL_E_INVALIDARG);
+        return -1;
+    }
+
+    /* on a blocking listener, a second accept would wait for a connection that
+     * may never come; take one at a time there. */
+    if (!bal_isbitset(s->state.bits, BAL_S_NONBLOCK))
+        max = 1;
+
+    ssize_t count = 0;
+
+    while ((size_t)count < max) {
+        bal_sockaddr tmp    = {0};
+        bal_sockaddr* sa    = NULL != resaddrs ? &resaddrs[count] : &tmp;
+        socklen_t sasize    = sizeof(bal_sockaddr);
+#if defined(__HAVE_ACCEPT4__)
+        bal_descriptor sd = accept4(s->sd, (struct sockaddr*)sa, &sasize,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        bal_descriptor sd = accept(s->sd, (struct sockaddr*)sa, &sasize);
+#endif
+        if (-1 == sd) {
+#if defined(__WIN__)
+            int error = WSAGetLastError();
+            if (WSAEWOULDBLOCK == error)
+                break;
+            if (WSAECONNRESET == error || WSAEINTR == error)
+                continue;
+#else
+            int error = errno;
+            if (EAGAIN == error || EWOULDBLOCK == error)
+                break;
+            /* the connection went away before it could be accepted, or a signal
+             * interrupted the call; neither concerns the rest of the backlog. */
+            if (ECONNABORTED == error || EINTR == error || EPROTO == error)
+                continue;
+#endif
+            (void)_bal_handleerr(error);
+            if (0 == count)
+                count = -1;
+            break;
+        }
+
+        bal_socket* as = _bal_socket_alloc(sd, s);
+        if (!_bal_okptrnf(as)) {
+            _bal_close_descriptor(sd);
+            if (0 == count)
+                count = -1;
+            break;
+        }
+
+        as->addr_fam = s->addr_fam;
+        as->type     = s->type;
+        as->proto    = s->proto;
+        _bal_inherit_reactor(as, s);
+
+#if defined(__HAVE_ACCEPT4__)
+        bal_setbitshigh(&as->state.bits, BAL_S_NONBLOCK);
+#else
+        (void)bal_set_io_mode(as, true);
+#endif
+
+        if (0U != mask && !bal_async_poll(as, proc, mask)) {
+            (void)bal_close(&as, true);
+            if (0 == count)
+                count = -1;
+            break;
+        }
+
+        res[count++] = as;
+    }
+
+    _bal_dbglog("accepted %zd connection(s) on socket "BAL_SOCKET_SPEC, count, s->sd);
+
+    return count;
+}
+
 bool bal_get_option(const bal_socket* s, int level, int name, void* optval, socklen_t len)
 {
     bool retval = false;
@@ -574,6 +1297,7 @@ bool bal_set_option(const bal_socket* s, int level, int name, const void* optval
     bool retval = false;
 
     if (_bal_oksock(s) && _bal_okptr(optval) && _bal_oklen(len)) {
+        _bal_invalidate_opt(s, level, name);
         int set = setsockopt(s->sd, level, name, optval, len);
         if (-1 == set)
             _bal_handlelasterr();
@@ -585,22 +1309,22 @@ bool bal_set_option(const bal_socket* s, int level, int name, const void* optval
 
 bool bal_get_broadcast(const bal_socket* s, int* value)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_BROADCAST, value, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_BROADCAST, value);
 }
 
 bool bal_set_broadcast(const bal_socket* s, int value)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_BROADCAST, &value, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_BROADCAST, &value);
 }
 
 bool bal_get_debug(const bal_socket* s, int* value)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_DEBUG, value, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_DEBUG, value);
 }
 
 bool bal_set_debug(const bal_socket* s, int value)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_DEBUG, &value, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_DEBUG, &value);
 }
 
 bool bal_get_linger(const bal_socket* s, bal_linger* sec)
@@ -609,7 +1333,7 @@ bool bal_get_linger(const bal_socket* s, bal_linger* sec)
 
     if (_bal_okptr(sec)) {
         struct linger l = {0};
-        if (bal_get_option(s, SOL_SOCKET, SO_LINGER, &l, sizeof(struct linger))) {
+        if (_bal_get_cached_opt(s, BAL_OPT_LINGER, &l)) {
             *sec   = l.l_linger;
             retval = true;
         }
@@ -621,57 +1345,57 @@ bool bal_get_linger(const bal_socket* s, bal_linger* sec)
 bool bal_set_linger(const bal_socket* s, bal_linger sec)
 {
     struct linger l = { (0 != sec) ? 1 : 0, sec };
-    return bal_set_option(s, SOL_SOCKET, SO_LINGER, &l, sizeof(struct linger));
+    return _bal_set_cached_opt(s, BAL_OPT_LINGER, &l);
 }
 
 bool bal_get_keepalive(const bal_socket* s, int* value)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_KEEPALIVE, value, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_KEEPALIVE, value);
 }
 
 bool bal_set_keepalive(const bal_socket* s, int value)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_KEEPALIVE, &value);
 }
 
 bool bal_get_oobinline(const bal_socket* s, int* value)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_OOBINLINE, value, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_OOBINLINE, value);
 }
 
 bool bal_set_oobinline(const bal_socket* s, int value)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_OOBINLINE, &value, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_OOBINLINE, &value);
 }
 
 bool bal_get_reuseaddr(const bal_socket* s, int* value)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_REUSEADDR, value, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_REUSEADDR, value);
 }
 
 bool bal_set_reuseaddr(const bal_socket* s, int value)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_REUSEADDR, &value);
 }
 
 bool bal_get_sendbuf_size(const bal_socket* s, int* size)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_SNDBUF, size, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_SNDBUF, size);
 }
 
 bool bal_set_sendbuf_size(const bal_socket* s, int size)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_SNDBUF, &size, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_SNDBUF, &size);
 }
 
 bool bal_get_recvbuf_size(const bal_socket* s, int* size)
 {
-    return bal_get_option(s, SOL_SOCKET, SO_RCVBUF, size, sizeof(int));
+    return _bal_get_cached_opt(s, BAL_OPT_RCVBUF, size);
 }
 
 bool bal_set_recvbuf_size(const bal_socket* s, int size)
 {
-    return bal_set_option(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(int));
+    return _bal_set_cached_opt(s, BAL_OPT_RCVBUF, &size);
 }
 
 bool bal_get_send_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
@@ -680,7 +1404,7 @@ bool bal_get_send_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
 
     if (_bal_okptr(sec) && _bal_okptr(usec)) {
         struct timeval tv = {0};
-        bool get = bal_get_option(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(struct timeval));
+        bool get = _bal_get_cached_opt(s, BAL_OPT_SNDTIMEO, &tv);
         if (get) {
             *sec  = tv.tv_sec;
             *usec = tv.tv_usec;
@@ -694,7 +1418,7 @@ bool bal_get_send_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
 bool bal_set_send_timeout(const bal_socket* s, bal_tvsec sec, bal_tvusec usec)
 {
     const struct timeval tv = {sec, usec};
-    return bal_set_option(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(struct timeval));
+    return _bal_set_cached_opt(s, BAL_OPT_SNDTIMEO, &tv);
 }
 
 bool bal_get_recv_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
@@ -703,7 +1427,7 @@ bool bal_get_recv_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
 
     if (_bal_okptr(sec) && _bal_okptr(usec)) {
         struct timeval tv = {0};
-        bool get = bal_get_option(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval));
+        bool get = _bal_get_cached_opt(s, BAL_OPT_RCVTIMEO, &tv);
         if (get) {
             *sec  = tv.tv_sec;
             *usec = tv.tv_usec;
@@ -717,7 +1441,7 @@ bool bal_get_recv_timeout(const bal_socket* s, bal_tvsec* sec, bal_tvusec* usec)
 bool bal_set_recv_timeout(const bal_socket* s, bal_tvsec sec, bal_tvusec usec)
 {
     const struct timeval tv = {sec, usec};
-    return bal_set_option(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval));
+    return _bal_set_cached_opt(s, BAL_OPT_RCVTIMEO, &tv);
 }
 
 bool bal_set_io_mode(const bal_socket* s, bool async)
@@ -732,11 +1456,20 @@ bool bal_set_io_mode(const bal_socket* s, bool async)
             _bal_handlelasterr();
         retval = 0 == ret;
 #else
-        int ret = fcntl(s->sd, F_SETFL, async ? O_NONBLOCK : 0U);
+        int ret = fcntl(s->sd, F_GETFL);
+        if (-1 != ret)
+            ret = fcntl(s->sd, F_SETFL, async ? (ret | O_NONBLOCK) : (ret & ~O_NONBLOCK));
         if (-1 == ret)
             _bal_handlelasterr();
-        retval = 0 == ret;
+        retval = -1 != ret;
 #endif
+        if (retval) {
+            bal_socket* ms = (bal_socket*)s;
+            if (async)
+                bal_setbitshigh(&ms->state.bits, BAL_S_NONBLOCK);
+            else
+                bal_setbitslow(&ms->state.bits, BAL_S_NONBLOCK);
+        }
     }
 
     return retval;
@@ -747,15 +1480,20 @@ size_t bal_get_recvqueue_size(const bal_socket* s)
     size_t size = 0;
 
     if (_bal_oksock(s)) {
+        /* FIONREAD yields a u_long on Windows, and an int elsewhere. */
 #if defined(__WIN__)
-        if (0 != ioctlsocket(s->sd, FIONREAD, (void*)&size)) {
-            size = 0;
+        u_long avail = 0;
+        if (0 != ioctlsocket(s->sd, FIONREAD, &avail)) {
             _bal_handlelasterr();
+        } else {
+            size = (size_t)avail;
         }
 #else
-        if (0 != ioctl(s->sd, FIONREAD, &size)) {
-            size = 0;
+        int avail = 0;
+        if (0 != ioctl(s->sd, FIONREAD, &avail)) {
             _bal_handlelasterr();
+        } else if (avail > 0) {
+            size = (size_t)avail;
         }
 #endif
     }
@@ -788,54 +1526,78 @@ int bal_get_error_ext(bal_error* err)
     return _bal_get_error(err, true);
 }
 
-bool bal_is_readable(const bal_socket* s)
+int bal_get_error_codes(bal_error_codes* codes)
 {
-    bool r = false;
-
-    if (_bal_oksock(s)) {
-        fd_set fd         = {0};
-        struct timeval tv = {0};
-#if defined(__WIN__)
-        int high_sd = (int)s->sd + 1;
-#else
-        int high_sd = s->sd + 1;
-#endif
+    return _bal_get_error_codes(codes);
+}
 
-        FD_ZERO(&fd);
-        FD_SET(s->sd, &fd);
+int bal_format_error(const bal_error_codes* codes, bal_error* err)
+{
+    return _bal_format_error(codes, err);
+}
 
-        if (0 == select(high_sd, &fd, NULL, NULL, &tv) &&
-            FD_ISSET(s->sd, &fd)) {
-            r = true;
-        }
-    }
+bool bal_is_readable(const bal_socket* s)
+{
+    short revents = 0;
 
-    return r;
+    /* hang-ups and errors count, since a read would complete without blocking. */
+    return _bal_poll_one(s, POLLRDNORM, &revents) &&
+        0 != (revents & (POLLRDNORM | POLLHUP | POLLERR));
 }
 
 bool bal_is_writable(const bal_socket* s)
 {
-    bool r = false;
+    short revents = 0;
+    return _bal_poll_one(s, POLLWRNORM, &revents) &&
+        0 != (revents & (POLLWRNORM | POLLERR));
+}
+
+ssize_t bal_check_readiness(bal_socket** socks, uint32_t* out, size_t n, int timeout_ms)
+{
+    if (!_bal_okptr(socks) || !_bal_okptr(out) || !_bal_oklen(n))
+        return -1;
 
-    if (_bal_oksock(s)) {
-        fd_set fd         = {0};
-        struct timeval tv = {0};
 #if defined(__WIN__)
-        int high_sd = (int)s->sd + 1;
+    WSAPOLLFD stack_fds[64];
+    WSAPOLLFD* fds     = stack_fds;
 #else
-        int high_sd = s->sd + 1;
+    struct pollfd stack_fds[64];
+    struct pollfd* fds = stack_fds;
 #endif
 
-        FD_ZERO(&fd);
-        FD_SET(s->sd, &fd);
+    if (n > _bal_countof(stack_fds)) {
+        fds = _bal_calloc(n, sizeof(stack_fds[0]));
+        if (!_bal_okptrnf(fds))
+            return -1;
+    }
 
-        if (0 == select(high_sd, NULL, &fd, NULL, &tv) &&
-            FD_ISSET(s->sd, &fd)) {
-            r = true;
-        }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t interest = 0U != out[i] ? out[i] : BAL_EVT_READ | BAL_EVT_WRITE;
+        /* negative descriptors are ignored by poll. */
+        fds[i].fd      = NULL != socks[i] ? socks[i]->sd : (bal_descriptor)-1;
+        fds[i].events  = _bal_mask_to_pollflags(interest);
+        fds[i].revents = 0;
     }
 
-    return r;
+#if defined(__WIN__)
+    int res = WSAPoll(fds, (nfds_t)n, timeout_ms);
+#else
+    int res = poll(fds, (nfds_t)n, timeout_ms);
+#endif
+
+    ssize_t retval = -1;
+    if (-1 == res) {
+        _bal_handlelasterr();
+    } else {
+        retval = res;
+        for (size_t i = 0; i < n; i++)
+            out[i] = _bal_pollflags_to_events(fds[i].revents);
+    }
+
+    if (fds != stack_fds)
+        _bal_safefree(&fds);
+
+    return retval;
 }
 
 bool bal_is_listening(const bal_socket* s)
@@ -983,6 +1745,208 @@ bool bal_free_addrlist(bal_addrlist* addrs)
     return retval;
 }
 
+bool bal_get_stats(bal_stats* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    memset(out, 0, sizeof(bal_stats));
+    out->reactors = _bal_as_container.count;
+
+    for (size_t n = 0; n < _bal_as_container.count; n++) {
+        bal_reactor_stats rs = {0};
+        _bal_get_reactor_stats(&_bal_as_container.reactors[n], &rs);
+
+        bal_reactor_stats* t = &out->total;
+        t->iterations   += rs.iterations;
+        t->wakeups      += rs.wakeups;
+        t->ready        += rs.ready;
+        t->max_ready     = rs.max_ready > t->max_ready ? rs.max_ready : t->max_ready;
+        t->dispatch_ns  += rs.dispatch_ns;
+        t->sockets      += rs.sockets;
+        _bal_add_socket_stats(&t->io, &rs.io);
+    }
+
+    /* the reactors' peaks needn't coincide. */
+    out->total.peak_sockets = _bal_get_size(&_bal_as_container.peak_registered);
+
+    return true;
+}
+
+bool bal_get_reactor_stats(size_t reactor, bal_reactor_stats* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (reactor >= _bal_as_container.count)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    _bal_get_reactor_stats(&_bal_as_container.reactors[reactor], out);
+    return true;
+}
+
+bool bal_get_socket_stats(const bal_socket* s, bal_socket_stats* out)
+{
+    bool retval = false;
+
+    if (_bal_oksock(s) && _bal_okptr(out)) {
+        memcpy(out, &s->state.stats, sizeof(bal_socket_stats));
+        retval = true;
+    }
+
+    return retval;
+}
+
+bool bal_set_histograms(bool enable)
+{
+    bool set = _bal_once(&_bal_static_once_init, &_bal_static_once_init_func);
+    BAL_ASSERT(set);
+
+    if (!set)
+        return _bal_seterror(_BAL_E_INTERNAL);
+
+    _bal_set_boolean(&_bal_as_container.histograms, enable);
+    return true;
+}
+
+bool bal_get_histograms(bal_loop_histograms* out, bool reset)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    memset(out, 0, sizeof(bal_loop_histograms));
+
+    for (size_t n = 0; n < _bal_as_container.count; n++)
+        _bal_get_reactor_histograms(&_bal_as_container.reactors[n], out, reset);
+
+    return true;
+}
+
+bool bal_get_reactor_histograms(size_t reactor, bal_loop_histograms* out, bool reset)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    if (!_bal_get_boolean(&_bal_async_poll_init))
+        return _bal_seterror(_BAL_E_ASNOTINIT);
+
+    if (reactor >= _bal_as_container.count)
+        return _bal_seterror(_BAL_E_INVALIDARG);
+
+    memset(out, 0, sizeof(bal_loop_histograms));
+    _bal_get_reactor_histograms(&_bal_as_container.reactors[reactor], out, reset);
+
+    return true;
+}
+
+uint64_t bal_histogram_percentile(const bal_histogram* h, double percentile)
+{
+    if (!_bal_okptr(h) || 0ULL == h->count)
+        return 0ULL;
+
+    if (percentile <= 0.0)
+        return h->min;
+    if (percentile >= 100.0)
+        return h->max;
+
+    /* the rank of the value at `percentile`, rounded up (1-based). */
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)h->count);
+    if ((double)rank < (percentile / 100.0) * (double)h->count)
+        rank++;
+    if (0ULL == rank)
+        rank = 1ULL;
+
+    uint64_t seen = 0ULL;
+    for (size_t n = 0; n < BAL_HIST_BUCKETS; n++) {
+        seen += h->buckets[n];
+        if (seen >= rank) {
+            /* the bucket's upper bound, but never beyond what was recorded. */
+            uint64_t value = _bal_hist_bucket_max(n);
+            return value < h->max ? value : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+bool bal_get_slab_stats(bal_slab_stats* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    memset(out, 0, sizeof(bal_slab_stats));
+
+    for (size_t n = 0; n < BAL_MAX_REACTORS; n++) {
+        bal_slab_stats slab = {0};
+        if (!_bal_slab_get_stats(&_bal_as_container.slabs[n], &slab))
+            return false;
+
+        out->allocs   += slab.allocs;
+        out->frees    += slab.frees;
+        out->in_use   += slab.in_use;
+        out->chunks   += slab.chunks;
+        out->capacity += slab.capacity;
+    }
+
+    /* the slabs peak at different times. */
+    out->peak = _bal_get_size(&_bal_as_container.slab_peak);
+
+    return true;
+}
+
+bool bal_get_recv_pool_stats(bal_slab_stats* out)
+{
+    if (!_bal_okptr(out))
+        return false;
+
+    memset(out, 0, sizeof(bal_slab_stats));
+
+    for (size_t n = 0; n < BAL_RECV_BUF_CLASSES; n++) {
+        bal_slab_stats cls = {0};
+        if (!_bal_slab_get_stats(&_bal_as_container.recv_bufs[n], &cls))
+            return false;
+
+        out->allocs   += cls.allocs;
+        out->frees    += cls.frees;
+        out->in_use   += cls.in_use;
+        out->peak     += cls.peak;
+        out->chunks   += cls.chunks;
+        out->capacity += cls.capacity;
+    }
+
+    return true;
+}
+
+bool bal_set_recv_idle_reclaim(uint32_t msec)
+{
+    bool set = _bal_once(&_bal_static_once_init, &_bal_static_once_init_func);
+    BAL_ASSERT(set);
+
+    if (!set)
+        return _bal_seterror(_BAL_E_INTERNAL);
+
+#if defined(__HAVE_STDATOMICS__)
+    atomic_store(&_bal_as_container.recv_idle_ms, msec);
+#else
+    _bal_as_container.recv_idle_ms = msec;
+#endif
+    return true;
+}
+
+uint32_t bal_get_recv_idle_reclaim(void)
+{
+    return (uint32_t)_bal_get_recv_idle_ms();
+}
+
 void bal_thread_yield(void)
 {
 #if defined(__WIN__)
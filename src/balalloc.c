@@ -0,0 +1,230 @@
+/*
+ * balalloc.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal/alloc.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+#include "bal/state.h"
+
+/**
+ * Internal functions
+ */
+
+void* _bal_calloc(size_t num, size_t size)
+{
+    if (NULL != _bal_allocator.calloc_fn)
+        return _bal_allocator.calloc_fn(num, size, _bal_allocator.ctx);
+    return calloc(num, size);
+}
+
+void _bal_free(void* ptr)
+{
+    if (NULL != _bal_allocator.free_fn)
+        _bal_allocator.free_fn(ptr, _bal_allocator.ctx);
+    else
+        free(ptr);
+}
+
+bool _bal_set_allocator(const bal_allocator* alloc)
+{
+    if (NULL != alloc && (!_bal_okptr(alloc->calloc_fn) || !_bal_okptr(alloc->free_fn)))
+        return false;
+
+    /* anything still held in the slab came from the current allocator, and
+     * must be returned to it before switching. */
+    bool released = true;
+    for (size_t n = 0; n < BAL_MAX_REACTORS; n++)
+        _bal_eqland(released, _bal_slab_release(&_bal_as_container.slabs[n]));
+    for (size_t n = 0; n < BAL_RECV_BUF_CLASSES; n++)
+        _bal_eqland(released, _bal_slab_release(&_bal_as_container.recv_bufs[n]));
+    if (!released)
+        return _bal_seterror(_BAL_E_INUSE);
+
+    if (NULL != alloc) {
+        _bal_allocator = *alloc;
+    } else {
+        _bal_allocator.calloc_fn = NULL;
+        _bal_allocator.free_fn   = NULL;
+        _bal_allocator.ctx       = NULL;
+    }
+
+    return true;
+}
+
+void* _bal_slab_alloc(bal_slab* slab)
+{
+    void* obj = NULL;
+
+    if (_bal_okptr(slab)) {
+        _BAL_MUTEX_COUNTER_INIT(slaballoc);
+        _BAL_LOCK_MUTEX(&slab->mutex, slaballoc);
+
+        if (NULL != slab->free || _bal_slab_grow(slab)) {
+            bal_slab_free* head = slab->free;
+            slab->free = head->next;
+            slab->stats.allocs++;
+            slab->stats.in_use++;
+            if (slab->stats.in_use > slab->stats.peak)
+                slab->stats.peak = slab->stats.in_use;
+            obj = head;
+        }
+
+        _BAL_UNLOCK_MUTEX(&slab->mutex, slaballoc);
+        _BAL_MUTEX_COUNTER_CHECK(slaballoc);
+
+        if (NULL != obj)
+            memset(obj, 0, slab->obj_size);
+    }
+
+    return obj;
+}
+
+void _bal_slab_free(bal_slab* slab, void* obj)
+{
+    if (_bal_okptr(slab) && _bal_okptr(obj)) {
+        _BAL_MUTEX_COUNTER_INIT(slabfree);
+        _BAL_LOCK_MUTEX(&slab->mutex, slabfree);
+
+        BAL_ASSERT(slab->stats.in_use > 0);
+
+        bal_slab_free* head = (bal_slab_free*)obj;
+        head->next = slab->free;
+        slab->free = head;
+        slab->stats.frees++;
+        slab->stats.in_use--;
+
+        _BAL_UNLOCK_MUTEX(&slab->mutex, slabfree);
+        _BAL_MUTEX_COUNTER_CHECK(slabfree);
+    }
+}
+
+bool _bal_slab_grow(bal_slab* slab)
+{
+    BAL_ASSERT(NULL != slab && slab->obj_size >= sizeof(bal_slab_free));
+
+    const size_t hdr_size = _BAL_SLAB_ROUNDUP(sizeof(bal_slab_chunk));
+    bal_slab_chunk* chunk = _bal_calloc(1, hdr_size + (slab->obj_size * slab->chunk_objs));
+    if (!_bal_okptrnf(chunk))
+        return _bal_handlelasterr();
+
+    chunk->next  = slab->chunks;
+    slab->chunks = chunk;
+
+    /* push the objects in reverse, so that they are handed out in address order. */
+    uint8_t* base = (uint8_t*)chunk + hdr_size;
+    for (size_t n = slab->chunk_objs; n > 0; n--) {
+        bal_slab_free* obj = (bal_slab_free*)(base + ((n - 1) * slab->obj_size));
+        obj->next  = slab->free;
+        slab->free = obj;
+    }
+
+    slab->stats.chunks++;
+    slab->stats.capacity += slab->chunk_objs;
+
+    _bal_dbglog("slab %p: new chunk %p (%zu objects of %zu bytes)", (void*)slab,
+        (void*)chunk, slab->chunk_objs, slab->obj_size);
+
+    return true;
+}
+
+bool _bal_slab_release(bal_slab* slab)
+{
+    bool retval = false;
+
+    if (_bal_okptr(slab)) {
+        _BAL_MUTEX_COUNTER_INIT(slabrelease);
+        _BAL_LOCK_MUTEX(&slab->mutex, slabrelease);
+
+        if (0 == slab->stats.in_use) {
+            while (NULL != slab->chunks) {
+                bal_slab_chunk* next = slab->chunks->next;
+                _bal_safefree(&slab->chunks);
+                slab->chunks = next;
+            }
+
+            slab->free           = NULL;
+            slab->stats.chunks   = 0;
+            slab->stats.capacity = 0;
+            retval               = true;
+        } else {
+            _bal_dbglog("warning: slab %p has %zu object(s) in use; not releasing"
+                        " %zu chunk(s)", (void*)slab, slab->stats.in_use,
+                        slab->stats.chunks);
+        }
+
+        _BAL_UNLOCK_MUTEX(&slab->mutex, slabrelease);
+        _BAL_MUTEX_COUNTER_CHECK(slabrelease);
+    }
+
+    return retval;
+}
+
+bool _bal_slab_get_stats(bal_slab* slab, bal_slab_stats* out)
+{
+    bool retval = false;
+
+    if (_bal_okptr(slab) && _bal_okptr(out)) {
+        _BAL_MUTEX_COUNTER_INIT(slabstats);
+        _BAL_LOCK_MUTEX(&slab->mutex, slabstats);
+
+        *out   = slab->stats;
+        retval = true;
+
+        _BAL_UNLOCK_MUTEX(&slab->mutex, slabstats);
+        _BAL_MUTEX_COUNTER_CHECK(slabstats);
+    }
+
+    return retval;
+}
+
+bal_socket* _bal_socket_alloc(bal_descriptor sd, const bal_socket* parent)
+{
+    /* the reactor the socket will most likely be assigned to (see
+     * _bal_get_reactor and _bal_inherit_reactor). */
+    size_t idx = NULL != parent && bal_isbitset(parent->state.bits, BAL_S_REACTOR)
+        ? parent->state.reactor : (size_t)sd % _bal_as_container.count;
+    BAL_ASSERT(idx < BAL_MAX_REACTORS);
+
+    bal_socket* s = (bal_socket*)_bal_slab_alloc(&_bal_as_container.slabs[idx]);
+    if (NULL != s) {
+        s->sd         = sd;
+        s->state.slab = idx;
+        _bal_count_peak(&_bal_as_container.slab_in_use, &_bal_as_container.slab_peak,
+            true);
+    }
+
+    return s;
+}
+
+void _bal_socket_free(bal_socket** s)
+{
+    if (_bal_okptrptr(s) && _bal_okptr(*s)) {
+        /* a socket moved to another reactor still goes back to its own slab. */
+        _bal_slab_free(&_bal_as_container.slabs[(*s)->state.slab], *s);
+        _bal_count_peak(&_bal_as_container.slab_in_use, &_bal_as_container.slab_peak,
+            false);
+        *s = NULL;
+    }
+}
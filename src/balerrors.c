@@ -33,7 +33,7 @@
 
 /** Container for information about the last error that occurred on this thread. */
 static _bal_thread_local bal_thread_error_info _bal_tei = {
-    _BAL_E_NOERROR, {BAL_UNKNOWN, BAL_UNKNOWN, 0U}, {0, BAL_UNKNOWN}
+    _BAL_E_NOERROR, {BAL_UNKNOWN, BAL_UNKNOWN, 0U}, {0, false}
 };
 
 /** The string used to format error messages generated by libbal when
@@ -67,62 +67,90 @@ static const struct {
     {_BAL_E_INTERNAL,   "An internal error has occurred"},
     {_BAL_E_UNAVAIL,    "Feature is disabled or unavailable"},
     {_BAL_E_PLATFORM,   BAL_ERRFMTPFORM},
+    {_BAL_E_INUSE,      "Resource is in use"},
     {_BAL_E_UNKNOWN,    "An unknown error has occurred"}
 };
 
-int _bal_get_error(bal_error* err, bool extended)
+/** Formats the message for the error described by `tei` into `err`,
+ * including its location if `extended` is true. */
+static
+int _bal_format_tei(const bal_thread_error_info* tei, bool extended, bal_error* err)
 {
     int retval = -1;
 
-    if (_bal_okptrnf(err)) {
-        memset(err, 0, sizeof(bal_error));
-        err->code = _bal_err_code(_BAL_E_UNKNOWN);
-        for (size_t n = 0; n < _bal_countof(bal_errors); n++) {
-            if (bal_errors[n].code == _bal_tei.code) {
-                char* heap_msg = NULL;
-                if (_BAL_E_PLATFORM == bal_errors[n].code) {
-                    heap_msg = calloc(BAL_MAXERROR + 33, sizeof(char));
-                    if (NULL != heap_msg) {
-                        _bal_snprintf_trunc(heap_msg, BAL_MAXERROR + 33, bal_errors[n].msg,
-                            _bal_tei.os.code, _bal_okstrnf(_bal_tei.os.msg)
-                                ? _bal_tei.os.msg : BAL_UNKNOWN);
-                    }
-                }
-
-                if (extended) {
-                    _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMTEXT,
-                        _bal_tei.loc.func, _bal_tei.loc.file, _bal_tei.loc.line,
-                        _bal_okptrnf(heap_msg) ? heap_msg : bal_errors[n].msg);
-                } else {
-                    _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMT,
-                        _bal_okptrnf(heap_msg) ? heap_msg : bal_errors[n].msg);
-                }
-
-                _bal_safefree(&heap_msg);
-                retval = err->code = _bal_err_code(bal_errors[n].code);
-                break;
+    memset(err, 0, sizeof(bal_error));
+    err->code = _bal_err_code(_BAL_E_UNKNOWN);
+    for (size_t n = 0; n < _bal_countof(bal_errors); n++) {
+        if (bal_errors[n].code == tei->code) {
+            const char* msg = bal_errors[n].msg;
+            char pform_msg[BAL_MAXERROR + 33] = {0};
+            if (_BAL_E_PLATFORM == bal_errors[n].code) {
+                char os_msg[BAL_MAXERROR] = {0};
+                _bal_format_os_error(tei->os.code, tei->os.gai, os_msg, BAL_MAXERROR);
+                _bal_snprintf_trunc(pform_msg, sizeof(pform_msg), bal_errors[n].msg,
+                    tei->os.code, _bal_okstrnf(os_msg) ? os_msg : BAL_UNKNOWN);
+                msg = pform_msg;
+            }
+
+            if (extended) {
+                _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMTEXT,
+                    tei->loc.func, _bal_basename(tei->loc.file), tei->loc.line, msg);
+            } else {
+                _bal_snprintf_trunc(err->message, BAL_MAXERRORFMT, BAL_ERRFMT, msg);
             }
+
+            retval = err->code = _bal_err_code(bal_errors[n].code);
+            break;
         }
     }
 
     return retval;
 }
 
+int _bal_get_error(bal_error* err, bool extended)
+{
+    int retval = -1;
+
+    if (_bal_okptrnf(err))
+        retval = _bal_format_tei(&_bal_tei, extended, err);
+
+    return retval;
+}
+
+int _bal_get_error_codes(bal_error_codes* codes)
+{
+    int retval = -1;
+
+    if (_bal_okptrnf(codes)) {
+        codes->code    = _bal_err_code(_bal_tei.code);
+        codes->os_code = _BAL_E_PLATFORM == _bal_tei.code ? _bal_tei.os.code : 0;
+        codes->gai     = _BAL_E_PLATFORM == _bal_tei.code && _bal_tei.os.gai;
+        retval = codes->code;
+    }
+
+    return retval;
+}
+
+int _bal_format_error(const bal_error_codes* codes, bal_error* err)
+{
+    int retval = -1;
+
+    if (_bal_okptrnf(codes) && _bal_okptrnf(err)) {
+        bal_thread_error_info tei = {
+            _bal_mk_error(codes->code), {BAL_UNKNOWN, BAL_UNKNOWN, 0U},
+            {codes->os_code, codes->gai}
+        };
+        retval = _bal_format_tei(&tei, false, err);
+    }
+
+    return retval;
+}
+
 bool __bal_set_error(int code, const char* func, const char* file, uint32_t line)
 {
     if (_bal_is_error(code)) {
-        _bal_tei.code = code;
+        _bal_tei.code     = code;
         _bal_tei.loc.func = func;
-#if defined(__WIN__)
-        const char* last_slash = StrRChrA(file, NULL, '\\');
-        if (NULL == last_slash)
-              last_slash = StrRChrA(file, NULL, '/');
-#else
-        const char* last_slash = strrchr(file, '/');
-#endif
-        if (NULL != last_slash)
-            file = last_slash + 1;
-
         _bal_tei.loc.file = file;
         _bal_tei.loc.line = line;
     }
@@ -130,64 +158,74 @@ bool __bal_set_error(int code, const char* func, const char* file, uint32_t line
 #if defined(BAL_DBGLOG) && defined(BAL_DBGLOG_SETERROR)
     if (0 != code) {
         bal_error err = {0};
-        __bal_dbglog(func, file, line, "%d (%s)",
+        __bal_dbglog(func, _bal_basename(file), line, "%d (%s)",
             _bal_get_error(&err, false), err.message);
     }
 #endif
     return false;
 }
 
-void __bal_set_os_error(int code, const char* message, const char* func,
-    const char* file, uint32_t line)
+bool __bal_handle_error(int code, const char* func, const char* file,
+    uint32_t line, bool gai)
 {
     _bal_tei.os.code = code;
-    _bal_tei.os.msg[0] = '\0';
+    _bal_tei.os.gai  = gai;
 
-    if (_bal_okstrnf(message))
-        _bal_strcpy(_bal_tei.os.msg, BAL_MAXERROR, message,
-            strnlen(message, BAL_MAXERROR));
+    return __bal_set_error(_BAL_E_PLATFORM, func, file, line);
+}
+
+const char* _bal_basename(const char* file)
+{
+    if (!_bal_okstrnf(file))
+        return BAL_UNKNOWN;
 
-    (void)__bal_set_error(_BAL_E_PLATFORM, func, file, line);
+#if defined(__WIN__)
+    const char* last_slash = StrRChrA(file, NULL, '\\');
+    if (NULL == last_slash)
+        last_slash = StrRChrA(file, NULL, '/');
+#else
+    const char* last_slash = strrchr(file, '/');
+#endif
+
+    return NULL != last_slash ? last_slash + 1 : file;
 }
 
-bool __bal_handle_error(int code, const char* func, const char* file,
-    uint32_t line, bool gai)
+void _bal_format_os_error(int code, bool gai, char* buf, size_t len)
 {
-    char msg[BAL_MAXERROR] = {0};
+    buf[0] = '\0';
 #if defined(__WIN__)
     BAL_UNUSED(gai);
 
     DWORD flags = FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS |
                     FORMAT_MESSAGE_MAX_WIDTH_MASK;
-    DWORD fmt = FormatMessageA(flags, NULL, (DWORD)code, 0UL, msg,
-        BAL_MAXERROR, NULL);
+    DWORD fmt = FormatMessageA(flags, NULL, (DWORD)code, 0UL, buf, (DWORD)len, NULL);
 
     assert(0UL != fmt);
     if (fmt > 0UL) {
-        if (msg[fmt - 1] == '\n' || msg[fmt - 1] == ' ')
-            msg[fmt - 1] = '\0';
+        if (buf[fmt - 1] == '\n' || buf[fmt - 1] == ' ')
+            buf[fmt - 1] = '\0';
     }
 #else
     if (gai) {
         const char* tmp = gai_strerror(code);
-        _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+        _bal_strcpy(buf, len, tmp, strnlen(tmp, len));
     } else {
         int finderr = -1;
 # if defined(__HAVE_XSI_STRERROR_R__)
-        finderr = strerror_r(code, msg, BAL_MAXERROR);
+        finderr = strerror_r(code, buf, len);
 #  if defined(__HAVE_XSI_STRERROR_R_ERRNO__)
         if (finderr == -1)
             finderr = errno;
 #  endif
 # elif defined(__HAVE_GNU_STRERROR_R__)
-        const char* tmp = strerror_r(code, msg, BAL_MAXERROR);
-        if (tmp != msg)
-            _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+        const char* tmp = strerror_r(code, buf, len);
+        if (tmp != buf)
+            _bal_strcpy(buf, len, tmp, strnlen(tmp, len));
 # elif defined(__HAVE_STRERROR_S__)
-        finderr = (int)strerror_s(msg, BAL_MAXERROR, code);
+        finderr = (int)strerror_s(buf, len, code);
 # else
         const char* tmp = strerror(code);
-        _bal_strcpy(msg, BAL_MAXERROR, tmp, strnlen(tmp, BAL_MAXERROR));
+        _bal_strcpy(buf, len, tmp, strnlen(tmp, len));
 # endif
 # if defined(__HAVE_XSI_STRERROR_R__) || defined(__HAVE_STRERROR_S__)
         BAL_ASSERT_UNUSED(finderr, 0 == finderr);
@@ -196,9 +234,6 @@ bool __bal_handle_error(int code, const char* func, const char* file,
 # endif
     }
 #endif
-
-    __bal_set_os_error(code, msg, func, file, line);
-    return false;
 }
 
 #if defined(BAL_DBGLOG)
@@ -215,7 +250,7 @@ void __bal_dbglog(const char* func, const char* file, uint32_t line,
     va_end(args);
     BAL_ASSERT(prnt_len > 0);
 
-    char* buf = calloc(prnt_len + 1, sizeof(char));
+    char* buf = _bal_calloc(prnt_len + 1, sizeof(char));
     BAL_ASSERT(NULL != buf);
 
     if (buf) {
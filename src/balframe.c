@@ -0,0 +1,391 @@
+/*
+ * balframe.c
+ *
+ * Author:    Ryan M. Lederman <lederman@gmail.com>
+ * Copyright: Copyright (c) 2004-2024
+ * Version:   0.3.0
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bal/alloc.h"
+#include "bal/internal.h"
+#include "bal/helpers.h"
+
+#if defined(__HAVE_SSE42_CRC32C__) || defined(__HAVE_X86_SIMD_SCAN__)
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+/** The CRC32C (Castagnoli) polynomial, bit-reversed. */
+#define BAL_CRC32C_POLY 0x82f63b78U
+
+/* lookup table for the portable implementation. */
+static uint32_t _bal_crc32c_table[256];
+
+/* whether the CPU has the SSE4.2 crc32 instruction. */
+static bool _bal_crc32c_hw;
+
+/* searches for a delimiter in a run of bytes. */
+typedef size_t (*_bal_find_delim_fn)(const uint8_t* p, size_t len, uint8_t delim);
+
+static size_t _bal_find_delim_scalar(const uint8_t* p, size_t len, uint8_t delim);
+
+/* the fastest delimiter search the CPU supports. */
+static _bal_find_delim_fn _bal_find_delim_best = &_bal_find_delim_scalar;
+
+/**
+ * Internal functions
+ */
+
+#if defined(__HAVE_SSE42_CRC32C__)
+# if !defined(_MSC_VER)
+__attribute__((target("sse4.2")))
+# endif
+static uint32_t _bal_crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len)
+{
+    uint64_t crc64 = crc;
+
+    while (len >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p   += sizeof(word);
+        len -= sizeof(word);
+    }
+
+    crc = (uint32_t)crc64;
+    while (len-- > 0)
+        crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+}
+#endif
+
+static uint32_t _bal_crc32c_sw(uint32_t crc, const uint8_t* p, size_t len)
+{
+    while (len-- > 0)
+        crc = _bal_crc32c_table[(crc ^ *p++) & 0xffU] ^ (crc >> 8);
+    return crc;
+}
+
+static size_t _bal_find_delim_scalar(const uint8_t* p, size_t len, uint8_t delim)
+{
+    for (size_t n = 0; n < len; n++) {
+        if (delim == p[n])
+            return n;
+    }
+    return len;
+}
+
+#if defined(__HAVE_X86_SIMD_SCAN__)
+static inline size_t _bal_ctz32(uint32_t bits)
+{
+# if defined(_MSC_VER)
+    unsigned long idx = 0UL;
+    (void)_BitScanForward(&idx, bits);
+    return (size_t)idx;
+# else
+    return (size_t)__builtin_ctz(bits);
+# endif
+}
+
+/* SSE2 is part of x86-64, so this needs no detection. */
+static size_t _bal_find_delim_sse2(const uint8_t* p, size_t len, uint8_t delim)
+{
+    const __m128i needle = _mm_set1_epi8((char)delim);
+    size_t n = 0;
+
+    for (; n + sizeof(__m128i) <= len; n += sizeof(__m128i)) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(p + n));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (0U != bits)
+            return n + _bal_ctz32(bits);
+    }
+
+    return n + _bal_find_delim_scalar(p + n, len - n, delim);
+}
+
+# if !defined(_MSC_VER)
+__attribute__((target("avx2")))
+# endif
+static size_t _bal_find_delim_avx2(const uint8_t* p, size_t len, uint8_t delim)
+{
+    const __m256i needle = _mm256_set1_epi8((char)delim);
+    size_t n = 0;
+
+    for (; n + sizeof(__m256i) <= len; n += sizeof(__m256i)) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(p + n));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (0U != bits)
+            return n + _bal_ctz32(bits);
+    }
+
+    return n + _bal_find_delim_sse2(p + n, len - n, delim);
+}
+
+static bool _bal_cpu_has_avx2(void)
+{
+# if defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    /* the OS has to save the YMM registers, too. */
+    if (0 == (info[2] & (1 << 27)) || 0x6U != (_xgetbv(0) & 0x6U))
+        return false;
+    __cpuidex(info, 7, 0);
+    return 0 != (info[1] & (1 << 5));
+# else
+    return 0 != __builtin_cpu_supports("avx2");
+# endif
+}
+#endif
+
+void _bal_frame_init(void)
+{
+    for (uint32_t n = 0; n < 256U; n++) {
+        uint32_t crc = n;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0U != (crc & 1U) ? BAL_CRC32C_POLY : 0U);
+        _bal_crc32c_table[n] = crc;
+    }
+
+#if defined(__HAVE_SSE42_CRC32C__)
+# if defined(_MSC_VER)
+    int info[4] = {0};
+    __cpuid(info, 1);
+    _bal_crc32c_hw = 0 != (info[2] & (1 << 20));
+# else
+    _bal_crc32c_hw = 0 != __builtin_cpu_supports("sse4.2");
+# endif
+#endif
+
+#if defined(__HAVE_X86_SIMD_SCAN__)
+    _bal_find_delim_best = _bal_cpu_has_avx2() ? &_bal_find_delim_avx2
+                                               : &_bal_find_delim_sse2;
+#endif
+}
+
+uint32_t _bal_crc32c(uint32_t crc, const void* data, size_t len, bool hw)
+{
+    crc = ~crc;
+#if defined(__HAVE_SSE42_CRC32C__)
+    if (hw && _bal_crc32c_hw)
+        return ~_bal_crc32c_sse42(crc, data, len);
+#else
+    BAL_UNUSED(hw);
+#endif
+    return ~_bal_crc32c_sw(crc, data, len);
+}
+
+size_t _bal_find_delim(const void* data, size_t len, uint8_t delim, bool simd)
+{
+    return simd ? _bal_find_delim_best(data, len, delim)
+                : _bal_find_delim_scalar(data, len, delim);
+}
+
+uint64_t _bal_frame_get_uint(const uint8_t* p, size_t width, bool big_endian)
+{
+    uint64_t val = 0ULL;
+    for (size_t n = 0; n < width; n++) {
+        size_t shift = 8U * (big_endian ? width - 1U - n : n);
+        val |= (uint64_t)p[n] << shift;
+    }
+    return val;
+}
+
+void _bal_frame_put_uint(uint8_t* p, size_t width, bool big_endian, uint64_t val)
+{
+    for (size_t n = 0; n < width; n++) {
+        size_t shift = 8U * (big_endian ? width - 1U - n : n);
+        p[n] = (uint8_t)(val >> shift);
+    }
+}
+
+/* checks a complete frame's CRC (if any) and hands it to the callback. */
+static bool _bal_frame_deliver(bal_socket* s, const uint8_t* payload, size_t len)
+{
+    const bal_framer* f = &s->state.framer;
+
+    if (bal_isbitset(f->opts.flags, BAL_FRAME_CRC32C)) {
+        bool big_endian = bal_isbitset(f->opts.flags, BAL_FRAME_BIG_ENDIAN);
+        uint64_t crc    = _bal_frame_get_uint(payload + len, sizeof(uint32_t), big_endian);
+        if (crc != _bal_crc32c(0U, payload, len, true)) {
+            _bal_dbglog("CRC mismatch in %zu byte frame on socket "BAL_SOCKET_SPEC,
+                len, s->sd);
+            return false;
+        }
+    }
+
+    f->on_frame(s, payload, len);
+    return true;
+}
+
+/* asks the kernel not to report the socket readable until `need` more bytes
+ * (capped at the biggest receive buffer) have arrived. */
+static void _bal_frame_set_lowat(bal_socket* s, size_t need)
+{
+#if defined(__HAVE_SO_RCVLOWAT__)
+    bal_framer* f = &s->state.framer;
+
+    if (need > BAL_RECV_BUF_MAX)
+        need = BAL_RECV_BUF_MAX;
+    if (need < 1U)
+        need = 1U;
+
+    if (need != f->lowat && (0U != f->lowat || 1U != need)) {
+        int lowat = (int)need;
+        if (0 == setsockopt(s->sd, SOL_SOCKET, SO_RCVLOWAT, &lowat, sizeof(lowat)))
+            f->lowat = need;
+    }
+#else
+    BAL_UNUSED(s);
+    BAL_UNUSED(need);
+#endif
+}
+
+size_t _bal_frame_on_data(bal_socket* s, const void* data, size_t len)
+{
+    bal_framer* f    = &s->state.framer;
+    const uint8_t* p = data;
+    size_t used      = 0U;
+    size_t need      = 0U;
+    size_t prefix    = f->opts.prefix_size;
+    size_t crc_size  = bal_isbitset(f->opts.flags, BAL_FRAME_CRC32C) ? sizeof(uint32_t) : 0U;
+    bool big_endian  = bal_isbitset(f->opts.flags, BAL_FRAME_BIG_ENDIAN);
+
+    while (used < len) {
+        if (NULL != f->big) {
+            size_t take = f->big_len - f->big_have;
+            if (take > len - used)
+                take = len - used;
+
+            memcpy(f->big + f->big_have, p + used, take);
+            f->big_have += take;
+            used        += take;
+
+            if (f->big_have < f->big_len) {
+                need = f->big_len - f->big_have;
+                break;
+            }
+
+            uint8_t* big = f->big;
+            f->big       = NULL;
+            bool ok      = _bal_frame_deliver(s, big, f->big_len - crc_size);
+            _bal_free(big);
+            if (!ok)
+                return BAL_DATA_ERROR;
+        } else {
+            if (len - used < prefix) {
+                need = prefix - (len - used);
+                break;
+            }
+
+            uint64_t plen = _bal_frame_get_uint(p + used, prefix, big_endian);
+            if (plen > f->opts.max_frame) {
+                _bal_dbglog("%llu byte frame on socket "BAL_SOCKET_SPEC" exceeds the"
+                            " %zu byte limit", (unsigned long long)plen, s->sd,
+                            f->opts.max_frame);
+                return BAL_DATA_ERROR;
+            }
+
+            size_t total = prefix + (size_t)plen + crc_size;
+            if (len - used >= total) {
+                /* the frame is whole in the receive buffer: no copy. */
+                if (!_bal_frame_deliver(s, p + used + prefix, (size_t)plen))
+                    return BAL_DATA_ERROR;
+                used += total;
+            } else if (total > BAL_RECV_BUF_MAX) {
+                /* it would never fit in a receive buffer; assemble it apart. */
+                f->big = _bal_calloc(1, (size_t)plen + crc_size);
+                if (!_bal_okptrnf(f->big))
+                    return BAL_DATA_ERROR;
+                f->big_len  = (size_t)plen + crc_size;
+                f->big_have = 0U;
+                used       += prefix;
+            } else {
+                /* wait in the receive buffer, which grows to hold it. */
+                need = total - (len - used);
+                break;
+            }
+        }
+
+        /* the callback may have turned framing off, or closed (or destroyed)
+         * the socket. */
+        if (_bal_frame_on_data != s->state.on_data || _bal_is_gone(s))
+            return used;
+    }
+
+    _bal_frame_set_lowat(s, need);
+
+    return used;
+}
+
+size_t _bal_line_on_data(bal_socket* s, const void* data, size_t len)
+{
+    bal_framer* f    = &s->state.framer;
+    const uint8_t* p = data;
+    size_t used      = 0U;
+    size_t from      = f->scanned < len ? f->scanned : len;
+
+    while (from < len) {
+        size_t at = from + _bal_find_delim(p + from, len - from, f->delim, true);
+        if (at == len)
+            break;
+
+        size_t end = at;
+        if (bal_isbitset(f->line_flags, BAL_LINE_CRLF) && end > used && '\r' == p[end - 1])
+            end--;
+
+        f->on_frame(s, p + used, end - used);
+        used = from = at + 1U;
+
+        /* the callback may have turned lines off, or closed (or destroyed)
+         * the socket. */
+        if (_bal_line_on_data != s->state.on_data || _bal_is_gone(s))
+            return used;
+    }
+
+    /* whatever is left has been searched, and needn't be again. */
+    f->scanned = len - used;
+    if (f->scanned >= BAL_RECV_BUF_MAX) {
+        _bal_dbglog("line on socket "BAL_SOCKET_SPEC" exceeds %zu bytes", s->sd,
+            (size_t)BAL_RECV_BUF_MAX);
+        return BAL_DATA_ERROR;
+    }
+
+    return used;
+}
+
+void _bal_frame_reset(bal_socket* s)
+{
+    bal_framer* f = &s->state.framer;
+
+    if (NULL != f->big)
+        _bal_free(f->big);
+    f->big      = NULL;
+    f->big_len  = 0U;
+    f->big_have = 0U;
+    f->on_frame = NULL;
+    f->scanned  = 0U;
+
+    if (!bal_isbitset(s->state.bits, BAL_S_CLOSE))
+        _bal_frame_set_lowat(s, 1U);
+    f->lowat = 0U;
+}
@@ -26,8 +26,34 @@
 #include "bal/internal.h"
 #include "bal/helpers.h"
 #include "bal/state.h"
+#include "bal/alloc.h"
 #include "bal.h"
 
+/** Map of BAL_OPT_* bits <-> SOL_SOCKET options and their location in
+ * bal_socket_opts. Buffer sizes are not cached when set, since the kernel
+ * may adjust the requested value (Linux doubles it). */
+static const struct {
+    const uint32_t opt;
+    const int name;
+    const size_t offset;
+    const socklen_t len;
+    const bool cache_on_set;
+} bal_socket_options[] = {
+    {BAL_OPT_BROADCAST, SO_BROADCAST, offsetof(bal_socket_opts, broadcast),    sizeof(int), true},
+    {BAL_OPT_DEBUG,     SO_DEBUG,     offsetof(bal_socket_opts, debug),        sizeof(int), true},
+    {BAL_OPT_LINGER,    SO_LINGER,    offsetof(bal_socket_opts, linger),
+        sizeof(struct linger), true},
+    {BAL_OPT_KEEPALIVE, SO_KEEPALIVE, offsetof(bal_socket_opts, keepalive),    sizeof(int), true},
+    {BAL_OPT_OOBINLINE, SO_OOBINLINE, offsetof(bal_socket_opts, oobinline),    sizeof(int), true},
+    {BAL_OPT_REUSEADDR, SO_REUSEADDR, offsetof(bal_socket_opts, reuseaddr),    sizeof(int), true},
+    {BAL_OPT_SNDBUF,    SO_SNDBUF,    offsetof(bal_socket_opts, sendbuf_size), sizeof(int), false},
+    {BAL_OPT_RCVBUF,    SO_RCVBUF,    offsetof(bal_socket_opts, recvbuf_size), sizeof(int), false},
+    {BAL_OPT_SNDTIMEO,  SO_SNDTIMEO,  offsetof(bal_socket_opts, send_timeout),
+        sizeof(struct timeval), true},
+    {BAL_OPT_RCVTIMEO,  SO_RCVTIMEO,  offsetof(bal_socket_opts, recv_timeout),
+        sizeof(struct timeval), true}
+};
+
 /**
  * Internal functions
  */
@@ -52,31 +78,75 @@ bool _bal_init_asyncpoll(void)
     if (_bal_get_boolean(&_bal_async_poll_init))
         return _bal_seterror(_BAL_E_ASDUPEINIT);
 
-    bool init = _bal_list_create(&_bal_as_container.lst);
-    if (!init) {
-        _bal_dbglog("error: failed to create list");
-        return _bal_handlelasterr();
-    }
+    BAL_ASSERT(_bal_as_container.count > 0 && _bal_as_container.count <= BAL_MAX_REACTORS);
+
+    _bal_as_container.reactors = _bal_calloc(_bal_as_container.count, sizeof(bal_reactor));
+    if (!_bal_okptrnf(_bal_as_container.reactors))
+        return false;
+
+    _bal_set_boolean(&_bal_as_container.die, false);
+
+    /* the reactors start out empty. */
+#if defined(__HAVE_STDATOMICS__)
+    atomic_store(&_bal_as_container.registered, 0U);
+    atomic_store(&_bal_as_container.peak_registered, 0U);
+#else
+    _bal_as_container.registered      = 0U;
+    _bal_as_container.peak_registered = 0U;
+#endif
+
+    bool init      = true;
+    size_t started = 0;
+
+    for (; init && started < _bal_as_container.count; started++) {
+        bal_reactor* r = &_bal_as_container.reactors[started];
+        r->index       = started;
+
+        init = _bal_mutex_create(&r->mutex);
+        if (!init) {
+            _bal_dbglog("error: failed to create mutex for reactor %zu", started);
+            break;
+        }
+
+        init = _bal_list_create(&r->lst);
+        if (!init) {
+            _bal_dbglog("error: failed to create list for reactor %zu", started);
+            (void)_bal_mutex_destroy(&r->mutex);
+            break;
+        }
 
 #if defined(__WIN__)
-    _bal_as_container.thread = _beginthreadex(NULL, 0U, &_bal_eventthread, NULL,
-        0U, NULL);
-    BAL_ASSERT(0ULL != _bal_as_container.thread);
+        r->thread = _beginthreadex(NULL, 0U, &_bal_eventthread, r, 0U, NULL);
+        BAL_ASSERT(0ULL != r->thread);
 
-    if (0ULL == _bal_as_container.thread)
-        _bal_eqland(init, _bal_handlelasterr());
+        if (0ULL == r->thread)
+            _bal_eqland(init, _bal_handlelasterr());
 #else
-    int op = pthread_create(&_bal_as_container.thread, NULL, &_bal_eventthread, NULL);
-    BAL_ASSERT(0 == op);
-    _bal_eqland(init, 0 == op);
+        int op = pthread_create(&r->thread, NULL, &_bal_eventthread, r);
+        BAL_ASSERT(0 == op);
+        _bal_eqland(init, 0 == op);
 
-    if (0 != op)
-        (void)_bal_handleerr(op);
+        if (0 != op)
+            (void)_bal_handleerr(op);
 #endif
+        if (!init) {
+            (void)_bal_list_destroy(&r->lst);
+            (void)_bal_mutex_destroy(&r->mutex);
+            break;
+        }
+    }
+
+    if (!init) {
+        /* unwind the reactors that did start. */
+        _bal_set_boolean(&_bal_as_container.die, true);
+        for (size_t n = 0; n < started; n++)
+            (void)_bal_stop_reactor(&_bal_as_container.reactors[n]);
+        _bal_safefree(&_bal_as_container.reactors);
+    }
 
     _bal_set_boolean(&_bal_async_poll_init, init);
-    _bal_set_boolean(&_bal_as_container.die, !init);
-    _bal_dbglog("async I/O initialization %s", init ? "succeeded" : "failed");
+    _bal_dbglog("async I/O initialization %s (%zu reactor(s))", init ? "succeeded"
+        : "failed", _bal_as_container.count);
 
     return init;
 }
@@ -89,13 +159,34 @@ bool _bal_cleanup_asyncpoll(void)
     _bal_set_boolean(&_bal_as_container.die, true);
     _bal_set_boolean(&_bal_async_poll_init, false);
 
-    _bal_dbglog("joining async I/O thread...");
+    bool cleanup = true;
+    for (size_t n = 0; n < _bal_as_container.count; n++)
+        _bal_eqland(cleanup, _bal_stop_reactor(&_bal_as_container.reactors[n]));
+
+    _bal_safefree(&_bal_as_container.reactors);
+
+    /* sockets may legitimately outlive the async I/O machinery, in which case
+     * their memory is retained until the next clean up. */
+    for (size_t n = 0; n < BAL_MAX_REACTORS; n++)
+        (void)_bal_slab_release(&_bal_as_container.slabs[n]);
+    for (size_t n = 0; n < BAL_RECV_BUF_CLASSES; n++)
+        (void)_bal_slab_release(&_bal_as_container.recv_bufs[n]);
+
+    _bal_dbglog("async I/O clean up %s", cleanup ? "succeeded" : "failed");
+
+    return cleanup;
+}
+
+bool _bal_stop_reactor(bal_reactor* r)
+{
+    BAL_ASSERT(_bal_get_boolean(&_bal_as_container.die));
+    _bal_dbglog("joining async I/O thread for reactor %zu...", r->index);
 
 #if defined(__WIN__)
-    DWORD wait = WaitForSingleObject((HANDLE)_bal_as_container.thread, INFINITE);
+    DWORD wait = WaitForSingleObject((HANDLE)r->thread, INFINITE);
     BAL_ASSERT_UNUSED(wait, WAIT_OBJECT_0 == wait);
 #else
-    int wait = pthread_join(_bal_as_container.thread, NULL);
+    int wait = pthread_join(r->thread, NULL);
     BAL_ASSERT_UNUSED(wait, 0 == wait);
     if (0 != wait)
         (void)_bal_handleerr(wait);
@@ -105,21 +196,152 @@ bool _bal_cleanup_asyncpoll(void)
     bal_descriptor key = 0;
     bal_socket* val    = NULL;
 
-    _bal_list_reset_iterator(_bal_as_container.lst);
-    while (_bal_list_iterate(_bal_as_container.lst, &key, &val)) {
+    _bal_list_reset_iterator(r->lst);
+    while (_bal_list_iterate(r->lst, &key, &val)) {
         _bal_dbglog("warning: dangling bal_socket "BAL_SOCKET_SPEC" (%p)",
             key, val);
     }
 
-    bool destroy = _bal_list_destroy(&_bal_as_container.lst);
+    bool destroy = _bal_list_destroy(&r->lst);
     BAL_ASSERT(destroy);
     _bal_eqland(cleanup, destroy);
 
-    _bal_dbglog("async I/O clean up %s", cleanup ? "succeeded" : "failed");
+    destroy = _bal_mutex_destroy(&r->mutex);
+    BAL_ASSERT(destroy);
+    _bal_eqland(cleanup, destroy);
 
     return cleanup;
 }
 
+bal_reactor* _bal_get_reactor(bal_socket* s)
+{
+    BAL_ASSERT(NULL != _bal_as_container.reactors);
+
+    /* the reactor count may have changed since the socket was pinned. */
+    if (!bal_isbitset(s->state.bits, BAL_S_REACTOR) ||
+        s->state.reactor >= _bal_as_container.count) {
+        s->state.reactor = (size_t)s->sd % _bal_as_container.count;
+        bal_setbitshigh(&s->state.bits, BAL_S_REACTOR);
+    }
+
+    BAL_ASSERT(s->state.reactor < _bal_as_container.count);
+    return &_bal_as_container.reactors[s->state.reactor];
+}
+
+void _bal_inherit_reactor(bal_socket* s, const bal_socket* parent)
+{
+    if (bal_isbitset(parent->state.bits, BAL_S_REACTOR)) {
+        s->state.reactor = parent->state.reactor;
+        bal_setbitshigh(&s->state.bits, BAL_S_REACTOR);
+    }
+}
+
+void _bal_get_reactor_stats(bal_reactor* r, bal_reactor_stats* out)
+{
+    _BAL_MUTEX_COUNTER_INIT(getstats);
+    _BAL_LOCK_MUTEX(&r->mutex, getstats);
+
+    memcpy(out, &r->stats, sizeof(bal_reactor_stats));
+    out->sockets = 0;
+
+    bal_descriptor key = 0;
+    bal_socket* val    = NULL;
+
+    _bal_list_reset_iterator(r->lst);
+    while (_bal_list_iterate(r->lst, &key, &val)) {
+        _bal_add_socket_stats(&out->io, &val->state.stats);
+        out->sockets++;
+    }
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, getstats);
+    _BAL_MUTEX_COUNTER_CHECK(getstats);
+}
+
+void _bal_add_socket_stats(bal_socket_stats* dst, const bal_socket_stats* src)
+{
+    dst->bytes_sent  += src->bytes_sent;
+    dst->bytes_recvd += src->bytes_recvd;
+    dst->syscalls    += src->syscalls;
+    dst->eagains     += src->eagains;
+
+    for (size_t n = 0; n < BAL_EVT_COUNT; n++)
+        dst->events[n] += src->events[n];
+}
+
+uint64_t _bal_hist_bucket_max(size_t index)
+{
+    BAL_ASSERT(index < BAL_HIST_BUCKETS);
+
+    if (index < (1U << BAL_HIST_SUB_BITS))
+        return (uint64_t)index;
+    if (index == BAL_HIST_BUCKETS - 1)
+        return UINT64_MAX;
+
+    unsigned msb    = (unsigned)(index >> BAL_HIST_SUB_BITS) + BAL_HIST_SUB_BITS - 1U;
+    uint64_t sub    = (uint64_t)(index & ((1U << BAL_HIST_SUB_BITS) - 1U));
+    uint64_t width  = 1ULL << (msb - BAL_HIST_SUB_BITS);
+
+    return (1ULL << msb) + (sub + 1ULL) * width - 1ULL;
+}
+
+void _bal_get_reactor_histograms(bal_reactor* r, bal_loop_histograms* out,
+    bool reset)
+{
+    _BAL_MUTEX_COUNTER_INIT(gethist);
+    _BAL_LOCK_MUTEX(&r->mutex, gethist);
+
+    _bal_merge_histogram(&out->poll_wait, &r->hist.poll_wait);
+    _bal_merge_histogram(&out->dispatch_delay, &r->hist.dispatch_delay);
+    _bal_merge_histogram(&out->loop_lag, &r->hist.loop_lag);
+
+    for (size_t n = 0; n < BAL_EVT_COUNT; n++)
+        _bal_merge_histogram(&out->callback[n], &r->hist.callback[n]);
+
+    if (reset)
+        memset(&r->hist, 0, sizeof(bal_loop_histograms));
+
+    _BAL_UNLOCK_MUTEX(&r->mutex, gethist);
+    _BAL_MUTEX_COUNTER_CHECK(gethist);
+}
+
+void _bal_merge_histogram(bal_histogram* dst, const bal_histogram* src)
+{
+    if (0ULL == src->count)
+        return;
+
+    if (0ULL == dst->count || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+
+    dst->count += src->count;
+    dst->sum   += src->sum;
+
+    for (size_t n = 0; n < BAL_HIST_BUCKETS; n++)
+        dst->buckets[n] += src->buckets[n];
+}
+
+uint64_t _bal_now_ns(void)
+{
+#if defined(__WIN__)
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER now         = {0};
+
+    if (0 == freq.QuadPart)
+        (void)QueryPerformanceFrequency(&freq);
+    (void)QueryPerformanceCounter(&now);
+
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000ULL +
+        (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000ULL / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts = {0};
+    int get = clock_gettime(CLOCK_MONOTONIC, &ts);
+    BAL_ASSERT_UNUSED(get, 0 == get);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 bool _bal_get_addrinfo(int flags, int addr_fam, int type, const char* host,
     const char* port, struct addrinfo** res)
 {
@@ -208,6 +430,30 @@ uint32_t _bal_on_pending_conn_io(bal_socket* s, uint32_t* events)
 
         bal_setbitslow(&s->state.mask, BAL_EVT_WRITE);
         bal_setbitslow(&s->state.bits, BAL_S_CONNECT);
+        _bal_sendq_keep_write(s);
+    }
+
+    return retval;
+}
+
+bool _bal_poll_one(const bal_socket* s, short events, short* revents)
+{
+    bool retval = false;
+
+    if (_bal_oksock(s) && _bal_okptr(revents)) {
+#if defined(__WIN__)
+        WSAPOLLFD fd = {s->sd, events, 0};
+        int res      = WSAPoll(&fd, 1, 0);
+#else
+        struct pollfd fd = {s->sd, events, 0};
+        int res          = poll(&fd, 1, 0);
+#endif
+        if (-1 == res) {
+            _bal_handlelasterr();
+        } else {
+            *revents = fd.revents;
+            retval   = true;
+        }
     }
 
     return retval;
@@ -280,10 +526,100 @@ short _bal_mask_to_pollflags(uint32_t mask)
     return retval;
 }
 
+bool _bal_get_cached_opt(const bal_socket* s, uint32_t opt, void* optval)
+{
+    bool retval = false;
+
+    if (_bal_oksock(s) && _bal_okptr(optval)) {
+        for (size_t n = 0; n < _bal_countof(bal_socket_options); n++) {
+            if (opt != bal_socket_options[n].opt)
+                continue;
+
+            bal_socket* ms = (bal_socket*)s;
+            uint8_t* cached = (uint8_t*)&ms->state.opts + bal_socket_options[n].offset;
+            if (!bal_isbitset(s->state.opts.mask, opt)) {
+                if (!bal_get_option(s, SOL_SOCKET, bal_socket_options[n].name, cached,
+                    bal_socket_options[n].len))
+                    return false;
+                bal_setbitshigh(&ms->state.opts.mask, opt);
+            }
+
+            memcpy(optval, cached, bal_socket_options[n].len);
+            return true;
+        }
+
+        _bal_seterror(_BAL_E_INVALIDARG);
+    }
+
+    return retval;
+}
+
+bool _bal_set_cached_opt(const bal_socket* s, uint32_t opt, const void* optval)
+{
+    bool retval = false;
+
+    if (_bal_oksock(s) && _bal_okptr(optval)) {
+        for (size_t n = 0; n < _bal_countof(bal_socket_options); n++) {
+            if (opt != bal_socket_options[n].opt)
+                continue;
+
+            if (!bal_set_option(s, SOL_SOCKET, bal_socket_options[n].name, optval,
+                bal_socket_options[n].len))
+                return false;
+
+            if (bal_socket_options[n].cache_on_set) {
+                bal_socket* ms = (bal_socket*)s;
+                uint8_t* cached = (uint8_t*)&ms->state.opts + bal_socket_options[n].offset;
+                memcpy(cached, optval, bal_socket_options[n].len);
+                bal_setbitshigh(&ms->state.opts.mask, opt);
+            }
+
+            return true;
+        }
+
+        _bal_seterror(_BAL_E_INVALIDARG);
+    }
+
+    return retval;
+}
+
+void _bal_invalidate_opt(const bal_socket* s, int level, int name)
+{
+    if (SOL_SOCKET != level)
+        return;
+
+    for (size_t n = 0; n < _bal_countof(bal_socket_options); n++) {
+        if (name == bal_socket_options[n].name) {
+            bal_socket* ms = (bal_socket*)s;
+            bal_setbitslow(&ms->state.opts.mask, bal_socket_options[n].opt);
+            break;
+        }
+    }
+}
+
+bool _bal_apply_opts(bal_socket* s, const bal_socket_opts* opts)
+{
+    bool retval = _bal_oksock(s) && _bal_okptr(opts);
+
+    for (size_t n = 0; retval && n < _bal_countof(bal_socket_options); n++) {
+        if (bal_isbitset(opts->mask, bal_socket_options[n].opt)) {
+            const uint8_t* val = (const uint8_t*)opts + bal_socket_options[n].offset;
+            retval = _bal_set_cached_opt(s, bal_socket_options[n].opt, val);
+        }
+    }
+
+    return retval;
+}
+
 bal_threadret _bal_eventthread(void* ctx)
 {
-    BAL_UNUSED(ctx);
-    static const int poll_timeout = 500;
+    bal_reactor* r = (bal_reactor*)ctx;
+    BAL_ASSERT(NULL != r);
+    static const int poll_timeout    = 500;
+    static const uint32_t idle_sleep = 100U;
+
+    /* when the current iteration should have begun (histograms only). */
+    uint64_t planned = 0ULL;
 
     while (!_bal_get_boolean(&_bal_as_container.die)) {
         size_t count       = 0;
@@ -292,62 +628,135 @@ bal_threadret _bal_eventthread(void* ctx)
 #else
         struct pollfd* fds = NULL;
 #endif
+        bal_poll_reg* regs = NULL;
         _BAL_MUTEX_COUNTER_INIT(eventthread);
-        _BAL_LOCK_MUTEX(&_bal_as_container.mutex, eventthread);
+        _BAL_LOCK_MUTEX(&r->mutex, eventthread);
+
+        bool hist = _bal_get_boolean(&_bal_as_container.histograms);
+        if (hist) {
+            uint64_t now = _bal_now_ns();
+            if (0ULL != planned)
+                _bal_hist_record(&r->hist.loop_lag, now > planned ? now - planned : 0ULL);
+            planned = now;
+        } else {
+            planned = 0ULL;
+        }
+
+        r->stats.iterations++;
+        count = _bal_list_count(r->lst);
+        if (count > r->stats.peak_sockets)
+            r->stats.peak_sockets = count;
 
-        count = _bal_list_count(_bal_as_container.lst);
         if (count > 0) {
-            fds = calloc(count, sizeof(struct pollfd));
-            BAL_ASSERT(NULL != fds);
+            /* the registrations of the polled sockets, followed by their
+             * pollfds, in one allocation. */
+            regs = _bal_calloc(count, sizeof(bal_poll_reg) + sizeof(struct pollfd));
+            BAL_ASSERT(NULL != regs);
 
-            if (_bal_okptrnf(fds)) {
+            if (_bal_okptrnf(regs)) {
+                fds = (void*)(regs + count);
                 size_t offset      = 0;
+                int timeout        = poll_timeout;
                 bal_descriptor key = 0;
                 bal_socket* val    = NULL;
 
-                _bal_list_reset_iterator(_bal_as_container.lst);
-                while (_bal_list_iterate(_bal_as_container.lst, &key, &val)) {
-                    fds[offset].fd     = key;
-                    fds[offset].events = _bal_mask_to_pollflags(val->state.mask);
+                /* receive buffers that have sat empty for the idle period go
+                 * back to the pool. */
+                uint64_t idle_ns = (uint64_t)_bal_get_recv_idle_ms() * 1000000ULL;
+                uint64_t now     = 0ULL != idle_ns ? _bal_now_ns() : 0ULL;
+
+                _bal_list_reset_iterator(r->lst);
+                while (_bal_list_iterate(r->lst, &key, &val)) {
+                    if (0ULL != idle_ns && NULL != val->state.recvb.data &&
+                        now - val->state.recvb.last_ns >= idle_ns)
+                        _bal_recvbuf_release(val, false);
+
+                    /* stream sockets that are registered before connecting or
+                     * listening report a hang-up; leave them out (poll
+                     * ignores negative descriptors) until they do. */
+                    fds[offset].fd     = bal_isbitset(val->state.bits, BAL_S_IDLE)
+                        ? (bal_descriptor)-1 : key;
+                    uint32_t mask = val->state.mask;
+                    if (_bal_get_boolean(&val->state.read_paused))
+                        bal_setbitslow(&mask, BAL_EVT_READ);
+                    fds[offset].events = _bal_mask_to_pollflags(mask);
+                    regs[offset].sd    = key;
+                    regs[offset].reg   = val->state.reg;
                     offset++;
+
+                    /* don't wait to deliver raised events. */
+                    if (0U != val->state.pending)
+                        timeout = 0;
                 }
 
                 /* relinquish the mutex during poll; this gives other threads
                  * a chance to obtain the lock and do some work. */
-                _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, eventthread);
+                _BAL_UNLOCK_MUTEX(&r->mutex, eventthread);
+                uint64_t wait_start = hist ? _bal_now_ns() : 0ULL;
 #if defined(__WIN__)
-                int res = WSAPoll(fds, (nfds_t)count, poll_timeout);
+                int res = WSAPoll(fds, (nfds_t)count, timeout);
 #else
-                int res = poll(fds, (nfds_t)count, poll_timeout);
+                int res = poll(fds, (nfds_t)count, timeout);
 #endif
+                uint64_t woke = hist ? _bal_now_ns() : 0ULL;
+
                 /* get the mutex back. */
-                _BAL_LOCK_MUTEX(&_bal_as_container.mutex, eventthread);
+                _BAL_LOCK_MUTEX(&r->mutex, eventthread);
+
+                if (hist) {
+                    _bal_hist_record(&r->hist.poll_wait, woke - wait_start);
+                    planned = 0 == res ? wait_start + (uint64_t)timeout * 1000000ULL
+                        : woke;
+                }
 
                 if (res > 0) {
+                    r->stats.wakeups++;
+                    r->stats.ready += (uint64_t)res;
+                    if ((uint64_t)res > r->stats.max_ready)
+                        r->stats.max_ready = (uint64_t)res;
+                } else if (-1 == res) {
+                    _bal_handlelasterr();
+                }
+
+                /* sockets with raised events are dispatched even if poll
+                 * had nothing for them. */
+                if (res > 0 || 0 == timeout) {
+                    uint64_t dispatch_start = _bal_now_ns();
                     for (size_t n = 0; n < count; n++) {
                         bal_socket* s = NULL;
-                        bool found    = _bal_list_find(_bal_as_container.lst,
-                            fds[n].fd, &s);
-
-                        if (found && _bal_oksock(s)) {
-                            uint32_t events = _bal_pollflags_to_events(fds[n].revents);
-                            if (0U != events)
-                                _bal_dispatch_events(fds[n].fd, s, events);
+                        bool found    = _bal_list_find(r->lst, regs[n].sd, &s);
+
+                        /* if the polled socket was destroyed while the mutex
+                         * was released, its descriptor may already belong to
+                         * a newly registered socket; the results of the poll
+                         * do not apply to the latter. */
+                        if (found && _bal_oksock(s) && s->state.reg == regs[n].reg) {
+                            uint32_t events = res > 0
+                                ? _bal_pollflags_to_events(fds[n].revents) : 0U;
+                            if (0U != events || 0U != s->state.pending)
+                                _bal_dispatch_events(r, regs[n].sd, s, events, woke);
                         }
                     }
-                } else if (-1 == res) {
-                    _bal_handlelasterr();
+                    uint64_t dispatch_end = _bal_now_ns();
+                    r->stats.dispatch_ns += dispatch_end - dispatch_start;
+
+                    /* the next iteration is due as soon as dispatching ends. */
+                    if (hist)
+                        planned = dispatch_end;
                 }
 
-                _bal_safefree(&fds);
+                _bal_safefree(&regs);
             }
          }
 
-        _BAL_UNLOCK_MUTEX(&_bal_as_container.mutex, eventthread);
+        _BAL_UNLOCK_MUTEX(&r->mutex, eventthread);
         _BAL_MUTEX_COUNTER_CHECK(eventthread);
 
-        if (0 == count)
-            bal_sleep_msec(100);
+        if (0 == count) {
+            if (hist)
+                planned = _bal_now_ns() + (uint64_t)idle_sleep * 1000000ULL;
+            bal_sleep_msec(idle_sleep);
+        }
         bal_thread_yield();
     }
 
@@ -358,21 +767,57 @@ bal_threadret _bal_eventthread(void* ctx)
 #endif
 }
 
-void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
+void _bal_destroy(bal_socket** s)
+{
+    /* keep the socket's I/O in the reactor's totals. */
+    if (_bal_get_boolean(&_bal_async_poll_init))
+        _bal_add_socket_stats(&_bal_get_reactor(*s)->stats.io, &(*s)->state.stats);
+
+    /* whatever bal_send_async couldn't send, and bal_async_recv's handler
+     * didn't consume, is discarded. */
+    _bal_sendq_clear(*s);
+    _bal_recvbuf_release(*s, true);
+    _bal_frame_reset(*s);
+
+    if (!bal_isbitset((*s)->state.bits, BAL_S_CLOSE)) {
+        _bal_dbglog("warning: freeing possibly open socket "BAL_SOCKET_SPEC
+                    " (%p)", (*s)->sd, *s);
+    } else {
+        _bal_dbglog("freeing socket "BAL_SOCKET_SPEC" (%p)", (*s)->sd, *s);
+    }
+
+    _bal_socket_free(s);
+}
+
+bool _bal_is_gone(const bal_socket* s)
+{
+    return 0U != (s->state.bits & (BAL_S_CLOSE | BAL_S_DESTROY));
+}
+
+void _bal_dispatch_events(bal_reactor* r, bal_descriptor sd, bal_socket* s,
+    uint32_t events, uint64_t woke_ns)
 {
     BAL_ASSERT(NULL != s);
     if (!_bal_okptr(s)) {
         return;
     }
 
-    uint32_t _events = 0U;
+    /* a handler that destroys the socket leaves freeing it to the end of the
+     * dispatch (see bal_destroy), so `s` stays valid until then. */
+    r->dispatching   = s;
+
+    /* events raised since the last dispatch (see _bal_raise_events). */
+    uint32_t _events = s->state.pending & s->state.mask;
+    s->state.pending = 0U;
 
 #if defined(BAL_DBGLOG_ASYNC_IO)
     _bal_dbglog("events %08"PRIx32" for socket "BAL_SOCKET_SPEC " (mask = %08"
         PRIx32")", events, sd, s->state.mask);
 #endif
 
-    if (bal_isbitset(events, BAL_EVT_READ) && bal_bitsinmask(s, BAL_EVT_READ)) {
+    /* the poll may have started before reads were paused. */
+    if (bal_isbitset(events, BAL_EVT_READ) && bal_bitsinmask(s, BAL_EVT_READ) &&
+        !_bal_get_boolean(&s->state.read_paused)) {
         if (bal_is_listening(s)) {
             bal_setbitshigh(&_events, BAL_EVT_ACCEPT);
         } else if (_bal_is_pending_conn(s)) {
@@ -385,6 +830,8 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
              * Just do that here, and translate it to a close event instead. */
             bal_setbitshigh(&_events, BAL_EVT_CLOSE);
 #endif
+        } else if (NULL != s->state.on_data) {
+            _events |= _bal_on_data_io(s, &events);
         } else {
             bal_setbitshigh(&_events, BAL_EVT_READ);
         }
@@ -396,8 +843,17 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
     if (bal_isbitset(events, BAL_EVT_WRITE) && bal_bitsinmask(s, BAL_EVT_WRITE)) {
         if (_bal_is_pending_conn(s)) {
             _events |= _bal_on_pending_conn_io(s, &events);
+            /* data queued while connecting can go now. */
+            if (bal_isbitset(_events, BAL_EVT_CONNECT) && NULL != s->state.sendq.head)
+                _events |= _bal_on_sendq_io(s, &events);
         } else {
-            bal_setbitshigh(&_events, BAL_EVT_WRITE);
+            /* write interest that only exists to flush the send queue is not
+             * reported to the callback. */
+            bool sendq_only = bal_isbitset(s->state.bits, BAL_S_SENDQ);
+            if (NULL != s->state.sendq.head)
+                _events |= _bal_on_sendq_io(s, &events);
+            if (!sendq_only)
+                bal_setbitshigh(&_events, BAL_EVT_WRITE);
         }
     }
 
@@ -419,8 +875,28 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
     bool closed  = bal_isbitset(events, BAL_EVT_CLOSE);
     bool invalid = bal_isbitset(events, BAL_EVT_INVALID);
 
-    if (0U != _events && _bal_okptr(s->state.proc))
-        s->state.proc(s, _events);
+    for (size_t n = 0; n < BAL_EVT_COUNT; n++) {
+        if (bal_isbitset(_events, 1U << n))
+            s->state.stats.events[n]++;
+    }
+
+    if (0U != _events && !bal_isbitset(s->state.bits, BAL_S_DESTROY) &&
+        _bal_okptr(s->state.proc)) {
+        if (0ULL == woke_ns) {
+            s->state.proc(s, _events);
+        } else {
+            uint64_t start = _bal_now_ns();
+            s->state.proc(s, _events);
+            uint64_t elapsed = _bal_now_ns() - start;
+
+            /* a callback handling several events counts towards each of them. */
+            _bal_hist_record(&r->hist.dispatch_delay, start - woke_ns);
+            for (size_t n = 0; n < BAL_EVT_COUNT; n++) {
+                if (bal_isbitset(_events, 1U << n))
+                    _bal_hist_record(&r->hist.callback[n], elapsed);
+            }
+        }
+    }
 
     if (closed || invalid) {
         /* if the callback did the right thing, it has called bal_close and
@@ -428,9 +904,10 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
          * still resides in the list. presume that the callback is behaving
          * properly–don't free the socket, but remove it from the list. */
         bal_socket* d = NULL;
-        bool removed  = _bal_list_remove(_bal_as_container.lst, sd, &d);
+        bool removed  = _bal_list_remove(r->lst, sd, &d);
 
         if (removed) {
+            _bal_count_registration(false);
             _bal_dbglog("removed socket "BAL_SOCKET_SPEC" (%p) from list"
                         " (closed/invalid)", sd, s);
         } else {
@@ -438,6 +915,316 @@ void _bal_dispatch_events(bal_descriptor sd, bal_socket* s, uint32_t events)
                         " handler (closed/invalid)", sd);
         }
     }
+
+    r->dispatching = NULL;
+    if (bal_isbitset(s->state.bits, BAL_S_DESTROY))
+        _bal_destroy(&s);
+}
+
+bool _bal_sendq_push(bal_socket* s, const void* data, size_t len, size_t offset,
+    bal_free_cb free_cb)
+{
+    BAL_ASSERT(NULL != s && NULL != data && offset < len);
+
+    /* copied data lives right after the header, in the same allocation. */
+    size_t extra      = NULL == free_cb ? len - offset : 0;
+    bal_send_buf* buf = _bal_calloc(1, sizeof(bal_send_buf) + extra);
+    if (!_bal_okptrnf(buf))
+        return _bal_seterror(_BAL_E_INTERNAL);
+
+    if (NULL == free_cb) {
+        memcpy(buf + 1, (const uint8_t*)data + offset, extra);
+        buf->data = (const uint8_t*)(buf + 1);
+        buf->len  = extra;
+    } else {
+        buf->data    = data;
+        buf->len     = len;
+        buf->offset  = offset;
+        buf->free_cb = free_cb;
+    }
+
+    if (NULL == s->state.sendq.tail)
+        s->state.sendq.head = buf;
+    else
+        s->state.sendq.tail->next = buf;
+    s->state.sendq.tail   = buf;
+    s->state.sendq.bytes += len - offset;
+
+    if (!bal_isbitset(s->state.mask, BAL_EVT_WRITE)) {
+        bal_setbitshigh(&s->state.mask, BAL_EVT_WRITE);
+        bal_setbitshigh(&s->state.bits, BAL_S_SENDQ);
+    }
+
+    return true;
+}
+
+static void _bal_sendq_pop(bal_socket* s)
+{
+    bal_send_buf* buf   = s->state.sendq.head;
+    s->state.sendq.head = buf->next;
+    if (NULL == s->state.sendq.head)
+        s->state.sendq.tail = NULL;
+    s->state.sendq.bytes -= buf->len - buf->offset;
+
+    if (NULL != buf->free_cb)
+        buf->free_cb((void*)buf->data);
+    _bal_free(buf);
+}
+
+bool _bal_sendq_flush(bal_socket* s)
+{
+    bool retval = true;
+
+    while (NULL != s->state.sendq.head) {
+        bal_send_buf* buf = s->state.sendq.head;
+        size_t remaining  = buf->len - buf->offset;
+        ssize_t sent      = send(s->sd, (const char*)buf->data + buf->offset,
+            (bal_iolen)remaining, MSG_NOSIGNAL);
+        _bal_count_io(s, sent, true);
+
+        if (sent <= 0) {
+            if (-1 == sent && !_bal_would_block())
+                retval = _bal_handlelasterr();
+            break;
+        }
+
+        if ((size_t)sent < remaining) {
+            buf->offset          += (size_t)sent;
+            s->state.sendq.bytes -= (size_t)sent;
+            break;
+        }
+
+        _bal_sendq_pop(s);
+    }
+
+    if (NULL == s->state.sendq.head && bal_isbitset(s->state.bits, BAL_S_SENDQ)) {
+        bal_setbitslow(&s->state.mask, BAL_EVT_WRITE);
+        bal_setbitslow(&s->state.bits, BAL_S_SENDQ);
+    }
+
+    return retval;
+}
+
+uint32_t _bal_on_sendq_io(bal_socket* s, uint32_t* events)
+{
+    uint32_t retval = 0U;
+
+    if (!_bal_sendq_flush(s))
+        bal_setbitshigh(events, BAL_EVT_ERROR);
+
+    if (bal_isbitset(s->state.bits, BAL_S_WBLOCKED) &&
+        s->state.sendq.bytes <= s->state.sendq.low) {
+        bal_setbitslow(&s->state.bits, BAL_S_WBLOCKED);
+        if (bal_bitsinmask(s, BAL_EVT_WDRAINED))
+            retval = BAL_EVT_WDRAINED;
+    }
+
+    return retval;
+}
+
+bool _bal_sendq_check_high(bal_socket* s)
+{
+    if (0U == s->state.sendq.high || bal_isbitset(s->state.bits, BAL_S_WBLOCKED) ||
+        s->state.sendq.bytes <= s->state.sendq.high)
+        return false;
+
+    bal_setbitshigh(&s->state.bits, BAL_S_WBLOCKED);
+    return true;
+}
+
+void _bal_raise_events(bal_socket* s, uint32_t events)
+{
+    bal_setbitshigh(&s->state.pending, events);
+}
+
+uint32_t _bal_on_data_io(bal_socket* s, uint32_t* events)
+{
+    uint32_t retval  = 0U;
+    size_t got       = 0U;
+    bal_recv_buf* rb = &s->state.recvb;
+
+    /* a buffer kept while idle is swapped if reads now call for another size. */
+    if (NULL != rb->data && rb->start == rb->end && rb->cls != rb->want_cls)
+        _bal_recvbuf_release(s, false);
+
+    for (size_t n = 0; n < BAL_RECV_MAX_READS; n++) {
+        if (NULL == rb->data || _BAL_RECV_BUF_SIZE(rb->cls) == rb->end) {
+            if (!_bal_recvbuf_make_room(s)) {
+                bal_setbitshigh(events, BAL_EVT_ERROR);
+                break;
+            }
+        }
+
+        size_t room = _BAL_RECV_BUF_SIZE(rb->cls) - rb->end;
+        ssize_t read = recv(s->sd, (char*)rb->data + rb->end, (bal_iolen)room, 0);
+        _bal_count_io(s, read, false);
+
+        if (0 == read) {
+            if (bal_bitsinmask(s, BAL_EVT_CLOSE))
+                bal_setbitshigh(&retval, BAL_EVT_CLOSE);
+            break;
+        } else if (read < 0) {
+            if (!_bal_would_block())
+                bal_setbitshigh(events, BAL_EVT_ERROR);
+            break;
+        }
+
+        got     += (size_t)read;
+        rb->end += (size_t)read;
+        size_t used = s->state.on_data(s, rb->data + rb->start, rb->end - rb->start);
+        if (BAL_DATA_ERROR == used) {
+            /* the stream can't be trusted past this point; stop reading it. */
+            _bal_set_boolean(&s->state.read_paused, true);
+            bal_setbitshigh(events, BAL_EVT_ERROR);
+            break;
+        }
+        BAL_ASSERT(used <= rb->end - rb->start);
+        rb->start += used < rb->end - rb->start ? used : rb->end - rb->start;
+        if (rb->start == rb->end)
+            rb->start = rb->end = 0U;
+
+        /* the handler may have stopped managed receives, or closed (or
+         * destroyed) the socket. */
+        if (NULL == s->state.on_data || _bal_is_gone(s))
+            break;
+
+        /* a short read means the socket has been drained. */
+        if ((size_t)read < room)
+            break;
+
+        /* the buffer filled up; size the next read for what is still waiting. */
+        size_t waiting = bal_get_recvqueue_size(s);
+        if (0U == waiting)
+            break;
+
+        size_t cls = _bal_recv_class(rb->end - rb->start + waiting);
+        if (cls > rb->want_cls)
+            rb->want_cls = cls;
+        if (rb->start == rb->end && rb->cls < rb->want_cls)
+            _bal_recvbuf_release(s, false);
+    }
+
+    _bal_recvbuf_adapt(s, got);
+
+    uint_fast32_t idle_ms = _bal_get_recv_idle_ms();
+    if (0U == idle_ms)
+        _bal_recvbuf_release(s, false);
+    else if (0U != got)
+        rb->last_ns = _bal_now_ns();
+
+    return retval;
+}
+
+size_t _bal_recv_class(size_t bytes)
+{
+    size_t cls = 0U;
+    while (cls < BAL_RECV_BUF_CLASSES - 1U && _BAL_RECV_BUF_SIZE(cls) < bytes)
+        cls++;
+    return cls;
+}
+
+bool _bal_recvbuf_make_room(bal_socket* s)
+{
+    bal_recv_buf* rb = &s->state.recvb;
+
+    if (NULL == rb->data) {
+        rb->data = _bal_slab_alloc(&_bal_as_container.recv_bufs[rb->want_cls]);
+        if (NULL == rb->data)
+            return false;
+        rb->cls     = rb->want_cls;
+        rb->start   = rb->end = 0U;
+        rb->last_ns = 0U;
+        return true;
+    }
+
+    /* the unconsumed tail stays put until there is no room after it. */
+    if (0U != rb->start) {
+        memmove(rb->data, rb->data + rb->start, rb->end - rb->start);
+        rb->end  -= rb->start;
+        rb->start = 0U;
+        return true;
+    }
+
+    /* the handler is waiting for more than the buffer holds: move the tail to
+     * a bigger one. a handler that won't consume any of the biggest can't make
+     * progress. */
+    if (BAL_RECV_BUF_CLASSES - 1U == rb->cls)
+        return false;
+
+    size_t cls    = rb->cls + 1U;
+    uint8_t* data = _bal_slab_alloc(&_bal_as_container.recv_bufs[cls]);
+    if (NULL == data)
+        return false;
+
+    memcpy(data, rb->data, rb->end);
+    _bal_slab_free(&_bal_as_container.recv_bufs[rb->cls], rb->data);
+    rb->data = data;
+    rb->cls  = cls;
+    if (rb->want_cls < cls)
+        rb->want_cls = cls;
+
+    return true;
+}
+
+void _bal_recvbuf_adapt(bal_socket* s, size_t got)
+{
+    bal_recv_buf* rb = &s->state.recvb;
+
+    if (0U == got)
+        return;
+
+    /* grow at once for bigger reads, but only shrink after two read events in
+     * a row would have fit the class below. */
+    size_t cls = _bal_recv_class(got);
+    if (cls > rb->want_cls) {
+        rb->want_cls = cls;
+        rb->shrink   = 0U;
+    } else if (cls < rb->want_cls) {
+        if (++rb->shrink >= 2U) {
+            rb->want_cls--;
+            rb->shrink = 0U;
+        }
+    } else {
+        rb->shrink = 0U;
+    }
+}
+
+void _bal_recvbuf_release(bal_socket* s, bool discard)
+{
+    bal_recv_buf* rb = &s->state.recvb;
+
+    if (NULL != rb->data && (discard || rb->start == rb->end)) {
+        _bal_slab_free(&_bal_as_container.recv_bufs[rb->cls], rb->data);
+        rb->data  = NULL;
+        rb->start = 0U;
+        rb->end   = 0U;
+    }
+}
+
+uint_fast32_t _bal_get_recv_idle_ms(void)
+{
+#if defined(__HAVE_STDATOMICS__)
+    return atomic_load(&_bal_as_container.recv_idle_ms);
+#else
+    return _bal_as_container.recv_idle_ms;
+#endif
+}
+
+void _bal_sendq_keep_write(bal_socket* s)
+{
+    if (NULL == s->state.sendq.head || bal_isbitset(s->state.mask, BAL_EVT_WRITE)) {
+        bal_setbitslow(&s->state.bits, BAL_S_SENDQ);
+    } else {
+        bal_setbitshigh(&s->state.mask, BAL_EVT_WRITE);
+        bal_setbitshigh(&s->state.bits, BAL_S_SENDQ);
+    }
+}
+
+void _bal_sendq_clear(bal_socket* s)
+{
+    while (NULL != s->state.sendq.head)
+        _bal_sendq_pop(s);
+    bal_setbitslow(&s->state.bits, BAL_S_SENDQ);
 }
 
 bool _bal_list_create(bal_list** lst)
@@ -445,25 +1232,24 @@ bool _bal_list_create(bal_list** lst)
     bool retval = _bal_okptr(lst);
 
     if (retval) {
-        *lst = calloc(1, sizeof(bal_list));
+        *lst = _bal_calloc(1, sizeof(bal_list));
         retval = NULL != *lst;
     }
 
     return retval;
 }
 
-bool _bal_list_create_node(bal_list_node** node, bal_descriptor key,
+bool _bal_list_init_node(bal_list_node** node, bal_descriptor key,
     bal_socket* val)
 {
-    bool ok = _bal_okptrptr(node);
+    bool ok = _bal_okptrptr(node) && _bal_okptr(val);
 
     if (ok) {
-        *node = calloc(1, sizeof(bal_list_node));
-        if (*node) {
-            (*node)->key = key;
-            (*node)->val = val;
-        }
-        ok = NULL != *node;
+        *node         = &val->state.node;
+        (*node)->key  = key;
+        (*node)->val  = val;
+        (*node)->prev = NULL;
+        (*node)->next = NULL;
     }
 
     return ok;
@@ -475,13 +1261,13 @@ bool _bal_list_add(bal_list* lst, bal_descriptor key, bal_socket* val)
 
     if (ok) {
         if (_bal_list_empty(lst)) {
-            ok = _bal_list_create_node(&lst->head, key, val);
+            ok = _bal_list_init_node(&lst->head, key, val);
             lst->iter = lst->head;
         } else {
             bal_list_node* node = lst->head;
             while (node && node->next)
                 node = node->next;
-            ok = NULL != node && _bal_list_create_node(&node->next, key, val) &&
+            ok = NULL != node && _bal_list_init_node(&node->next, key, val) &&
                  NULL != node->next;
             if (ok)
                 node->next->prev = node;
@@ -581,7 +1367,7 @@ bool _bal_list_remove(bal_list* lst, bal_descriptor key, bal_socket** val)
                 if (node == lst->iter)
                     lst->iter = lst->iter->prev;
                 *val = node->val;
-                ok   = _bal_list_destroy_node(&node);
+                ok   = _bal_list_unlink_node(&node);
                 break;
             }
             node = node->next;
@@ -600,7 +1386,7 @@ bool _bal_list_remove_all(bal_list* lst)
         bal_list_node* node = lst->head;
         while (node) {
             bal_list_node* next = node->next;
-            _bal_eqland(ok , _bal_list_destroy_node(&node));
+            _bal_eqland(ok , _bal_list_unlink_node(&node));
             node = next;
         }
 
@@ -623,9 +1409,9 @@ bool _bal_list_destroy(bal_list** lst)
     return ok;
 }
 
-bool _bal_list_destroy_node(bal_list_node** node)
+bool _bal_list_unlink_node(bal_list_node** node)
 {
-    bool ok = _bal_okptrptr(node) && _bal_okptr(node);
+    bool ok = _bal_okptrptr(node) && _bal_okptr(*node);
 
     if (ok) {
         if ((*node)->prev)
@@ -634,7 +1420,9 @@ bool _bal_list_destroy_node(bal_list_node** node)
         if ((*node)->next)
             (*node)->next->prev = (*node)->prev;
 
-        _bal_safefree(node);
+        (*node)->prev = NULL;
+        (*node)->next = NULL;
+        *node         = NULL;
     }
 
     return ok;
@@ -757,6 +1545,24 @@ void _bal_set_boolean(atomic_bool* boolean, bool value)
     if (boolean)
         atomic_store(boolean, value);
 }
+
+size_t _bal_get_size(const atomic_size_t* size)
+{
+    return NULL != size ? atomic_load(size) : 0;
+}
+
+void _bal_count_peak(atomic_size_t* count, atomic_size_t* peak, bool add)
+{
+    if (!add) {
+        (void)atomic_fetch_sub(count, 1);
+        return;
+    }
+
+    size_t now  = atomic_fetch_add(count, 1) + 1;
+    size_t seen = atomic_load(peak);
+    while (now > seen && !atomic_compare_exchange_weak(peak, &seen, now))
+        ;
+}
 #else
 bool _bal_get_boolean(const bool* boolean)
 {
@@ -773,8 +1579,40 @@ void _bal_set_boolean(bool* boolean, bool value)
     if (boolean)
         *boolean = value;
 }
+
+size_t _bal_get_size(const volatile size_t* size)
+{
+    return NULL != size ? *size : 0;
+}
+
+void _bal_count_peak(volatile size_t* count, volatile size_t* peak, bool add)
+{
+    if (!add) {
+        (*count)--;
+        return;
+    }
+
+    size_t now = ++(*count);
+    if (now > *peak)
+        *peak = now;
+}
 #endif
 
+void _bal_count_registration(bool add)
+{
+    _bal_count_peak(&_bal_as_container.registered, &_bal_as_container.peak_registered,
+        add);
+}
+
+void _bal_close_descriptor(bal_descriptor sd)
+{
+#if defined(__WIN__)
+    (void)closesocket(sd);
+#else
+    (void)close(sd);
+#endif
+}
+
 bool _bal_once(bal_once* once, bal_once_fn func)
 {
 #if defined(__WIN__)
@@ -791,7 +1629,7 @@ bool _bal_addrinfo_to_addrlist(struct addrinfo* ai, bal_addrlist* out)
         bal_addr** a         = &out->addr;
 
         do {
-            *a = calloc(1, sizeof(bal_addr));
+            *a = _bal_calloc(1, sizeof(bal_addr));
             if (!_bal_okptrnf(*a))
                 return _bal_handlelasterr();
 
@@ -878,16 +1716,40 @@ void _bal_static_once_init_func(void)
     bool create = _bal_mutex_create(&_bal_state.mutex);
     BAL_ASSERT_UNUSED(create, create);
 
-    create = _bal_mutex_create(&_bal_as_container.mutex);
-    BAL_ASSERT_UNUSED(create, create);
+    for (size_t n = 0; n < BAL_MAX_REACTORS; n++) {
+        bal_slab* slab   = &_bal_as_container.slabs[n];
+        slab->obj_size   = _BAL_SLAB_ROUNDUP(sizeof(bal_socket));
+        slab->chunk_objs = BAL_SLAB_CHUNK_OBJS;
+        create = _bal_mutex_create(&slab->mutex);
+        BAL_ASSERT_UNUSED(create, create);
+    }
+
+    for (size_t n = 0; n < BAL_RECV_BUF_CLASSES; n++) {
+        create = _bal_mutex_create(&_bal_as_container.recv_bufs[n].mutex);
+        BAL_ASSERT_UNUSED(create, create);
+    }
+
+    _bal_frame_init();
 #if defined(__HAVE_STDATOMICS__)
     atomic_init(&_bal_state.magic, 0U);
     atomic_init(&_bal_async_poll_init, false);
     atomic_init(&_bal_as_container.die, false);
+    atomic_init(&_bal_as_container.histograms, false);
+    atomic_init(&_bal_as_container.recv_idle_ms, 0U);
+    atomic_init(&_bal_as_container.slab_in_use, 0U);
+    atomic_init(&_bal_as_container.slab_peak, 0U);
+    atomic_init(&_bal_as_container.registered, 0U);
+    atomic_init(&_bal_as_container.peak_registered, 0U);
 #else
-    _bal_state.magic      = 0U;
-    _bal_async_poll_init  = false;
-    _bal_as_container.die = false;
+    _bal_state.magic                  = 0U;
+    _bal_async_poll_init              = false;
+    _bal_as_container.die             = false;
+    _bal_as_container.histograms      = false;
+    _bal_as_container.recv_idle_ms    = 0U;
+    _bal_as_container.slab_in_use     = 0U;
+    _bal_as_container.slab_peak       = 0U;
+    _bal_as_container.registered      = 0U;
+    _bal_as_container.peak_registered = 0U;
 #endif
 #if defined(__WIN__)
     return TRUE;
@@ -24,6 +24,7 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include "bal/state.h"
+#include "bal/alloc.h"
 
 /**
  * Globals
@@ -42,11 +43,34 @@ volatile bool _bal_async_poll_init = false;
 /* async I/O state container. */
 bal_as_container _bal_as_container = {
     NULL,
-    BAL_MUTEX_INIT,
-    BAL_THREAD_INIT,
+    1,
+    0,
+    0,
+    /* the socket slabs are sized by _bal_static_once_init_func. */
+    {{BAL_MUTEX_INIT, 0, 0, NULL, NULL, {0}}},
+    {
+        /* 128 KiB chunks for every size class. */
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN, 64),
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN << 1, 32),
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN << 2, 16),
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN << 3, 8),
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN << 4, 4),
+        BAL_SLAB_INIT_CHUNK(BAL_RECV_BUF_MIN << 5, 2)
+    },
+    0,
+    0,
+    0,
+    0,
     0
 };
 
+/* heap allocation hooks (NULL members = C runtime). */
+bal_allocator _bal_allocator = {
+    NULL,
+    NULL,
+    NULL
+};
+
 /* global library state. */
 bal_state _bal_state = {
     BAL_MUTEX_INIT,
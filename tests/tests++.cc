@@ -25,39 +25,36 @@
  */
 #include "tests++.hh"
 #include <vector>
+#include <span>
 #include <cstdlib>
+#include <memory>
+#include <cstring>
 
 using namespace bal;
 
+/* every operation must compile when it returns result<T>. */
+template class bal::basic_socket<socket_base<true, result_policy>, true, result_policy>;
+template class bal::socket_base<true, result_policy>;
+
 static std::vector<bal_test_data> bal_tests = {
-    {"raii-initializer",   tests::init_with_initializer, false, true, false},
-    {"raii_socket_sanity", tests::raii_socket_sanity, false, true, false }
+    {"raii-initializer",   tests::init_with_initializer, false, false, true, false},
+    {"raii_socket_sanity", tests::raii_socket_sanity, false, false, true, false},
+    {"coroutines",         tests::coroutines, false, false, true, false},
+    {"static-sockets",     tests::static_sockets, false, false, true, false},
+    {"shared-handlers",    tests::shared_handlers, false, false, true, false},
+    {"iobuf",              tests::iobuf_chains, false, false, true, false},
+    {"result-policy",      tests::result_policy, false, false, true, false}
 };
 
 int main(int argc, char** argv)
 {
-    BAL_UNUSED(argc);
-    BAL_UNUSED(argv);
-
     _bal_tests_init();
 
-    size_t tests_total  = bal_tests.size();
-    size_t tests_run    = 0;
-    size_t tests_passed = 0;
-
-    _bal_start_all_tests(tests_total);
-
-    for (size_t n = 0; n < tests_total; n++) {
-        _bal_start_test(tests_total, tests_run, bal_tests[n].name);
-        bal_tests[n].pass = bal_tests[n].func();
-        _bal_end_test(tests_total, tests_run, bal_tests[n].name, bal_tests[n].pass);
-        if (bal_tests[n].pass)
-            tests_passed++;
-        tests_run++;
-    }
+    bal_test_options opts {};
+    if (!_bal_parse_test_args(argc, argv, &opts))
+        return EXIT_FAILURE;
 
-    _bal_end_all_tests(tests_total, tests_run, tests_passed);
-    return tests_passed == tests_run ? EXIT_SUCCESS : EXIT_FAILURE;
+    return _bal_run_tests(bal_tests.data(), bal_tests.size(), &opts);
 }
 
 /**
@@ -111,6 +108,52 @@ bool bal::tests::raii_socket_sanity()
         sd = sock.get()->sd;
     }
 
+    /* the connections after the one whose handler throws must be closed. */
+    {
+        TEST_MSG_0("accept_many closes the rest of a batch if on_accepted throws...");
+        scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        _bal_eqland(pass, listener.set_reuseaddr(1));
+        _bal_eqland(pass, listener.bind_all("9970"));
+        _bal_eqland(pass, listener.listen());
+        _bal_eqland(pass, listener.set_io_mode(true));
+
+        std::array<scoped_socket, 3> clients;
+        for (auto& client : clients) {
+            _bal_eqland(pass, client.create(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+            _bal_eqland(pass, client.connect("127.0.0.1", "9970"));
+        }
+        bal_sleep_msec(100);
+
+        bal_slab_stats before {};
+        _bal_eqland(pass, bal_get_slab_stats(&before));
+
+        size_t handled = 0;
+        bool thrown    = false;
+        try {
+            [[maybe_unused]] auto unused = listener.accept_many(clients.size(),
+                [&](scoped_socket&, const address&) {
+                    if (++handled == 1) {
+                        throw std::runtime_error("on_accepted failed");
+                    }
+                });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+
+        bal_slab_stats after {};
+        _bal_eqland(pass, bal_get_slab_stats(&after));
+        TEST_MSG("thrown: %d, handled: %zu, sockets in use before: %zu, after: %zu",
+            thrown, handled, before.in_use, after.in_use);
+        _bal_eqland(pass, thrown && 1 == handled && before.in_use == after.in_use);
+    }
+
+    /* with the default policy, an invalid socket is not an error. */
+    {
+        TEST_MSG_0("closing and polling an invalid socket returns false...");
+        scoped_socket sock;
+        _bal_eqland(pass, !sock.close() && !sock.async_poll());
+    }
+
     TEST_MSG_0("socket_destructed; ensure socket closed/destroyed...");
 #if defined(__WIN__)
     _bal_eqland(pass, SOCKET_ERROR == listen(sd, SOMAXCONN));
@@ -123,6 +166,504 @@ bool bal::tests::raii_socket_sanity()
     _BAL_TEST_CONCLUDE
 }
 
+#if defined(__HAVE_COROUTINES__)
+namespace
+{
+    constexpr size_t co_payload_size = 8 * 1024 * 1024;
+
+    struct co_state
+    {
+        std::atomic_bool served {false};
+        std::atomic_bool echoed {false};
+        std::atomic_bool refused {false};
+        std::atomic_bool failed {false};
+        std::atomic_bool sent {false};
+        std::vector<char> payload;
+    };
+
+    task co_send_payload(scoped_socket& sock, co_state& state)
+    {
+        state.sent = co_await sock.async_send_all(state.payload.data(), state.payload.size());
+    }
+
+    task co_echo_one(scoped_socket& listener, co_state& state)
+    {
+        address client_addr;
+        auto client = std::make_unique<scoped_socket>();
+        if (!co_await listener.async_accept(*client, client_addr)) {
+            state.failed = true;
+            co_return;
+        }
+
+        client->handlers().on_close = nullptr;
+        client->handlers().on_error = nullptr;
+        if (!client->async_poll(BAL_EVT_NORMAL)) {
+            state.failed = true;
+            co_return;
+        }
+
+        std::array<char, 4096> buf {};
+        for (;;) {
+            const auto read = co_await client->async_recv(buf.data(), buf.size());
+            if (read <= 0) {
+                break;
+            }
+            if (!co_await client->async_send_all(buf.data(), static_cast<size_t>(read))) {
+                state.failed = true;
+                break;
+            }
+        }
+
+        [[maybe_unused]] auto unused = client->close();
+        state.served = true;
+    }
+
+    task co_client(scoped_socket& sock, co_state& state)
+    {
+        if (!co_await sock.async_connect("127.0.0.1", "6984")) {
+            state.failed = true;
+            co_return;
+        }
+
+        /* large enough that the send has to wait for the echo to be read, so
+         * this coroutine receives while another one sends. */
+        co_send_payload(sock, state);
+
+        std::vector<char> echo(state.payload.size());
+        size_t received = 0;
+
+        while (received < echo.size()) {
+            const auto read = co_await sock.async_recv(echo.data() + received,
+                static_cast<bal_iolen>(echo.size() - received));
+            if (read <= 0) {
+                break;
+            }
+            received += static_cast<size_t>(read);
+        }
+
+        if (!state.sent || received != echo.size() || echo != state.payload) {
+            state.failed = true;
+        }
+        state.echoed = true;
+        [[maybe_unused]] auto unused = sock.close();
+    }
+
+    task co_refused(scoped_socket& sock, co_state& state)
+    {
+        /* nothing is listening on this port. */
+        state.refused = !co_await sock.async_connect("127.0.0.1", "6985");
+    }
+}
+#endif
+
+bool bal::tests::coroutines()
+{
+    _BAL_TEST_COMMENCE
+
+#if defined(__HAVE_COROUTINES__)
+    co_state state;
+    state.payload.resize(co_payload_size);
+    for (size_t n = 0; n < state.payload.size(); n++) {
+        state.payload[n] = static_cast<char>(n % 251);
+    }
+
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    listener.handlers().on_close = nullptr;
+    listener.handlers().on_error = nullptr;
+    _bal_eqland(pass, listener.set_reuseaddr(1));
+    _bal_eqland(pass, listener.bind_all("6984"));
+    _bal_eqland(pass, listener.async_poll(BAL_EVT_NORMAL));
+    _bal_eqland(pass, listener.listen());
+
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    client.handlers().on_close = nullptr;
+    client.handlers().on_error = nullptr;
+    _bal_eqland(pass, client.async_poll(BAL_EVT_CLIENT));
+
+    scoped_socket refused(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    refused.handlers().on_close = nullptr;
+    refused.handlers().on_error = nullptr;
+    _bal_eqland(pass, refused.async_poll(BAL_EVT_CLIENT));
+
+    if (pass) {
+        TEST_MSG("echo %zu bytes between coroutines...", co_payload_size);
+        co_echo_one(listener, state);
+        co_client(client, state);
+        co_refused(refused, state);
+
+        for (int n = 0; n < 1000 && (!state.served || !state.echoed || !state.refused); n++) {
+            bal_sleep_msec(10);
+        }
+
+        _bal_eqland(pass, state.echoed.load());
+        _bal_eqland(pass, state.served.load());
+        _bal_eqland(pass, state.refused.load());
+        _bal_eqland(pass, !state.failed.load());
+    }
+
+    [[maybe_unused]] auto unused1 = listener.deregister_async_poll();
+    [[maybe_unused]] auto unused2 = refused.deregister_async_poll();
+#else
+    TEST_MSG_0("coroutines are not supported by this compiler; skipping");
+#endif
+
+    _BAL_TEST_CONCLUDE
+}
+
+namespace
+{
+    std::atomic_bool static_echoed {false};
+    std::atomic_bool static_closed {false};
+
+    /** Echoes whatever it reads, and closes on close events by default. */
+    class static_echo_socket : public static_socket<static_echo_socket>
+    {
+    public:
+        bool on_read()
+        {
+            std::array<char, 64> buf {};
+            const auto read = recv(buf.data(), buf.size(), 0);
+            if (read > 0) {
+                [[maybe_unused]] auto unused = send(buf.data(), static_cast<bal_iolen>(read));
+            }
+            return true;
+        }
+    };
+
+    class static_listen_socket : public static_socket<static_listen_socket>
+    {
+    public:
+        using static_socket::static_socket;
+
+        bool on_incoming_conn()
+        {
+            address client_addr;
+            if (accept(client, client_addr)) {
+                [[maybe_unused]] auto unused = client.async_poll();
+            }
+            return true;
+        }
+
+        static_echo_socket client;
+    };
+
+    class static_client_socket : public static_socket<static_client_socket>
+    {
+    public:
+        using static_socket::static_socket;
+
+        bool on_connect()
+        {
+            [[maybe_unused]] auto unused = send("ping", 4);
+            return true;
+        }
+
+        bool on_read()
+        {
+            std::array<char, 64> buf {};
+            const auto read = recv(buf.data(), buf.size(), 0);
+            static_echoed = 4 == read && 0 == std::memcmp(buf.data(), "ping", 4);
+            return true;
+        }
+
+        bool on_close()
+        {
+            static_closed = true;
+            [[maybe_unused]] auto unused = close();
+            return false;
+        }
+    };
+}
+
+bool bal::tests::static_sockets()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("check the default masks...");
+    _bal_eqland(pass, static_echo_socket::default_event_mask() ==
+        (BAL_EVT_READ | BAL_EVT_CLOSE | BAL_EVT_ERROR));
+    _bal_eqland(pass, static_listen_socket::default_event_mask() ==
+        (BAL_EVT_ACCEPT | BAL_EVT_CLOSE | BAL_EVT_ERROR));
+    _bal_eqland(pass, static_client_socket::default_event_mask() ==
+        (BAL_EVT_READ | BAL_EVT_CONNECT | BAL_EVT_CLOSE | BAL_EVT_ERROR));
+    _bal_eqland(pass, sizeof(static_client_socket) < sizeof(scoped_socket));
+
+    static_listen_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, listener.set_reuseaddr(1));
+    _bal_eqland(pass, listener.bind_all("6986"));
+    _bal_eqland(pass, listener.async_poll());
+    _bal_eqland(pass, listener.listen());
+
+    static_client_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, client.async_poll());
+    _bal_eqland(pass, client.connect("127.0.0.1", "6986"));
+
+    TEST_MSG_0("echo a message between static sockets...");
+    for (int n = 0; n < 1000 && !static_echoed; n++) {
+        bal_sleep_msec(10);
+    }
+    _bal_eqland(pass, static_echoed.load());
+
+    TEST_MSG_0("close the server side; expect on_close...");
+    [[maybe_unused]] auto unused1 = listener.client.close();
+    for (int n = 0; n < 1000 && !static_closed; n++) {
+        bal_sleep_msec(10);
+    }
+    _bal_eqland(pass, static_closed.load());
+
+    [[maybe_unused]] auto unused2 = listener.deregister_async_poll();
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::shared_handlers()
+{
+    _BAL_TEST_COMMENCE
+
+    size_t shared_reads = 0;
+    size_t own_reads    = 0;
+
+    handler_set<scoped_socket> handlers;
+    handlers.on_read = [&](scoped_socket*)
+    {
+        shared_reads++;
+        return true;
+    };
+    const auto shared = std::move(handlers).share();
+
+    /* the sockets are registered but never connect, so the events thread
+     * leaves them alone; events are delivered by calling the callback. */
+    auto deliver = [](scoped_socket& sock, uint32_t events)
+    {
+        bal_socket* s = sock.get();
+        s->state.proc(s, events);
+    };
+
+    TEST_MSG_0("share one handler set between two sockets...");
+    /* sockets don't hold handlers of their own until they set one. */
+    _bal_eqland(pass, sizeof(scoped_socket) < sizeof(scoped_socket::handlers_type));
+    scoped_socket first(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    scoped_socket second(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    first.set_handlers(shared);
+    second.set_handlers(shared);
+    _bal_eqland(pass, first.async_poll(BAL_EVT_READ));
+    _bal_eqland(pass, second.async_poll(BAL_EVT_READ));
+    _bal_eqland(pass, 3L == shared.use_count());
+
+    deliver(first, BAL_EVT_READ);
+    deliver(second, BAL_EVT_READ);
+    _bal_eqland(pass, 2U == shared_reads);
+
+    TEST_MSG_0("override the shared handler on one socket...");
+    second.handlers().on_read = [&](scoped_socket*)
+    {
+        own_reads++;
+        return true;
+    };
+    deliver(second, BAL_EVT_READ);
+    _bal_eqland(pass, 2U == shared_reads && 1U == own_reads);
+
+    TEST_MSG_0("move a socket; the set moves with it...");
+    _bal_eqland(pass, first.deregister_async_poll());
+    scoped_socket moved;
+    moved = std::move(first);
+    _bal_eqland(pass, 3L == shared.use_count());
+    _bal_eqland(pass, nullptr == first.get_handlers());
+    _bal_eqland(pass, moved.async_poll(BAL_EVT_READ));
+    deliver(moved, BAL_EVT_READ);
+    _bal_eqland(pass, 3U == shared_reads);
+
+    TEST_MSG_0("close events use the set's default handler...");
+    deliver(moved, BAL_EVT_CLOSE);
+    _bal_eqland(pass, !moved.is_valid());
+
+    _bal_eqland(pass, second.deregister_async_poll());
+
+    _BAL_TEST_CONCLUDE
+}
+
+bool bal::tests::iobuf_chains()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("build a chain from shared fragments...");
+    const auto header = std::make_shared<const std::string>("HTTP/1.1 200 OK\r\n\r\n");
+    const auto body   = std::make_shared<const std::string>(4096, 'x');
+
+    iobuf chain;
+    chain.append(header);
+    chain.append(body);
+    chain.append(iobuf::copy("\r\n", 2));
+    _bal_eqland(pass, chain.size() == header->size() + body->size() + 2UL);
+    _bal_eqland(pass, 3UL == chain.slice_count());
+    _bal_eqland(pass, 2L == body.use_count());
+
+    const std::string expected = *header + *body + "\r\n";
+    _bal_eqland(pass, chain.to_string() == expected);
+
+    TEST_MSG_0("split and consume without copying...");
+    iobuf copy;
+    copy.append(chain);
+    _bal_eqland(pass, 3L == body.use_count());
+
+    iobuf front = copy.split(header->size() + 10UL);
+    _bal_eqland(pass, front.size() == header->size() + 10UL);
+    _bal_eqland(pass, 2UL == front.slice_count());
+    _bal_eqland(pass, front.to_string() == expected.substr(0, header->size() + 10UL));
+    _bal_eqland(pass, copy.to_string() == expected.substr(header->size() + 10UL));
+
+    copy.consume(body->size() - 20UL);
+    _bal_eqland(pass, 2UL == copy.slice_count());
+    _bal_eqland(pass, copy.to_string() == expected.substr(expected.size() - 12UL));
+    copy.consume(100UL);
+    _bal_eqland(pass, copy.empty() && 0UL == copy.slice_count());
+
+    TEST_MSG_0("send the chain over loopback...");
+    scoped_socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, listener.set_reuseaddr(1));
+    _bal_eqland(pass, listener.bind_all("6988"));
+    _bal_eqland(pass, listener.listen());
+
+    scoped_socket client(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, client.connect("127.0.0.1", "6988"));
+
+    scoped_socket server;
+    address server_addr;
+    for (int n = 0; n < 1000 && !server.is_valid(); n++) {
+        if (!listener.accept(server, server_addr)) {
+            bal_sleep_msec(10);
+        }
+    }
+    _bal_eqland(pass, server.is_valid());
+    _bal_eqland(pass, server.set_io_mode(false));
+
+    std::string received;
+    std::array<char, 1024> buf {};
+    for (int n = 0; pass && n < 1000 && received.size() < expected.size(); n++) {
+        if (!chain.empty() && client.send(chain) < 0L) {
+            pass = false;
+            break;
+        }
+        const auto read = server.recv(buf);
+        if (read > 0L) {
+            received.append(buf.data(), static_cast<size_t>(read));
+        }
+    }
+    _bal_eqland(pass, chain.empty());
+    _bal_eqland(pass, received == expected);
+
+    TEST_MSG_0("send a span...");
+    const std::vector<uint16_t> words {1U, 2U, 3U, 4U};
+    _bal_eqland(pass, 8L == client.send(std::span(words)));
+    std::array<uint16_t, 4> read_words {};
+    _bal_eqland(pass, 8L == server.recv(read_words));
+    _bal_eqland(pass, std::ranges::equal(words, read_words));
+
+    _BAL_TEST_CONCLUDE
+}
+
+namespace
+{
+    using result_socket = socket_base<true, bal::result_policy>;
+
+#if defined(__HAVE_COROUTINES__)
+    struct co_result_state
+    {
+        std::atomic_bool done {false};
+        std::atomic_int error_code {0};
+        std::atomic_int os_error_code {0};
+    };
+
+    task co_refused_result(result_socket& sock, co_result_state& state)
+    {
+        /* nothing is listening on this port. */
+        const auto connected = co_await sock.async_connect("127.0.0.1", "6985");
+        if (!connected) {
+            state.error_code    = connected.error_code();
+            state.os_error_code = connected.os_error_code();
+        }
+        state.done = true;
+    }
+#endif
+}
+
+bool bal::tests::result_policy()
+{
+    _BAL_TEST_COMMENCE
+
+    TEST_MSG_0("successful operations carry their values...");
+    result_socket sock(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    const auto reuse = sock.set_reuseaddr(1);
+    _bal_eqland(pass, reuse.has_value() && *reuse && 0 == reuse.error_code());
+
+    TEST_MSG_0("a refused connection fails without throwing...");
+    const auto refused = sock.connect("127.0.0.1", "6985");
+    _bal_eqland(pass, !refused && !*refused);
+    _bal_eqland(pass, BAL_E_PLATFORM == refused.error_code());
+#if defined(__WIN__)
+    _bal_eqland(pass, WSAECONNREFUSED == refused.os_error_code());
+#else
+    _bal_eqland(pass, ECONNREFUSED == refused.os_error_code());
+#endif
+
+    const auto err = refused.get_error();
+    _bal_eqland(pass, BAL_E_PLATFORM == err.code && !err.message.empty());
+    TEST_MSG("formatted on demand: '%s'", err.message.c_str());
+
+    TEST_MSG_0("libbal errors have no OS code...");
+    result_socket invalid;
+    std::array<char, 16> buf {};
+    const auto read = invalid.recv(buf);
+    _bal_eqland(pass, !read && -1L == *read && -1L == read.value_or(-1L));
+    _bal_eqland(pass, BAL_E_BADSOCKET == read.error_code() && 0 == read.os_error_code());
+
+    TEST_MSG_0("value() throws if asked for a failure's value...");
+    bool threw = false;
+    try {
+        [[maybe_unused]] auto unused = read.value();
+    } catch (bal::exception&) {
+        threw = true;
+    }
+    _bal_eqland(pass, threw);
+
+    TEST_MSG_0("operations on an invalid socket fail, rather than succeed...");
+    const auto closed = invalid.close();
+    _bal_eqland(pass, !closed && BAL_E_BADSOCKET == closed.error_code());
+    const auto polled = invalid.async_poll();
+    _bal_eqland(pass, !polled && 0 != polled.error_code());
+
+    TEST_MSG_0("a constructor that fails to create leaves the socket invalid...");
+    result_socket bad(-1, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, !bad.is_valid());
+
+#if defined(__HAVE_COROUTINES__)
+    TEST_MSG_0("a coroutine's refused connection fails without throwing...");
+    co_result_state state;
+    result_socket refused_sock(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    refused_sock.handlers().on_close = nullptr;
+    refused_sock.handlers().on_error = nullptr;
+    _bal_eqland(pass, refused_sock.async_poll(BAL_EVT_CLIENT));
+
+    if (pass) {
+        co_refused_result(refused_sock, state);
+        for (int n = 0; n < 1000 && !state.done; n++) {
+            bal_sleep_msec(10);
+        }
+        _bal_eqland(pass, state.done.load());
+        _bal_eqland(pass, BAL_E_PLATFORM == state.error_code);
+# if defined(__WIN__)
+        _bal_eqland(pass, WSAECONNREFUSED == state.os_error_code);
+# else
+        _bal_eqland(pass, ECONNREFUSED == state.os_error_code);
+# endif
+    }
+
+    [[maybe_unused]] auto unused = refused_sock.deregister_async_poll();
+#endif
+
+    _BAL_TEST_CONCLUDE
+}
+
 /*bool bal::tests::()
 {
     _BAL_TEST_COMMENCE
@@ -52,6 +52,47 @@ namespace bal::tests
      */
     bool raii_socket_sanity();
 
+    /**
+     * @test coroutines
+     * @brief Ensure that coroutines can accept, connect, send and receive using
+     * the socket_base awaitables, and are resumed by the events thread.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool coroutines();
+
+    /**
+     * @test static_sockets
+     * @brief Ensure that static_socket calls the handlers its derived class
+     * declares, and registers for only their events.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool static_sockets();
+
+    /**
+     * @test shared_handlers
+     * @brief Ensure that sockets sharing a handler_set dispatch to it without
+     * copying it, and that their own handlers take precedence.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool shared_handlers();
+
+    /**
+     * @test iobuf_chains
+     * @brief Ensure that iobuf chains can be appended, split and consumed
+     * without copying, and sent with vectored I/O; and that contiguous ranges
+     * can be sent and received.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool iobuf_chains();
+
+    /**
+     * @test result_policy
+     * @brief Ensure that sockets under result_policy return result<T> carrying
+     * the error codes, instead of throwing.
+     * @returns true if the test succeeded, false otherwise.
+     */
+    bool result_policy();
+
     /**
      * @ test
      * @ brief
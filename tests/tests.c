@@ -25,40 +25,47 @@
  */
 #include "tests.h"
 #include <stdlib.h>
+#include <string.h>
 
-#pragma message("TODO: implement CLI")
-#pragma message("TODO: implement offline-only test runs")
+#if !defined(__WIN__)
+# include <sys/resource.h>
+#endif
 
 static bal_test_data bal_tests[] = {
-    {"init-cleanup-sanity", baltest_init_cleanup_sanity, false, true, false},
-    {"create-bind-listen",  baltest_create_bind_listen_tcp, false, true, false},
-    {"error-sanity",        baltest_error_sanity, false, true, false}
+    {"init-cleanup-sanity", baltest_init_cleanup_sanity, false, false, true, false},
+    {"create-bind-listen",  baltest_create_bind_listen_tcp, false, false, true, false},
+    {"error-sanity",        baltest_error_sanity, false, false, true, false},
+    {"slab-sanity",         baltest_slab_sanity, false, false, true, false},
+    {"allocator-hooks",     baltest_allocator_hooks, false, false, true, false},
+    {"accept-many",         baltest_accept_many, false, false, true, false},
+    {"socket-opts",         baltest_socket_opts, false, false, true, false},
+    {"listen-sharded",      baltest_listen_sharded, false, false, true, false},
+    {"readiness",           baltest_readiness, false, false, true, false},
+    {"io-stats",            baltest_io_stats, false, false, true, false},
+    {"loop-histograms",     baltest_loop_histograms, false, false, true, false},
+    {"async-connect",       baltest_async_connect, false, false, true, false},
+    {"registration",        baltest_registration, false, false, true, false},
+    {"send-async",          baltest_send_async, false, false, true, false},
+    {"send-watermarks",     baltest_send_watermarks, false, false, true, false},
+    {"async-recv",          baltest_async_recv, false, false, true, false},
+    {"recv-sizing",         baltest_recv_sizing, false, false, true, false},
+    {"framing",             baltest_framing, false, false, true, false},
+    {"async-lines",         baltest_async_lines, false, false, true, false},
+    {"sendv",               baltest_sendv, false, false, true, false},
+    {"destroy-in-handler",  baltest_destroy_in_handler, false, false, true, false},
+    {"perf-register",       baltest_perf_register, false, true, true, false},
+    {"perf-round-trip",     baltest_perf_round_trip, false, true, true, false}
 };
 
 int main(int argc, char** argv)
 {
-    BAL_UNUSED(argc);
-    BAL_UNUSED(argv);
-
     _bal_tests_init();
 
-    size_t tests_total  = _bal_countof(bal_tests);
-    size_t tests_run    = 0;
-    size_t tests_passed = 0;
-
-    _bal_start_all_tests(tests_total);
-
-    for (size_t n = 0; n < tests_total; n++) {
-        _bal_start_test(tests_total, tests_run, bal_tests[n].name);
-        bal_tests[n].pass = bal_tests[n].func();
-        _bal_end_test(tests_total, tests_run, bal_tests[n].name, bal_tests[n].pass);
-        if (bal_tests[n].pass)
-            tests_passed++;
-        tests_run++;
-    }
+    bal_test_options opts;
+    if (!_bal_parse_test_args(argc, argv, &opts))
+        return EXIT_FAILURE;
 
-    _bal_end_all_tests(tests_total, tests_run, tests_passed);
-    return tests_passed == tests_run ? EXIT_SUCCESS : EXIT_FAILURE;
+    return _bal_run_tests(bal_tests, _bal_countof(bal_tests), &opts);
 }
 
 /**
@@ -159,6 +166,7 @@ bool baltest_error_sanity(void)
         {BAL_E_INTERNAL,   "BAL_E_INTERNAL"},   /* An internal error has occurred */
         {BAL_E_UNAVAIL,    "BAL_E_UNAVAIL"},    /* Feature is disabled or unavailable */
         {BAL_E_PLATFORM,   "BAL_E_PLATFORM"},   /* Platform error code %d: %s */
+        {BAL_E_INUSE,      "BAL_E_INUSE"},      /* Resource is in use */
         {BAL_E_UNKNOWN,    "BAL_E_UNKNOWN"}     /* An unknown error has occurred */
     };
 
@@ -180,6 +188,16 @@ bool baltest_error_sanity(void)
         _bal_eqland(pass, err.message[0] != '\0');
         TEST_MSG("%s = %s", error_dict[n].as_string, err.message);
 
+        /* codes only, then the same message formatted from them. */
+        bal_error_codes codes = {0};
+        ret = bal_get_error_codes(&codes);
+        _bal_eqland(pass, error_dict[n].code == ret && ret == codes.code);
+        _bal_eqland(pass, (BAL_E_PLATFORM == ret) == (0 != codes.os_code));
+        bal_error formatted = {0};
+        ret = bal_format_error(&codes, &formatted);
+        _bal_eqland(pass, error_dict[n].code == ret && ret == formatted.code);
+        _bal_eqland(pass, 0 == strcmp(err.message, formatted.message));
+
         /* with extended information. */
         ret = bal_get_error_ext(&err);
         _bal_eqland(pass, error_dict[n].code == ret && ret == err.code);
@@ -196,3 +214,1912 @@ bool baltest_error_sanity(void)
 
     return pass;
 }
+
+bool baltest_slab_sanity(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    bal_slab_stats before = {0};
+    _bal_eqland(pass, bal_get_slab_stats(&before));
+    _bal_print_err(pass, false);
+
+    /* allocate more than one chunk's worth of sockets. */
+    bal_socket* socks[BAL_SLAB_CHUNK_OBJS + 1] = {NULL};
+    TEST_MSG("creating %zu sockets...", _bal_countof(socks));
+    for (size_t n = 0; n < _bal_countof(socks); n++) {
+        _bal_eqland(pass, bal_create(&socks[n], 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        _bal_print_err(pass, false);
+    }
+
+    bal_slab_stats during = {0};
+    _bal_eqland(pass, bal_get_slab_stats(&during));
+    _bal_eqland(pass, during.in_use == before.in_use + _bal_countof(socks));
+    _bal_eqland(pass, during.capacity >= during.in_use && during.chunks >= 2);
+    TEST_MSG("in use: %zu, peak: %zu, chunks: %zu, capacity: %zu", during.in_use,
+        during.peak, during.chunks, during.capacity);
+
+    /* the most recently freed socket should be the next one handed out. */
+    TEST_MSG_0("ensuring freed sockets are reused...");
+    bal_socket* last = socks[_bal_countof(socks) - 1];
+    _bal_eqland(pass, bal_close(&socks[_bal_countof(socks) - 1], true));
+    _bal_eqland(pass, bal_create(&socks[_bal_countof(socks) - 1], 0, AF_INET,
+        SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, last == socks[_bal_countof(socks) - 1]);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    for (size_t n = 0; n < _bal_countof(socks); n++) {
+        _bal_eqland(pass, bal_close(&socks[n], true));
+        _bal_print_err(pass, false);
+    }
+
+    bal_slab_stats after = {0};
+    _bal_eqland(pass, bal_get_slab_stats(&after));
+    _bal_eqland(pass, after.in_use == before.in_use);
+    _bal_eqland(pass, after.chunks == during.chunks);
+    _bal_eqland(pass, after.allocs - after.frees == after.in_use);
+    TEST_MSG("allocs: %zu, frees: %zu, in use: %zu", after.allocs, after.frees,
+        after.in_use);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+} test_alloc_counts;
+
+static void* test_calloc(size_t num, size_t size, void* ctx)
+{
+    void* ptr = calloc(num, size);
+    if (NULL != ptr)
+        ((test_alloc_counts*)ctx)->allocs++;
+    return ptr;
+}
+
+static void test_free(void* ptr, void* ctx)
+{
+    if (NULL != ptr)
+        ((test_alloc_counts*)ctx)->frees++;
+    free(ptr);
+}
+
+bool baltest_allocator_hooks(void)
+{
+    test_alloc_counts counts = {0};
+    bal_allocator alloc = {&test_calloc, &test_free, &counts};
+
+    TEST_MSG_0("installing counting allocator...");
+    bool pass = bal_set_allocator(&alloc);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("initializing library...");
+    _bal_eqland(pass, bal_init());
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring the allocator can't be swapped after bal_init...");
+    _bal_eqland(pass, !bal_set_allocator(NULL));
+    _bal_print_err(pass, true);
+
+    TEST_MSG_0("creating a socket and resolving localhost...");
+    bal_socket* s = NULL;
+    _bal_eqland(pass, bal_create(&s, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_print_err(pass, false);
+
+    bal_addrlist addrs = {NULL, NULL};
+    _bal_eqland(pass, bal_resolve_host("localhost", &addrs));
+    _bal_print_err(pass, false);
+    _bal_eqland(pass, bal_free_addrlist(&addrs));
+
+    TEST_MSG_0("closing and destroying socket...");
+    _bal_eqland(pass, bal_close(&s, true));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    TEST_MSG("allocs: %zu, frees: %zu", counts.allocs, counts.frees);
+    _bal_eqland(pass, counts.allocs > 0 && counts.allocs == counts.frees);
+
+    TEST_MSG_0("restoring default allocator...");
+    _bal_eqland(pass, bal_set_allocator(NULL));
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static void accept_many_cb(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    BAL_UNUSED(events);
+}
+
+bool baltest_accept_many(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("creating non-blocking listener on 127.0.0.1:6970...");
+    bal_socket* listener = NULL;
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6970"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_set_io_mode(listener, true));
+    _bal_print_err(pass, false);
+
+    bal_socket* clients[5] = {NULL};
+    TEST_MSG("connecting %zu clients...", _bal_countof(clients));
+    for (size_t n = 0; n < _bal_countof(clients); n++) {
+        _bal_eqland(pass, bal_create(&clients[n], 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        _bal_eqland(pass, bal_connect(clients[n], "127.0.0.1", "6970"));
+        _bal_print_err(pass, false);
+    }
+
+    /* one call should accept everything up to max, leaving one connection in
+     * the backlog for the registering variant below. */
+    bal_socket* accepted[_bal_countof(clients)] = {NULL};
+    bal_sockaddr addrs[_bal_countof(clients)];
+    TEST_MSG_0("accepting pending connections in one batch...");
+    ssize_t count = bal_accept_many(listener, accepted, addrs, _bal_countof(clients) - 1);
+    TEST_MSG("accepted %zd connection(s)", count);
+    _bal_eqland(pass, (ssize_t)_bal_countof(clients) - 1 == count);
+    _bal_print_err(pass, false);
+
+    for (ssize_t n = 0; n < count; n++)
+        _bal_eqland(pass, bal_isbitset(accepted[n]->state.bits, BAL_S_NONBLOCK));
+
+    TEST_MSG_0("accepting and registering the remaining connection...");
+    bal_socket** last = &accepted[_bal_countof(accepted) - 1];
+    _bal_eqland(pass, 1 == bal_accept_many_async(listener, last, NULL, 1,
+        &accept_many_cb, BAL_EVT_READ | BAL_EVT_CLOSE));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring an empty backlog is not an error...");
+    bal_socket* none = NULL;
+    _bal_eqland(pass, 0 == bal_accept_many(listener, &none, NULL, 1));
+    _bal_print_err(pass, false);
+
+    /* rather than blocking once the backlog is empty, each call stops after
+     * one connection. */
+    TEST_MSG_0("ensuring a blocking listener yields one connection per call...");
+    bal_socket* blocking[2] = {NULL};
+    bal_socket* blocking_accepted[_bal_countof(blocking)] = {NULL};
+    _bal_eqland(pass, bal_set_io_mode(listener, false));
+    for (size_t n = 0; n < _bal_countof(blocking); n++) {
+        _bal_eqland(pass, bal_create(&blocking[n], 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        _bal_eqland(pass, bal_connect(blocking[n], "127.0.0.1", "6970"));
+    }
+    for (size_t n = 0; pass && n < _bal_countof(blocking); n++) {
+        _bal_eqland(pass, 1 == bal_accept_many(listener, &blocking_accepted[n], NULL,
+            _bal_countof(blocking_accepted)));
+    }
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != *last)
+        _bal_eqland(pass, bal_async_poll(*last, NULL, 0U));
+    for (size_t n = 0; n < _bal_countof(clients); n++) {
+        if (NULL != accepted[n])
+            _bal_eqland(pass, bal_close(&accepted[n], true));
+        if (NULL != clients[n])
+            _bal_eqland(pass, bal_close(&clients[n], true));
+    }
+    for (size_t n = 0; n < _bal_countof(blocking); n++) {
+        if (NULL != blocking_accepted[n])
+            _bal_eqland(pass, bal_close(&blocking_accepted[n], true));
+        if (NULL != blocking[n])
+            _bal_eqland(pass, bal_close(&blocking[n], true));
+    }
+    _bal_eqland(pass, bal_close(&listener, true));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_socket_opts(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    bal_socket_opts opts = {0};
+    opts.mask         = BAL_OPT_REUSEADDR | BAL_OPT_KEEPALIVE | BAL_OPT_LINGER |
+                        BAL_OPT_SNDBUF | BAL_OPT_RCVTIMEO;
+    opts.reuseaddr    = 1;
+    opts.keepalive    = 1;
+    opts.linger       = (struct linger){1, 5};
+    opts.sendbuf_size = 65536;
+    opts.recv_timeout = (struct timeval){2, 0};
+
+    TEST_MSG_0("creating socket with an option profile...");
+    bal_socket* s = NULL;
+    _bal_eqland(pass, bal_create_ex(&s, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP, &opts));
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        TEST_MSG_0("ensuring the socket is non-blocking...");
+        _bal_eqland(pass, bal_isbitset(s->state.bits, BAL_S_NONBLOCK));
+#if !defined(__WIN__)
+        _bal_eqland(pass, 0 != (fcntl(s->sd, F_GETFL) & O_NONBLOCK));
+        _bal_eqland(pass, 0 != (fcntl(s->sd, F_GETFD) & FD_CLOEXEC));
+#endif
+
+        TEST_MSG_0("ensuring applied options are cached...");
+        uint32_t cached = BAL_OPT_REUSEADDR | BAL_OPT_KEEPALIVE | BAL_OPT_LINGER |
+                          BAL_OPT_RCVTIMEO;
+        _bal_eqland(pass, cached == s->state.opts.mask);
+
+        int value = 0;
+        _bal_eqland(pass, bal_get_keepalive(s, &value) && 1 == value);
+        bal_linger linger = 0;
+        _bal_eqland(pass, bal_get_linger(s, &linger) && 5 == linger);
+        bal_tvsec sec   = 0;
+        bal_tvusec usec = 0;
+        _bal_eqland(pass, bal_get_recv_timeout(s, &sec, &usec) && 2 == sec && 0 == usec);
+
+        /* the kernel may adjust buffer sizes, so they're only cached once read. */
+        TEST_MSG_0("ensuring buffer sizes are read back from the socket...");
+        _bal_eqland(pass, bal_get_sendbuf_size(s, &value) && value >= opts.sendbuf_size);
+        _bal_eqland(pass, bal_isbitset(s->state.opts.mask, BAL_OPT_SNDBUF));
+        TEST_MSG("send buffer size: %d", value);
+
+        TEST_MSG_0("ensuring bal_set_option invalidates the cache...");
+        value = 0;
+        _bal_eqland(pass, bal_set_option(s, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(int)));
+        _bal_eqland(pass, !bal_isbitset(s->state.opts.mask, BAL_OPT_KEEPALIVE));
+        value = 1;
+        _bal_eqland(pass, bal_get_keepalive(s, &value) && 0 == value);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("switching to blocking I/O...");
+        _bal_eqland(pass, bal_set_io_mode(s, false));
+        _bal_eqland(pass, !bal_isbitset(s->state.bits, BAL_S_NONBLOCK));
+#if !defined(__WIN__)
+        _bal_eqland(pass, 0 == (fcntl(s->sd, F_GETFL) & O_NONBLOCK));
+#endif
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("closing and destroying socket...");
+        _bal_eqland(pass, bal_close(&s, true));
+        _bal_print_err(pass, false);
+    }
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+typedef struct {
+    bal_mutex mutex;
+    size_t accepted;
+    size_t mismatched;
+} test_shard_counts;
+
+static test_shard_counts shard_counts;
+
+static void listen_sharded_cb(bal_socket* s, uint32_t events)
+{
+    if (!bal_isbitset(events, BAL_EVT_ACCEPT))
+        return;
+
+    bal_socket* accepted[8] = {NULL};
+    ssize_t count = bal_accept_many(s, accepted, NULL, _bal_countof(accepted));
+
+    (void)_bal_mutex_lock(&shard_counts.mutex);
+    for (ssize_t n = 0; n < count; n++) {
+        shard_counts.accepted++;
+        /* sockets are allocated from their reactor's slab. */
+        if (accepted[n]->state.reactor != s->state.reactor ||
+            accepted[n]->state.slab != s->state.reactor)
+            shard_counts.mismatched++;
+        (void)bal_close(&accepted[n], true);
+    }
+    (void)_bal_mutex_unlock(&shard_counts.mutex);
+}
+
+bool baltest_listen_sharded(void)
+{
+    TEST_MSG_0("initializing library with 4 reactors...");
+    bool pass = bal_set_reactor_count(4);
+    _bal_eqland(pass, bal_init());
+    _bal_eqland(pass, 4 == bal_get_reactor_count());
+    _bal_eqland(pass, _bal_mutex_create(&shard_counts.mutex));
+    _bal_print_err(pass, false);
+
+    uint32_t flags = 0U;
+#if defined(__HAVE_REUSEPORT_CBPF__)
+    flags = BAL_SHARD_STEER_CPU;
+#endif
+
+    bal_socket* listeners[4] = {NULL};
+    TEST_MSG("creating %zu sharded listeners on 127.0.0.1:6971 (flags = %08"PRIx32")...",
+        _bal_countof(listeners), flags);
+    bool sharded = bal_listen_sharded(listeners, _bal_countof(listeners), AF_INET,
+        "127.0.0.1", "6971", SOMAXCONN, flags);
+
+#if defined(__HAVE_SO_REUSEPORT__)
+    _bal_eqland(pass, sharded);
+    _bal_print_err(pass, false);
+
+    for (size_t n = 0; pass && n < _bal_countof(listeners); n++) {
+        _bal_eqland(pass, n == listeners[n]->state.reactor);
+        _bal_eqland(pass, bal_async_poll(listeners[n], &listen_sharded_cb, BAL_EVT_NORMAL));
+    }
+    _bal_print_err(pass, false);
+
+    bal_socket* clients[16] = {NULL};
+    TEST_MSG("connecting %zu clients...", _bal_countof(clients));
+    for (size_t n = 0; pass && n < _bal_countof(clients); n++) {
+        _bal_eqland(pass, bal_create(&clients[n], 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        _bal_eqland(pass, bal_connect(clients[n], "127.0.0.1", "6971"));
+    }
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("waiting for the reactors to accept every connection...");
+    size_t accepted   = 0;
+    size_t mismatched = 0;
+    for (int wait = 0; wait < 100; wait++) {
+        (void)_bal_mutex_lock(&shard_counts.mutex);
+        accepted   = shard_counts.accepted;
+        mismatched = shard_counts.mismatched;
+        (void)_bal_mutex_unlock(&shard_counts.mutex);
+        if (accepted >= _bal_countof(clients))
+            break;
+        bal_sleep_msec(50);
+    }
+
+    TEST_MSG("accepted: %zu, on a foreign reactor or slab: %zu", accepted, mismatched);
+    _bal_eqland(pass, _bal_countof(clients) == accepted && 0 == mismatched);
+
+    TEST_MSG_0("closing and destroying sockets...");
+    for (size_t n = 0; n < _bal_countof(clients); n++) {
+        if (NULL != clients[n])
+            _bal_eqland(pass, bal_close(&clients[n], true));
+    }
+    for (size_t n = 0; n < _bal_countof(listeners); n++) {
+        if (NULL != listeners[n]) {
+            _bal_eqland(pass, bal_async_poll(listeners[n], NULL, 0U));
+            _bal_eqland(pass, bal_close(&listeners[n], true));
+        }
+    }
+    _bal_print_err(pass, false);
+#else
+    /* SO_REUSEPORT is unavailable, so bal_listen_sharded must say so. */
+    _bal_eqland(pass, !sharded);
+    _bal_print_err(pass, true);
+#endif
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_eqland(pass, _bal_mutex_destroy(&shard_counts.mutex));
+    _bal_eqland(pass, bal_set_reactor_count(1));
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_readiness(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6972"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6972"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_print_err(pass, false);
+
+    if (pass) {
+#if !defined(__WIN__)
+        /* select() can't represent descriptors at or above FD_SETSIZE. */
+        int high = dup2(server->sd, FD_SETSIZE + 500);
+        if (-1 != high) {
+            TEST_MSG("moved accepted socket to descriptor %d", high);
+            (void)close(server->sd);
+            server->sd = high;
+        }
+#endif
+        TEST_MSG_0("ensuring an idle connection is writable but not readable...");
+        _bal_eqland(pass, !bal_is_readable(server));
+        _bal_eqland(pass, bal_is_writable(server));
+
+        TEST_MSG_0("sending data and checking readiness in one batch...");
+        static const char msg[] = "ping";
+        _bal_eqland(pass, (ssize_t)sizeof(msg) == bal_send(client, msg, sizeof(msg), 0));
+
+        bal_socket* socks[3] = {server, client, NULL};
+        uint32_t ready[3]    = {BAL_EVT_READ, BAL_EVT_READ, BAL_EVT_READ};
+        ssize_t count = bal_check_readiness(socks, ready, _bal_countof(socks), 1000);
+        TEST_MSG("ready: %zd (%08"PRIx32", %08"PRIx32", %08"PRIx32")", count, ready[0],
+            ready[1], ready[2]);
+        _bal_eqland(pass, 1 == count);
+        _bal_eqland(pass, bal_isbitset(ready[0], BAL_EVT_READ));
+        _bal_eqland(pass, 0U == ready[1] && 0U == ready[2]);
+        _bal_eqland(pass, bal_is_readable(server));
+        _bal_print_err(pass, false);
+    }
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static void io_stats_cb(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[64];
+        while (bal_recv(s, buf, sizeof(buf), 0) > 0)
+            ;
+    }
+}
+
+bool baltest_io_stats(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6973"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6973"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &io_stats_cb, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    static const char msg[] = "0123456789abcdef";
+    bal_socket_stats ss     = {0};
+    if (pass) {
+        TEST_MSG_0("sending data and waiting for the reactor to read it...");
+        _bal_eqland(pass, (ssize_t)sizeof(msg) == bal_send(client, msg, sizeof(msg), 0));
+
+        for (int wait = 0; wait < 100; wait++) {
+            _bal_eqland(pass, bal_get_socket_stats(server, &ss));
+            if (ss.bytes_recvd >= sizeof(msg) && ss.eagains > 0)
+                break;
+            bal_sleep_msec(20);
+        }
+
+        TEST_MSG("server: recvd %"PRIu64", syscalls %"PRIu64", EAGAINs %"PRIu64
+            ", read events %"PRIu64, ss.bytes_recvd, ss.syscalls, ss.eagains,
+            ss.events[0]);
+        _bal_eqland(pass, sizeof(msg) == ss.bytes_recvd && ss.eagains > 0);
+        _bal_eqland(pass, ss.events[0] > 0 && ss.syscalls >= 2);
+
+        bal_socket_stats cs = {0};
+        _bal_eqland(pass, bal_get_socket_stats(client, &cs));
+        _bal_eqland(pass, sizeof(msg) == cs.bytes_sent && 1 == cs.syscalls);
+
+        bal_stats gs = {0};
+        _bal_eqland(pass, bal_get_stats(&gs));
+        TEST_MSG("reactors %zu, iterations %"PRIu64", wakeups %"PRIu64", sockets %"
+            PRIu64, gs.reactors, gs.total.iterations, gs.total.wakeups,
+            gs.total.sockets);
+        _bal_eqland(pass, 1 == gs.reactors && gs.total.wakeups > 0);
+        _bal_eqland(pass, 1 == gs.total.sockets && gs.total.peak_sockets >= 1);
+        _bal_eqland(pass, gs.total.io.bytes_recvd == ss.bytes_recvd);
+        _bal_print_err(pass, false);
+    }
+
+    TEST_MSG_0("ensuring destroyed sockets are kept in the totals...");
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    bal_stats after = {0};
+    _bal_eqland(pass, bal_get_stats(&after));
+    _bal_eqland(pass, 0 == after.total.sockets);
+    _bal_eqland(pass, after.total.io.bytes_recvd == ss.bytes_recvd);
+    _bal_eqland(pass, after.total.io.bytes_sent == sizeof(msg));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_loop_histograms(void)
+{
+    TEST_MSG_0("checking histogram percentiles...");
+    static bal_histogram h = {0};
+    bool pass = 0ULL == bal_histogram_percentile(&h, 50.0);
+
+    for (uint64_t v = 1ULL; v <= 1000ULL; v++) {
+        h.buckets[_bal_hist_index(v * 1000ULL)]++;
+        h.sum += v * 1000ULL;
+    }
+    h.count = 1000ULL;
+    h.min   = 1000ULL;
+    h.max   = 1000000ULL;
+
+    for (double pct = 10.0; pct < 100.0; pct += 10.0) {
+        uint64_t exact = (uint64_t)(pct * 10.0) * 1000ULL;
+        uint64_t value = bal_histogram_percentile(&h, pct);
+        TEST_MSG("p%.0f: %"PRIu64" (exact: %"PRIu64")", pct, value, exact);
+        _bal_eqland(pass, value >= exact && value - exact <= exact / 8ULL);
+    }
+    _bal_eqland(pass, h.min == bal_histogram_percentile(&h, 0.0));
+    _bal_eqland(pass, h.max == bal_histogram_percentile(&h, 100.0));
+    _bal_eqland(pass, h.max == bal_histogram_percentile(&h, 99.99));
+    _bal_eqland(pass, BAL_HIST_BUCKETS - 1 == _bal_hist_index(UINT64_MAX));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("initializing library with histograms enabled...");
+    _bal_eqland(pass, bal_set_histograms(true));
+    _bal_eqland(pass, bal_init());
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("exchanging data over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6974"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6974"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &io_stats_cb, BAL_EVT_READ));
+
+    static const char msg[] = "histogram";
+    static bal_loop_histograms lh = {0};
+    for (int n = 0; pass && n < 10; n++) {
+        _bal_eqland(pass, (ssize_t)sizeof(msg) == bal_send(client, msg, sizeof(msg), 0));
+        bal_sleep_msec(20);
+    }
+
+    /* reads may coalesce, so wait for the data rather than a callback count. */
+    bal_socket_stats ss = {0};
+    for (int wait = 0; pass && wait < 50; wait++) {
+        _bal_eqland(pass, bal_get_socket_stats(server, &ss));
+        _bal_eqland(pass, bal_get_histograms(&lh, false));
+        if (ss.bytes_recvd == 10ULL * sizeof(msg) && lh.loop_lag.count > 0ULL)
+            break;
+        bal_sleep_msec(20);
+    }
+
+    TEST_MSG("poll wait: %"PRIu64" samples, p50 %"PRIu64" ns; read callbacks: %"
+        PRIu64", p99 %"PRIu64" ns; dispatch delay p99 %"PRIu64" ns; loop lag"
+        " p99 %"PRIu64" ns", lh.poll_wait.count, bal_histogram_percentile(
+        &lh.poll_wait, 50.0), lh.callback[0].count, bal_histogram_percentile(
+        &lh.callback[0], 99.0), bal_histogram_percentile(&lh.dispatch_delay, 99.0),
+        bal_histogram_percentile(&lh.loop_lag, 99.0));
+    _bal_eqland(pass, lh.callback[0].count > 0ULL && lh.poll_wait.count > 0ULL);
+    _bal_eqland(pass, lh.callback[0].count == ss.events[0]);
+    _bal_eqland(pass, lh.dispatch_delay.count == lh.callback[0].count);
+    _bal_eqland(pass, lh.loop_lag.count > 0ULL);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("resetting and disabling histograms...");
+    _bal_eqland(pass, bal_set_histograms(false));
+    _bal_eqland(pass, bal_get_histograms(&lh, true));
+    bal_sleep_msec(20);
+    _bal_eqland(pass, bal_get_reactor_histograms(0, &lh, false));
+    _bal_eqland(pass, 0ULL == lh.poll_wait.count && 0ULL == lh.callback[0].count);
+    _bal_eqland(pass, !bal_get_reactor_histograms(1, &lh, false));
+    _bal_print_err(pass, false);
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static void async_connect_cb(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_CONNECT))
+        s->user_data = BAL_EVT_CONNECT;
+    else if (bal_isbitset(events, BAL_EVT_CONNFAIL))
+        s->user_data = BAL_EVT_CONNFAIL;
+}
+
+bool baltest_async_connect(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6975"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+
+    TEST_MSG_0("registering a client socket before it connects...");
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_async_poll(client, &async_connect_cb,
+        BAL_EVT_CONNECT | BAL_EVT_CONNFAIL));
+    _bal_print_err(pass, false);
+
+    /* give the events thread time to poll the unconnected socket, which
+     * reports a hang-up on some platforms. */
+    bal_sleep_msec(300);
+
+    TEST_MSG_0("connecting, and waiting for the connect event...");
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6975"));
+
+    for (int wait = 0; pass && wait < 100 && 0U == client->user_data; wait++)
+        bal_sleep_msec(20);
+
+    TEST_MSG("user_data: %"PRIxPTR" (expected: %x)", client->user_data,
+        BAL_EVT_CONNECT);
+    _bal_eqland(pass, BAL_EVT_CONNECT == client->user_data);
+    _bal_print_err(pass, false);
+
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static void registration_cb(bal_socket* s, uint32_t events)
+{
+    s->user_data |= events;
+}
+
+bool baltest_registration(void)
+{
+    TEST_MSG_0("initializing library with 2 reactors...");
+    bool pass = bal_set_reactor_count(2);
+    _bal_eqland(pass, bal_init());
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring only new stream sockets are idle...");
+    bal_socket* stream = NULL;
+    bal_socket* dgram  = NULL;
+    _bal_eqland(pass, bal_create(&stream, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_create(&dgram, 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    _bal_eqland(pass, bal_isbitset(stream->state.bits, BAL_S_IDLE));
+    _bal_eqland(pass, !bal_isbitset(dgram->state.bits, BAL_S_IDLE));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("registering the idle socket, and polling past it...");
+    _bal_eqland(pass, bal_async_poll(stream, &registration_cb, BAL_EVT_ALL));
+    uint64_t first = pass ? stream->state.reg : 0ULL;
+    _bal_eqland(pass, 0ULL != first);
+
+    /* unconnected stream sockets report a hang-up on some platforms; the
+     * events thread must not poll this one yet. */
+    bal_sleep_msec(600);
+
+    bal_stats st = {0};
+    _bal_eqland(pass, bal_get_stats(&st));
+    TEST_MSG("events: %08"PRIxPTR", registered: %"PRIu64, stream->user_data,
+        st.total.sockets);
+    _bal_eqland(pass, 0U == stream->user_data && 1ULL == st.total.sockets);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring each registration gets a new number...");
+    _bal_eqland(pass, bal_async_poll(stream, &registration_cb, BAL_EVT_READ));
+    _bal_eqland(pass, first == stream->state.reg);
+    _bal_eqland(pass, bal_async_poll(stream, NULL, 0U));
+    _bal_eqland(pass, bal_async_poll(stream, &registration_cb, BAL_EVT_READ));
+    _bal_eqland(pass, first < stream->state.reg);
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring listening ends idleness...");
+    _bal_eqland(pass, bal_listen(stream, SOMAXCONN));
+    _bal_eqland(pass, !bal_isbitset(stream->state.bits, BAL_S_IDLE));
+    _bal_print_err(pass, false);
+
+    /* each reactor has had one socket, but never at the same time. */
+    TEST_MSG_0("ensuring the peak is library-wide, not a sum of peaks...");
+    _bal_eqland(pass, bal_async_poll(stream, NULL, 0U));
+    _bal_eqland(pass, bal_set_reactor(dgram, pass ? 1U - stream->state.reactor : 0U));
+    _bal_eqland(pass, bal_async_poll(dgram, &registration_cb, BAL_EVT_READ));
+    bal_sleep_msec(600);
+
+    _bal_eqland(pass, bal_get_stats(&st));
+    TEST_MSG("registered: %"PRIu64", peak: %"PRIu64, st.total.sockets,
+        st.total.peak_sockets);
+    _bal_eqland(pass, 1ULL == st.total.sockets && 1ULL == st.total.peak_sockets);
+    _bal_print_err(pass, false);
+
+    if (NULL != dgram)
+        _bal_eqland(pass, bal_async_poll(dgram, NULL, 0U));
+    if (NULL != stream)
+        _bal_eqland(pass, bal_close(&stream, true));
+    if (NULL != dgram)
+        _bal_eqland(pass, bal_close(&dgram, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_eqland(pass, bal_set_reactor_count(1));
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Size of the large buffer queued by the send-async test. */
+#define SEND_ASYNC_BYTES (4U * 1024U * 1024U)
+
+static int send_async_frees;
+
+static void send_async_free(void* data)
+{
+    send_async_frees++;
+    free(data);
+}
+
+static void send_async_cb(bal_socket* s, uint32_t events)
+{
+    /* counts write events reaching the callback; the queue's own write
+     * interest must not produce any. */
+    if (bal_isbitset(events, BAL_EVT_WRITE))
+        s->user_data++;
+}
+
+bool baltest_send_async(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6977"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6977"));
+    _bal_eqland(pass, bal_set_recv_timeout(client, 5, 0));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &send_async_cb, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    uint8_t* big = malloc(SEND_ASYNC_BYTES);
+    _bal_eqland(pass, NULL != big);
+
+    if (pass) {
+        for (size_t n = 0; n < SEND_ASYNC_BYTES; n++)
+            big[n] = (uint8_t)(n % 251U);
+
+        TEST_MSG_0("queueing more than the socket will take, then a copied buffer...");
+        send_async_frees = 0;
+        _bal_eqland(pass, bal_send_async(server, big, SEND_ASYNC_BYTES, &send_async_free));
+
+        char tail[] = "end of stream";
+        _bal_eqland(pass, bal_send_async(server, tail, sizeof(tail), NULL));
+        memset(tail, 0, sizeof(tail));
+
+        size_t pending = bal_get_send_pending(server);
+        TEST_MSG("pending: %zu bytes", pending);
+        _bal_eqland(pass, pending > 0U && pending <= SEND_ASYNC_BYTES + sizeof(tail));
+        _bal_eqland(pass, bal_isbitset(server->state.mask, BAL_EVT_WRITE));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("receiving everything in order...");
+        uint8_t buf[65536];
+        size_t total = 0;
+        char got_tail[sizeof(tail)] = {0};
+        while (pass && total < SEND_ASYNC_BYTES + sizeof(tail)) {
+            ssize_t read = bal_recv(client, buf, sizeof(buf), 0);
+            _bal_eqland(pass, read > 0);
+            for (ssize_t n = 0; pass && n < read; n++, total++) {
+                if (total < SEND_ASYNC_BYTES)
+                    _bal_eqland(pass, buf[n] == (uint8_t)(total % 251U));
+                else
+                    got_tail[total - SEND_ASYNC_BYTES] = (char)buf[n];
+            }
+        }
+
+        TEST_MSG("received %zu bytes; tail: '%s'", total, got_tail);
+        _bal_eqland(pass, 0 == strcmp(got_tail, "end of stream"));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring the queue drained and its write interest is gone...");
+        for (int wait = 0; wait < 100 && bal_isbitset(server->state.mask, BAL_EVT_WRITE); wait++)
+            bal_sleep_msec(20);
+
+        TEST_MSG("pending: %zu, frees: %d, write events: %"PRIuPTR,
+            bal_get_send_pending(server), send_async_frees, server->user_data);
+        _bal_eqland(pass, 0U == bal_get_send_pending(server));
+        _bal_eqland(pass, !bal_isbitset(server->state.mask, BAL_EVT_WRITE));
+        _bal_eqland(pass, 1 == send_async_frees && 0U == server->user_data);
+        _bal_print_err(pass, false);
+    } else {
+        free(big);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Size of each buffer queued by the send-watermarks test. */
+#define WATERMARK_CHUNK (1024U * 1024U)
+
+/** Number of buffers queued by the send-watermarks test. */
+#define WATERMARK_CHUNKS 8U
+
+/** The socket paused while the send-watermarks test's queue is blocked. */
+static bal_socket* watermark_peer;
+
+static void send_watermarks_cb(bal_socket* s, uint32_t events)
+{
+    /* like a relay, stop reading from the producer while the consumer is
+     * slow. */
+    if (bal_isbitset(events, BAL_EVT_WBLOCKED))
+        bal_pause_read(watermark_peer);
+    if (bal_isbitset(events, BAL_EVT_WDRAINED))
+        bal_resume_read(watermark_peer);
+
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[64];
+        while (bal_recv(s, buf, sizeof(buf), 0) > 0)
+            ;
+    }
+
+    s->user_data |= events;
+}
+
+bool baltest_send_watermarks(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6978"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6978"));
+    _bal_eqland(pass, bal_set_recv_timeout(client, 5, 0));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &send_watermarks_cb,
+        BAL_EVT_READ | BAL_EVT_WBLOCKED | BAL_EVT_WDRAINED));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring invalid watermarks are rejected...");
+    size_t high = 0;
+    size_t low  = 0;
+    _bal_eqland(pass, !bal_set_send_watermarks(server, 1024U, 1024U));
+    _bal_eqland(pass, bal_set_send_watermarks(server, 256U * 1024U, 64U * 1024U));
+    _bal_eqland(pass, bal_get_send_watermarks(server, &high, &low));
+    _bal_eqland(pass, 256U * 1024U == high && 64U * 1024U == low);
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        TEST_MSG_0("queueing past the high watermark...");
+        watermark_peer = client;
+        static uint8_t chunk[WATERMARK_CHUNK];
+        for (size_t n = 0; n < WATERMARK_CHUNK; n++)
+            chunk[n] = (uint8_t)n;
+
+        for (size_t n = 0; pass && n < WATERMARK_CHUNKS; n++)
+            _bal_eqland(pass, bal_send_async(server, chunk, WATERMARK_CHUNK, NULL));
+
+        /* the blocked event comes from the events thread. */
+        for (int wait = 0; wait < 100 && !bal_is_read_paused(client); wait++)
+            bal_sleep_msec(20);
+
+        TEST_MSG("pending: %zu bytes, events: %08"PRIxPTR", peer paused: %d",
+            bal_get_send_pending(server), server->user_data,
+            bal_is_read_paused(client));
+        _bal_eqland(pass, bal_get_send_pending(server) > high);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_WBLOCKED));
+        _bal_eqland(pass, !bal_isbitset(server->user_data, BAL_EVT_WDRAINED));
+        _bal_eqland(pass, bal_is_read_paused(client));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("draining, and waiting for the drained event...");
+        uint8_t buf[65536];
+        size_t total = 0;
+        while (pass && total < WATERMARK_CHUNK * WATERMARK_CHUNKS) {
+            ssize_t read = bal_recv(client, buf, sizeof(buf), 0);
+            _bal_eqland(pass, read > 0);
+            if (read > 0)
+                total += (size_t)read;
+        }
+
+        for (int wait = 0; wait < 100 && bal_is_read_paused(client); wait++)
+            bal_sleep_msec(20);
+
+        bal_socket_stats ss = {0};
+        _bal_eqland(pass, bal_get_socket_stats(server, &ss));
+        TEST_MSG("received %zu bytes; events: %08"PRIxPTR", blocked %"PRIu64
+            ", drained %"PRIu64, total, server->user_data, ss.events[11], ss.events[12]);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_WDRAINED));
+        _bal_eqland(pass, !bal_is_read_paused(client));
+        _bal_eqland(pass, 1U == ss.events[11] && 1U == ss.events[12]);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring a paused socket gets no read events until resumed...");
+        _bal_eqland(pass, bal_pause_read(server));
+        server->user_data = 0U;
+
+        static const char msg[] = "paused";
+        _bal_eqland(pass, (ssize_t)sizeof(msg) == bal_send(client, msg, sizeof(msg), 0));
+        bal_sleep_msec(200);
+        _bal_eqland(pass, !bal_isbitset(server->user_data, BAL_EVT_READ));
+
+        _bal_eqland(pass, bal_resume_read(server));
+        for (int wait = 0; wait < 100 && !bal_isbitset(server->user_data, BAL_EVT_READ); wait++)
+            bal_sleep_msec(20);
+        TEST_MSG("events after resuming: %08"PRIxPTR, server->user_data);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_READ));
+        _bal_print_err(pass, false);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Lines consumed by the async-recv test's handler. */
+static char async_recv_lines[1024];
+static size_t async_recv_count;
+
+static size_t async_recv_on_data(bal_socket* s, const void* data, size_t len)
+{
+    /* consume complete lines only; a partial one is passed again, with the
+     * rest of it, once that arrives. */
+    const char* p = data;
+    size_t used   = len;
+    while (used > 0 && '\n' != p[used - 1])
+        used--;
+
+    for (size_t n = 0; n < used; n++) {
+        if (async_recv_count < sizeof(async_recv_lines) - 1)
+            async_recv_lines[async_recv_count] = p[n];
+        async_recv_count++;
+    }
+
+    BAL_UNUSED(s);
+    return used;
+}
+
+static void async_recv_cb(bal_socket* s, uint32_t events)
+{
+    s->user_data |= events;
+}
+
+bool baltest_async_recv(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6979"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6979"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &async_recv_cb, BAL_EVT_READ | BAL_EVT_CLOSE));
+    _bal_eqland(pass, bal_async_recv(server, &async_recv_on_data));
+    _bal_print_err(pass, false);
+
+    bal_slab_stats before = {0};
+    _bal_eqland(pass, bal_get_recv_pool_stats(&before));
+
+    if (pass) {
+        TEST_MSG_0("sending a line and a half...");
+        memset(async_recv_lines, 0, sizeof(async_recv_lines));
+        async_recv_count = 0;
+
+        static const char first[] = "alpha\nbra";
+        _bal_eqland(pass, 9 == bal_send(client, first, 9, 0));
+        for (int wait = 0; wait < 100 && async_recv_count < 6; wait++)
+            bal_sleep_msec(20);
+
+        bal_slab_stats held = {0};
+        _bal_eqland(pass, bal_get_recv_pool_stats(&held));
+        TEST_MSG("consumed: %zu bytes, buffers in use: %zu", async_recv_count,
+            held.in_use);
+        _bal_eqland(pass, 6 == async_recv_count && before.in_use + 1 == held.in_use);
+        _bal_eqland(pass, !bal_isbitset(server->user_data, BAL_EVT_READ));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("completing it, and sending more lines than a buffer holds...");
+        static const char second[] = "vo\ncharlie\n";
+        _bal_eqland(pass, 11 == bal_send(client, second, 11, 0));
+
+        static char line[1000];
+        memset(line, 'x', sizeof(line));
+        line[sizeof(line) - 1] = '\n';
+        for (int n = 0; pass && n < 100; n++)
+            _bal_eqland(pass, (ssize_t)sizeof(line) == bal_send(client, line, sizeof(line), 0));
+
+        const size_t expected = 20 + (100 * sizeof(line));
+        for (int wait = 0; wait < 100 && async_recv_count < expected; wait++)
+            bal_sleep_msec(20);
+
+        bal_slab_stats after = {0};
+        _bal_eqland(pass, bal_get_recv_pool_stats(&after));
+        TEST_MSG("consumed: %zu bytes (expected %zu), buffers in use: %zu",
+            async_recv_count, expected, after.in_use);
+        _bal_eqland(pass, expected == async_recv_count);
+        _bal_eqland(pass, 0 == strncmp(async_recv_lines, "alpha\nbravo\ncharlie\nxxx", 23));
+        _bal_eqland(pass, before.in_use == after.in_use);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring the peer closing is reported...");
+        _bal_eqland(pass, bal_close(&client, true));
+        for (int wait = 0; wait < 100 && !bal_isbitset(server->user_data, BAL_EVT_CLOSE); wait++)
+            bal_sleep_msec(20);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_CLOSE));
+        _bal_print_err(pass, false);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Sends `len` bytes of newline-terminated lines of 'x', and waits for the
+ * async-recv handler to have consumed `total` bytes in all. */
+static bool recv_sizing_send(bal_socket* client, size_t len, size_t total)
+{
+    static uint8_t data[256 * 1024];
+    BAL_ASSERT(len <= sizeof(data));
+
+    memset(data, 'x', len);
+    for (size_t n = 999; n < len; n += 1000)
+        data[n] = '\n';
+    data[len - 1] = '\n';
+
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t res = bal_send(client, data + sent, (bal_iolen)(len - sent), 0);
+        if (res <= 0)
+            return false;
+        sent += (size_t)res;
+    }
+
+    for (int wait = 0; wait < 100 && async_recv_count < total; wait++)
+        bal_sleep_msec(20);
+
+    return total == async_recv_count;
+}
+
+bool baltest_recv_sizing(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6981"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6981"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &async_recv_cb, BAL_EVT_READ | BAL_EVT_CLOSE));
+    _bal_eqland(pass, bal_async_recv(server, &async_recv_on_data));
+    _bal_print_err(pass, false);
+
+    bal_slab_stats base = {0};
+    _bal_eqland(pass, bal_get_recv_pool_stats(&base));
+    async_recv_count = 0;
+    size_t total     = 0;
+
+    if (pass) {
+        TEST_MSG_0("sending small messages...");
+        for (int n = 0; pass && n < 3; n++)
+            _bal_eqland(pass, recv_sizing_send(client, 100, total += 100));
+
+        bal_slab_stats ps = {0};
+        _bal_eqland(pass, bal_get_recv_pool_stats(&ps));
+        TEST_MSG("size class: %zu, buffers in use: %zu", server->state.recvb.want_cls,
+            ps.in_use);
+        _bal_eqland(pass, 0U == server->state.recvb.want_cls && base.in_use == ps.in_use);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("sending a burst, and a line only the biggest buffer holds...");
+        _bal_eqland(pass, recv_sizing_send(client, 200U * 1024U, total += 200U * 1024U));
+        size_t grown = server->state.recvb.want_cls;
+        TEST_MSG("size class after the burst: %zu", grown);
+        _bal_eqland(pass, grown > 0U);
+
+        /* the handler consumes whole lines only, so the buffer has to grow to
+         * hold this one; it fits the biggest class. */
+        _bal_eqland(pass, recv_sizing_send(client, BAL_RECV_BUF_MAX - 1000U,
+            total += BAL_RECV_BUF_MAX - 1000U));
+        _bal_eqland(pass, !bal_isbitset(server->user_data, BAL_EVT_ERROR));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring small messages shrink the size class again...");
+        grown = server->state.recvb.want_cls;
+        for (int n = 0; pass && n < 4; n++)
+            _bal_eqland(pass, recv_sizing_send(client, 100, total += 100));
+        TEST_MSG("size class: %zu (was %zu)", server->state.recvb.want_cls, grown);
+        _bal_eqland(pass, server->state.recvb.want_cls + 2U == grown);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring idle buffers are kept, then reclaimed...");
+        _bal_eqland(pass, bal_set_recv_idle_reclaim(200));
+        _bal_eqland(pass, 200 == bal_get_recv_idle_reclaim());
+        _bal_eqland(pass, recv_sizing_send(client, 100, total += 100));
+        _bal_eqland(pass, bal_get_recv_pool_stats(&ps));
+        TEST_MSG("buffers in use after reading: %zu", ps.in_use);
+        _bal_eqland(pass, base.in_use + 1U == ps.in_use);
+
+        for (int wait = 0; wait < 100 && ps.in_use > base.in_use; wait++) {
+            bal_sleep_msec(20);
+            _bal_eqland(pass, bal_get_recv_pool_stats(&ps));
+        }
+        TEST_MSG("buffers in use after idling: %zu", ps.in_use);
+        _bal_eqland(pass, base.in_use == ps.in_use);
+        _bal_eqland(pass, bal_set_recv_idle_reclaim(0));
+        _bal_print_err(pass, false);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Frames (and payload bytes) delivered to the framing test's handler, and
+ * how many of them didn't hold the expected bytes. */
+static size_t framing_count;
+static size_t framing_bytes;
+static size_t framing_bad;
+
+/** Fills a framing test payload with a pattern that depends on its length. */
+static void framing_fill(uint8_t* data, size_t len)
+{
+    for (size_t n = 0; n < len; n++)
+        data[n] = (uint8_t)(n * 7U + len);
+}
+
+static void framing_on_frame(bal_socket* s, const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    for (size_t n = 0; n < len; n++) {
+        if ((uint8_t)(n * 7U + len) != p[n]) {
+            framing_bad++;
+            break;
+        }
+    }
+
+    framing_count++;
+    framing_bytes += len;
+    BAL_UNUSED(s);
+}
+
+/** Waits for the framing test's handler to have received `count` frames. */
+static bool framing_wait(size_t count)
+{
+    for (int wait = 0; wait < 100 && framing_count < count; wait++)
+        bal_sleep_msec(20);
+
+    return count == framing_count && 0U == framing_bad;
+}
+
+bool baltest_framing(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("checking CRC32C against its known answer...");
+    uint32_t crc = bal_crc32c(0U, "123456789", 9);
+    TEST_MSG("CRC32C(\"123456789\"): 0x%08x", crc);
+    _bal_eqland(pass, 0xe3069283U == crc);
+    _bal_eqland(pass, crc == bal_crc32c(bal_crc32c(0U, "1234", 4), "56789", 5));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6982"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6982"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("ensuring frames can't be received without a format...");
+    _bal_eqland(pass, !bal_async_frames(server, &framing_on_frame));
+    bal_framing bad = {3, 0, 0};
+    _bal_eqland(pass, !bal_set_framing(server, &bad));
+
+    bal_framing framing = {4, 0, BAL_FRAME_BIG_ENDIAN | BAL_FRAME_CRC32C};
+    _bal_eqland(pass, bal_set_framing(client, &framing));
+    _bal_eqland(pass, bal_set_framing(server, &framing));
+    _bal_eqland(pass, bal_async_poll(client, &async_recv_cb, BAL_EVT_CLOSE));
+    _bal_eqland(pass, bal_async_poll(server, &async_recv_cb,
+        BAL_EVT_READ | BAL_EVT_CLOSE | BAL_EVT_ERROR));
+    _bal_eqland(pass, bal_async_frames(server, &framing_on_frame));
+    _bal_print_err(pass, false);
+
+    framing_count = framing_bytes = framing_bad = 0;
+
+    if (pass) {
+        TEST_MSG_0("sending frames of several sizes...");
+        static uint8_t data[100U * 1024U];
+        static const size_t sizes[] = {0U, 1U, 100U, 5000U, sizeof(data)};
+        size_t bytes = 0U;
+        for (size_t n = 0; pass && n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+            framing_fill(data, sizes[n]);
+            _bal_eqland(pass, bal_send_frame(client, data, sizes[n]));
+            bytes += sizes[n];
+        }
+
+        _bal_eqland(pass, framing_wait(sizeof(sizes) / sizeof(sizes[0])));
+        TEST_MSG("frames: %zu, bytes: %zu (expected %zu), bad: %zu", framing_count,
+            framing_bytes, bytes, framing_bad);
+        _bal_eqland(pass, bytes == framing_bytes);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("sending a frame a few bytes at a time...");
+        uint8_t frame[4 + 32 + 4];
+        framing_fill(frame + 4, 32);
+        _bal_frame_put_uint(frame, 4, true, 32);
+        _bal_frame_put_uint(frame + 36, 4, true, bal_crc32c(0U, frame + 4, 32));
+
+        size_t before = framing_count;
+        _bal_eqland(pass, 3 == bal_send(client, frame, 3, 0));
+        bal_sleep_msec(50);
+        _bal_eqland(pass, 20 == bal_send(client, frame + 3, 20, 0));
+        bal_sleep_msec(50);
+        _bal_eqland(pass, before == framing_count);
+        _bal_eqland(pass, 17 == bal_send(client, frame + 23, 17, 0));
+        _bal_eqland(pass, framing_wait(before + 1U));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring a bad CRC is reported as an error...");
+        frame[36] ^= 0xffU;
+        _bal_eqland(pass, (ssize_t)sizeof(frame) == bal_send(client, frame, sizeof(frame), 0));
+        for (int wait = 0; wait < 100 && !bal_isbitset(server->user_data, BAL_EVT_ERROR); wait++)
+            bal_sleep_msec(20);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_ERROR));
+        _bal_eqland(pass, before + 1U == framing_count);
+        _bal_eqland(pass, bal_is_read_paused(server));
+        _bal_print_err(pass, false);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Lines delivered to the async-lines test's handler, each followed by '|'. */
+static char async_lines_buf[256];
+static size_t async_lines_count;
+static size_t async_lines_longest;
+
+static void async_lines_on_line(bal_socket* s, const void* data, size_t len)
+{
+    size_t have = strlen(async_lines_buf);
+    if (len < 64 && have + len + 1 < sizeof(async_lines_buf)) {
+        memcpy(async_lines_buf + have, data, len);
+        async_lines_buf[have + len] = '|';
+    }
+
+    if (len > async_lines_longest)
+        async_lines_longest = len;
+    async_lines_count++;
+    BAL_UNUSED(s);
+}
+
+/** Waits for the async-lines test's handler to have received `count` lines. */
+static bool async_lines_wait(size_t count)
+{
+    for (int wait = 0; wait < 100 && async_lines_count < count; wait++)
+        bal_sleep_msec(20);
+
+    return count == async_lines_count;
+}
+
+bool baltest_async_lines(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("comparing the delimiter search against memchr...");
+    static uint8_t hay[300];
+    memset(hay, 'a', sizeof(hay));
+    for (size_t off = 0; pass && off < 64; off++) {
+        for (size_t len = 0; pass && off + len <= sizeof(hay) && len < 200; len++) {
+            for (size_t at = 0; pass && at <= len; at += 1 + at / 4) {
+                if (at < len)
+                    hay[off + at] = '\n';
+
+                const uint8_t* hit = memchr(hay + off, '\n', len);
+                size_t expected    = NULL != hit ? (size_t)(hit - (hay + off)) : len;
+                _bal_eqland(pass, expected == _bal_find_delim(hay + off, len, '\n', true));
+                _bal_eqland(pass, expected == _bal_find_delim(hay + off, len, '\n', false));
+
+                if (at < len)
+                    hay[off + at] = 'a';
+            }
+        }
+    }
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6983"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6983"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &async_recv_cb,
+        BAL_EVT_READ | BAL_EVT_CLOSE | BAL_EVT_ERROR));
+    _bal_eqland(pass, bal_async_lines(server, &async_lines_on_line, '\n', BAL_LINE_CRLF));
+    _bal_print_err(pass, false);
+
+    memset(async_lines_buf, 0, sizeof(async_lines_buf));
+    async_lines_count = async_lines_longest = 0;
+
+    if (pass) {
+        TEST_MSG_0("sending CRLF-delimited lines, split across sends...");
+        static const char first[] = "GET / HTTP/1.1\r\nHost: loc";
+        static const char second[] = "alhost\r\n\r\nbare\n";
+        _bal_eqland(pass, sizeof(first) - 1 == (size_t)bal_send(client, first,
+            sizeof(first) - 1, 0));
+        _bal_eqland(pass, async_lines_wait(1));
+        _bal_eqland(pass, sizeof(second) - 1 == (size_t)bal_send(client, second,
+            sizeof(second) - 1, 0));
+        _bal_eqland(pass, async_lines_wait(4));
+        TEST_MSG("lines: %zu ('%s')", async_lines_count, async_lines_buf);
+        _bal_eqland(pass, 0 == strcmp(async_lines_buf, "GET / HTTP/1.1|Host: localhost||bare|"));
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("sending a long line a piece at a time...");
+        static char line[20000];
+        memset(line, 'x', sizeof(line));
+        for (size_t n = 0; pass && n < sizeof(line); n += 5000) {
+            _bal_eqland(pass, 5000 == bal_send(client, line + n, 5000, 0));
+            bal_sleep_msec(10);
+        }
+        _bal_eqland(pass, 1 == bal_send(client, "\n", 1, 0));
+        _bal_eqland(pass, async_lines_wait(5));
+        TEST_MSG("longest line: %zu bytes", async_lines_longest);
+        _bal_eqland(pass, sizeof(line) == async_lines_longest);
+        _bal_print_err(pass, false);
+
+        TEST_MSG_0("ensuring a line too long to buffer is reported as an error...");
+        for (size_t n = 0; pass && n < BAL_RECV_BUF_MAX; n += sizeof(line)) {
+            size_t len = BAL_RECV_BUF_MAX - n < sizeof(line) ? BAL_RECV_BUF_MAX - n : sizeof(line);
+            _bal_eqland(pass, (ssize_t)len == bal_send(client, line, (bal_iolen)len, 0));
+        }
+        for (int wait = 0; wait < 100 && !bal_isbitset(server->user_data, BAL_EVT_ERROR); wait++)
+            bal_sleep_msec(20);
+        _bal_eqland(pass, bal_isbitset(server->user_data, BAL_EVT_ERROR));
+        _bal_eqland(pass, 5 == async_lines_count && bal_is_read_paused(server));
+        _bal_print_err(pass, false);
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Sockets registered and unregistered by the perf-register test. */
+#define PERF_REGISTER_SOCKETS 10000
+
+/** Times each perf-register measurement is repeated (the median is used). */
+#define PERF_REGISTER_SAMPLES 5
+
+static bool sendv_recv_all(bal_socket* s, char* buf, size_t len)
+{
+    size_t received = 0;
+    while (received < len) {
+        ssize_t read = bal_recv(s, buf + received, len - received, 0);
+        if (read <= 0)
+            return false;
+        received += (size_t)read;
+    }
+
+    return true;
+}
+
+bool baltest_sendv(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6987"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6987"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        TEST_MSG_0("sending three buffers with one call...");
+        static const char header[] = "HTTP/1.1 200 OK\r\n\r\n";
+        static const char body[]   = "hello, ";
+        static const char tail[]   = "world";
+        bal_iovec iov[3];
+        bal_setiovec(&iov[0], header, sizeof(header) - 1);
+        bal_setiovec(&iov[1], body, sizeof(body) - 1);
+        bal_setiovec(&iov[2], tail, sizeof(tail) - 1);
+
+        const size_t total = sizeof(header) + sizeof(body) + sizeof(tail) - 3;
+        char buf[64] = {0};
+        _bal_eqland(pass, (ssize_t)total == bal_sendv(client, iov, 3, MSG_NOSIGNAL));
+        _bal_eqland(pass, sendv_recv_all(server, buf, total));
+        _bal_eqland(pass, 0 == strcmp(buf, "HTTP/1.1 200 OK\r\n\r\nhello, world"));
+
+        bal_socket_stats stats = {0};
+        _bal_eqland(pass, bal_get_socket_stats(client, &stats));
+        _bal_eqland(pass, 1U == stats.syscalls && total == stats.bytes_sent);
+        _bal_print_err(pass, false);
+
+        TEST_MSG("sending %d one-byte buffers...", BAL_IOV_MAX + 100);
+        static bal_iovec many[BAL_IOV_MAX + 100];
+        static char many_buf[BAL_IOV_MAX + 100];
+        for (size_t n = 0; n < _bal_countof(many); n++)
+            bal_setiovec(&many[n], "x", 1);
+        _bal_eqland(pass, BAL_IOV_MAX == bal_sendv(client, many, _bal_countof(many),
+            MSG_NOSIGNAL));
+        _bal_eqland(pass, sendv_recv_all(server, many_buf, BAL_IOV_MAX));
+
+        TEST_MSG_0("ensuring an empty array is rejected...");
+        _bal_eqland(pass, -1 == bal_sendv(client, many, 0, MSG_NOSIGNAL));
+    }
+
+    TEST_MSG_0("closing and destroying sockets...");
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+static size_t destroy_handler_runs = 0;
+static uint32_t destroy_events     = 0U;
+
+static void destroy_cb(bal_socket* s, uint32_t events)
+{
+    BAL_UNUSED(s);
+    destroy_events |= events;
+}
+
+static size_t destroy_on_data(bal_socket* s, const void* data, size_t len)
+{
+    BAL_UNUSED(data);
+    destroy_handler_runs++;
+    (void)bal_close(&s, true);
+    return len;
+}
+
+static bool destroy_enable_recv(bal_socket* s)
+{
+    return bal_async_recv(s, &destroy_on_data);
+}
+
+static void destroy_on_frame(bal_socket* s, const void* frame, size_t len)
+{
+    BAL_UNUSED(frame);
+    BAL_UNUSED(len);
+    destroy_handler_runs++;
+    (void)bal_close(&s, true);
+}
+
+static bool destroy_enable_frames(bal_socket* s)
+{
+    bal_framing framing = {4, 0, BAL_FRAME_BIG_ENDIAN};
+    return bal_set_framing(s, &framing) && bal_async_frames(s, &destroy_on_frame);
+}
+
+static bool destroy_enable_lines(bal_socket* s)
+{
+    return bal_async_lines(s, &destroy_on_frame, '\n', 0U);
+}
+
+/** Accepts a connection, has `enable` install a handler on the server end that
+ * closes and destroys it, then sends `len` bytes of `data` and checks that the
+ * socket (and its receive buffer) was freed once, with no events after. */
+static bool destroy_in_handler_round(bal_socket* listener, bool (*enable)(bal_socket*),
+    const void* data, size_t len)
+{
+    bal_socket* client = NULL;
+    bal_socket* server = NULL;
+    bal_sockaddr addr  = {0};
+    bool pass = bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6989"));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_print_err(pass, false);
+
+    bal_slab_stats socks_before = {0};
+    bal_slab_stats bufs_before  = {0};
+    _bal_eqland(pass, bal_get_slab_stats(&socks_before));
+    _bal_eqland(pass, bal_get_recv_pool_stats(&bufs_before));
+
+    destroy_handler_runs = 0;
+    destroy_events       = 0U;
+    _bal_eqland(pass, bal_async_poll(server, &destroy_cb, BAL_EVT_READ | BAL_EVT_CLOSE));
+    _bal_eqland(pass, enable(server));
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        /* the peer may be gone before all of it is sent. */
+        (void)bal_send(client, data, (bal_iolen)len, MSG_NOSIGNAL);
+        for (int wait = 0; wait < 100 && 0 == destroy_handler_runs; wait++)
+            bal_sleep_msec(20);
+        bal_sleep_msec(100);
+
+        bal_slab_stats socks_after = {0};
+        bal_slab_stats bufs_after  = {0};
+        _bal_eqland(pass, bal_get_slab_stats(&socks_after));
+        _bal_eqland(pass, bal_get_recv_pool_stats(&bufs_after));
+        TEST_MSG("handler runs: %zu, sockets in use: %zu -> %zu, buffers in use:"
+            " %zu -> %zu", destroy_handler_runs, socks_before.in_use,
+            socks_after.in_use, bufs_before.in_use, bufs_after.in_use);
+        _bal_eqland(pass, 1U == destroy_handler_runs && 0U == destroy_events);
+        _bal_eqland(pass, socks_before.in_use - 1U == socks_after.in_use);
+        _bal_eqland(pass, bufs_before.in_use == bufs_after.in_use);
+    }
+
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+
+    return pass;
+}
+
+bool baltest_destroy_in_handler(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    bal_socket* listener = NULL;
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6989"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_print_err(pass, false);
+
+    /* more than fits in the first receive buffer, so the read loop would go
+     * on after the handler returns. */
+    static char data[64 * 1024];
+    memset(data, 'x', sizeof(data));
+
+    if (pass) {
+        TEST_MSG_0("destroying a socket from its bal_async_recv handler...");
+        _bal_eqland(pass, destroy_in_handler_round(listener, &destroy_enable_recv,
+            data, sizeof(data)));
+
+        /* 1 KiB frames: length prefix, then payload. */
+        for (size_t n = 0; n < sizeof(data); n += 1024U) {
+            memset(data + n, 0, 4);
+            data[n + 2] = (char)(1020U >> 8);
+            data[n + 3] = (char)(1020U & 0xffU);
+        }
+
+        TEST_MSG_0("destroying a socket from its bal_async_frames handler...");
+        _bal_eqland(pass, destroy_in_handler_round(listener, &destroy_enable_frames,
+            data, sizeof(data)));
+
+        /* 1 KiB lines. */
+        memset(data, 'x', sizeof(data));
+        for (size_t n = 1023U; n < sizeof(data); n += 1024U)
+            data[n] = '\n';
+
+        TEST_MSG_0("destroying a socket from its bal_async_lines handler...");
+        _bal_eqland(pass, destroy_in_handler_round(listener, &destroy_enable_lines,
+            data, sizeof(data)));
+    }
+
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+bool baltest_perf_register(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+#if !defined(__WIN__)
+    /* every socket needs a descriptor; raise the soft limit if need be. */
+    struct rlimit lim = {0};
+    rlim_t needed     = PERF_REGISTER_SOCKETS + 64;
+    if (0 == getrlimit(RLIMIT_NOFILE, &lim) && lim.rlim_cur < needed &&
+        (RLIM_INFINITY == lim.rlim_max || lim.rlim_max >= needed)) {
+        lim.rlim_cur = needed;
+        (void)setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    if (0 != getrlimit(RLIMIT_NOFILE, &lim) || lim.rlim_cur < needed) {
+        TEST_MSG("skipping: %d sockets need a higher descriptor limit (ulimit -n)",
+            PERF_REGISTER_SOCKETS);
+        _bal_eqland(pass, bal_cleanup());
+        return pass;
+    }
+#endif
+
+    TEST_MSG("creating %d sockets...", PERF_REGISTER_SOCKETS);
+    bal_socket** socks = calloc(PERF_REGISTER_SOCKETS, sizeof(bal_socket*));
+    _bal_eqland(pass, NULL != socks);
+    for (size_t n = 0; pass && n < PERF_REGISTER_SOCKETS; n++)
+        _bal_eqland(pass, bal_create(&socks[n], 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_print_err(pass, false);
+
+    double reg[PERF_REGISTER_SAMPLES]   = {0};
+    double unreg[PERF_REGISTER_SAMPLES] = {0};
+
+    for (size_t sample = 0; pass && sample < PERF_REGISTER_SAMPLES; sample++) {
+        uint64_t start = _bal_now_ns();
+        for (size_t n = 0; pass && n < PERF_REGISTER_SOCKETS; n++)
+            _bal_eqland(pass, bal_async_poll(socks[n], &_bal_async_poll_callback,
+                BAL_EVT_NORMAL));
+        uint64_t registered = _bal_now_ns();
+
+        /* unregister in a scattered order (7919 is coprime with the count),
+         * as connections in a real server close. */
+        for (size_t n = 0; pass && n < PERF_REGISTER_SOCKETS; n++)
+            _bal_eqland(pass, bal_async_poll(socks[n * 7919 % PERF_REGISTER_SOCKETS],
+                NULL, 0U));
+        uint64_t unregistered = _bal_now_ns();
+
+        reg[sample]   = (double)(registered - start) / PERF_REGISTER_SOCKETS;
+        unreg[sample] = (double)(unregistered - registered) / PERF_REGISTER_SOCKETS;
+    }
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        _bal_eqland(pass, _bal_perf_check("register-ns-per-socket",
+            _bal_perf_percentile(reg, PERF_REGISTER_SAMPLES, 50.0), "ns"));
+        _bal_eqland(pass, _bal_perf_check("unregister-ns-per-socket",
+            _bal_perf_percentile(unreg, PERF_REGISTER_SAMPLES, 50.0), "ns"));
+    }
+
+    for (size_t n = 0; NULL != socks && n < PERF_REGISTER_SOCKETS; n++) {
+        if (NULL != socks[n])
+            (void)bal_close(&socks[n], true);
+    }
+    free(socks);
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
+
+/** Round trips timed by the perf-round-trip test (after a warm-up). */
+#define PERF_ROUND_TRIPS 5000
+
+/** Size of each perf-round-trip message. */
+#define PERF_MESSAGE_SIZE 64
+
+static void perf_echo_cb(bal_socket* s, uint32_t events)
+{
+    if (bal_isbitset(events, BAL_EVT_READ)) {
+        char buf[256];
+        ssize_t read = 0;
+        while ((read = bal_recv(s, buf, sizeof(buf), 0)) > 0)
+            (void)bal_send(s, buf, (bal_iolen)read, 0);
+    }
+}
+
+bool baltest_perf_round_trip(void)
+{
+    TEST_MSG_0("initializing library...");
+    bool pass = bal_init();
+    _bal_print_err(pass, false);
+
+    TEST_MSG_0("connecting a client to an echoing reactor over loopback...");
+    bal_socket* listener = NULL;
+    bal_socket* client   = NULL;
+    bal_socket* server   = NULL;
+    bal_sockaddr addr    = {0};
+    _bal_eqland(pass, bal_create(&listener, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_set_reuseaddr(listener, 1));
+    _bal_eqland(pass, bal_bind(listener, "127.0.0.1", "6976"));
+    _bal_eqland(pass, bal_listen(listener, SOMAXCONN));
+    _bal_eqland(pass, bal_create(&client, 0, AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    _bal_eqland(pass, bal_connect(client, "127.0.0.1", "6976"));
+    _bal_eqland(pass, bal_set_recv_timeout(client, 5, 0));
+    _bal_eqland(pass, bal_accept(listener, &server, &addr));
+    _bal_eqland(pass, bal_async_poll(server, &perf_echo_cb, BAL_EVT_READ));
+    _bal_print_err(pass, false);
+
+    static double rtts[PERF_ROUND_TRIPS];
+    const int warmup = PERF_ROUND_TRIPS / 10;
+    char msg[PERF_MESSAGE_SIZE] = {0};
+
+    for (int n = -warmup; pass && n < PERF_ROUND_TRIPS; n++) {
+        uint64_t start = _bal_now_ns();
+        _bal_eqland(pass, (ssize_t)sizeof(msg) == bal_send(client, msg, sizeof(msg), 0));
+
+        size_t recvd = 0;
+        while (pass && recvd < sizeof(msg)) {
+            ssize_t read = bal_recv(client, msg + recvd, (bal_iolen)(sizeof(msg) - recvd), 0);
+            _bal_eqland(pass, read > 0);
+            recvd += pass ? (size_t)read : 0;
+        }
+
+        if (n >= 0)
+            rtts[n] = (double)(_bal_now_ns() - start) / 1e3;
+    }
+    _bal_print_err(pass, false);
+
+    if (pass) {
+        _bal_eqland(pass, _bal_perf_check("round-trip-p50-us",
+            _bal_perf_percentile(rtts, PERF_ROUND_TRIPS, 50.0), "us"));
+        _bal_eqland(pass, _bal_perf_check("round-trip-p99-us",
+            _bal_perf_percentile(rtts, PERF_ROUND_TRIPS, 99.0), "us"));
+    }
+
+    if (NULL != server)
+        _bal_eqland(pass, bal_close(&server, true));
+    if (NULL != client)
+        _bal_eqland(pass, bal_close(&client, true));
+    if (NULL != listener)
+        _bal_eqland(pass, bal_close(&listener, true));
+
+    TEST_MSG_0("cleaning up library...");
+    _bal_eqland(pass, bal_cleanup());
+    _bal_print_err(pass, false);
+
+    return pass;
+}
@@ -52,4 +52,162 @@ bool baltest_create_bind_listen_tcp(void);
  */
 bool baltest_error_sanity(void);
 
+/**
+ * @test baltest_slab_sanity
+ * Ensures that bal_socket objects are recycled through the slab allocator, with
+ * the most recently freed object being handed out first, and that the
+ * allocation counters balance.
+ */
+bool baltest_slab_sanity(void);
+
+/**
+ * @test baltest_allocator_hooks
+ * Ensures that a user-supplied allocator is used for libbal's internal heap
+ * allocations, that everything it hands out is returned to it, and that it
+ * cannot be swapped while libbal is initialized.
+ */
+bool baltest_allocator_hooks(void);
+
+/**
+ * @test baltest_accept_many
+ * Ensures that a single bal_accept_many call drains every pending connection
+ * from a non-blocking listener, that accepted sockets are non-blocking, that
+ * the registering variant adds them to the async I/O loop, and that a blocking
+ * listener yields one connection per call.
+ */
+bool baltest_accept_many(void);
+
+/**
+ * @test baltest_socket_opts
+ * Ensures that bal_create_ex creates a non-blocking socket, applies an option
+ * profile, and answers bal_get_* calls from the cached values until the option
+ * is changed through bal_set_option.
+ */
+bool baltest_socket_opts(void);
+
+/**
+ * @test baltest_listen_sharded
+ * Ensures that bal_listen_sharded creates one SO_REUSEPORT listener per reactor,
+ * and that connections accepted by each listener stay on its reactor (and are
+ * allocated from its slab).
+ */
+bool baltest_listen_sharded(void);
+
+/**
+ * @test baltest_readiness
+ * Ensures that bal_is_readable, bal_is_writable, and bal_check_readiness report
+ * the correct state, including for descriptors beyond FD_SETSIZE.
+ */
+bool baltest_readiness(void);
+
+/**
+ * @test baltest_io_stats
+ * Ensures that per-socket I/O counters and the per-reactor counters behind
+ * bal_get_stats track loopback traffic, and that the I/O of destroyed sockets
+ * remains in the library-wide totals.
+ */
+bool baltest_io_stats(void);
+
+/**
+ * @test baltest_loop_histograms
+ * Checks histogram percentile estimates against known values, then ensures
+ * that the event loop records poll, dispatch, callback and loop lag latencies
+ * only while histograms are enabled, and that snapshots can reset them.
+ */
+bool baltest_loop_histograms(void);
+
+/**
+ * @test baltest_async_connect
+ * Ensures that a stream socket registered for async I/O before it connects
+ * stays registered and receives its connect event.
+ */
+bool baltest_async_connect(void);
+
+/**
+ * @test baltest_registration
+ * Ensures that stream sockets are left out of the poll set until they connect
+ * or listen, that every registration gets a new registration number, and that
+ * the library-wide peak of registered sockets is not a sum of reactor peaks.
+ */
+bool baltest_registration(void);
+
+/**
+ * @test baltest_send_async
+ * Ensures that bal_send_async queues what the socket won't take, delivers it
+ * in order as the socket becomes writable, releases caller-owned buffers once,
+ * and drops the write interest it added (without reporting it) once drained.
+ */
+bool baltest_send_async(void);
+
+/**
+ * @test baltest_send_watermarks
+ * Ensures that a send queue growing past its high watermark raises
+ * BAL_EVT_WBLOCKED, that draining it to the low one raises BAL_EVT_WDRAINED
+ * (each once), and that a socket whose reads are paused gets no read events
+ * until resumed.
+ */
+bool baltest_send_watermarks(void);
+
+/**
+ * @test baltest_async_recv
+ * Ensures that bal_async_recv delivers received data to its handler, retains
+ * what the handler doesn't consume (and only then holds a pooled buffer),
+ * refills the buffer as it's consumed, and still reports the peer closing.
+ */
+bool baltest_async_recv(void);
+
+/**
+ * @test baltest_recv_sizing
+ * Ensures that bal_async_recv sizes receive buffers from recent reads (growing
+ * for bursts and for data the handler retains, shrinking after small reads),
+ * and that idle buffers are kept only for the configured reclaim period.
+ */
+bool baltest_recv_sizing(void);
+
+/**
+ * @test baltest_framing
+ * Ensures that bal_crc32c matches the standard check value, and that frames
+ * sent by bal_send_frame reach bal_async_frames' handler whole (whether they
+ * arrive in pieces or are bigger than any receive buffer), and that a frame
+ * failing its CRC is reported as an error.
+ */
+bool baltest_framing(void);
+
+/**
+ * @test baltest_async_lines
+ * Ensures that the SIMD and scalar delimiter searches agree with memchr at
+ * every alignment, and that bal_async_lines delivers complete lines (without
+ * CRLF) however they arrive, and reports a line too long to buffer as an error.
+ */
+bool baltest_async_lines(void);
+
+/**
+ * @test baltest_sendv
+ * Ensures that bal_sendv sends scattered buffers in order with one call, and
+ * hands at most BAL_IOV_MAX of them to the OS at a time.
+ */
+bool baltest_sendv(void);
+
+/**
+ * @test baltest_destroy_in_handler
+ * Ensures that a socket closed and destroyed by its own data, frame or line
+ * handler is freed once its dispatch returns, and is not touched (or sent events)
+ * after that.
+ */
+bool baltest_destroy_in_handler(void);
+
+/**
+ * @test baltest_perf_register
+ * Perf: times registering 10k sockets for async I/O and unregistering them,
+ * per socket.
+ */
+bool baltest_perf_register(void);
+
+/**
+ * @test baltest_perf_round_trip
+ * Perf: times loopback round trips through a reactor that echoes each message,
+ * at the 50th and 99th percentiles.
+ */
+bool baltest_perf_round_trip(void);
+
 #endif /* !_BAL_TESTS_H_INCLUDED */
@@ -24,6 +24,15 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include "tests_shared.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** The loaded perf baseline (if any), and this run's measurements. */
+static bal_perf_metric _bal_perf_baseline[BAL_PERF_MAX_METRICS];
+static size_t _bal_perf_baseline_count = 0;
+static double _bal_perf_max_ratio      = BAL_PERF_DEFAULT_MAX_RATIO;
+static bal_perf_metric _bal_perf_results[BAL_PERF_MAX_METRICS];
+static size_t _bal_perf_result_count   = 0;
 
 void _bal_tests_init(void)
 {
@@ -82,6 +91,297 @@ void _bal_end_all_tests(size_t total, size_t run, size_t passed)
     }
 }
 
+static void _bal_print_test_usage(const char* argv0)
+{
+    (void)fprintf(stderr, "usage: %s [options]\n"
+        "  -f, --filter <text>          run only tests whose names contain <text>\n"
+        "                               (may be repeated)\n"
+        "  -r, --repeat <n>             run the selected tests n times (default: 1)\n"
+        "  -o, --offline                skip tests that need an Internet connection\n"
+        "  -p, --perf                   run the performance tests instead\n"
+        "  -b, --baseline <file>        fail perf tests that regress against <file>\n"
+        "  -w, --write-baseline <file>  write the perf results to <file>\n", argv0);
+}
+
+bool _bal_parse_test_args(int argc, char** argv, bal_test_options* opts)
+{
+    memset(opts, 0, sizeof(bal_test_options));
+    opts->repeat = 1;
+
+    for (int n = 1; n < argc; n++) {
+        const char* arg = argv[n];
+        const char* val = n + 1 < argc ? argv[n + 1] : NULL;
+        bool ok         = true;
+
+        if (0 == strcmp(arg, "-o") || 0 == strcmp(arg, "--offline")) {
+            opts->offline = true;
+            continue;
+        } else if (0 == strcmp(arg, "-p") || 0 == strcmp(arg, "--perf")) {
+            opts->perf = true;
+            continue;
+        } else if (NULL == val) {
+            ok = false;
+        } else if (0 == strcmp(arg, "-f") || 0 == strcmp(arg, "--filter")) {
+            ok = opts->filter_count < BAL_TESTS_MAX_FILTERS;
+            if (ok)
+                opts->filters[opts->filter_count++] = val;
+        } else if (0 == strcmp(arg, "-r") || 0 == strcmp(arg, "--repeat")) {
+            char* end    = NULL;
+            opts->repeat = (size_t)strtoul(val, &end, 10);
+            ok           = NULL != end && '\0' == *end && opts->repeat > 0;
+        } else if (0 == strcmp(arg, "-b") || 0 == strcmp(arg, "--baseline")) {
+            opts->baseline = val;
+        } else if (0 == strcmp(arg, "-w") || 0 == strcmp(arg, "--write-baseline")) {
+            opts->write_baseline = val;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            _bal_print_test_usage(argv[0]);
+            return false;
+        }
+        n++;
+    }
+
+    return true;
+}
+
+static bool _bal_test_selected(const bal_test_data* test, const bal_test_options* opts)
+{
+    if (test->perf != opts->perf || (test->online_only && opts->offline))
+        return false;
+
+    if (0 == opts->filter_count)
+        return true;
+
+    for (size_t n = 0; n < opts->filter_count; n++) {
+        if (NULL != strstr(test->name, opts->filters[n]))
+            return true;
+    }
+
+    return false;
+}
+
+/* Finds the number following `"key":` between `begin` and `end`. */
+static bool _bal_json_number(const char* begin, const char* end, const char* key,
+    double* out)
+{
+    char quoted[64];
+    (void)snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+
+    const char* pos = strstr(begin, quoted);
+    if (NULL == pos || pos >= end)
+        return false;
+
+    pos = strchr(pos + strlen(quoted), ':');
+    if (NULL == pos || pos >= end)
+        return false;
+
+    char* num_end = NULL;
+    *out = strtod(pos + 1, &num_end);
+    return num_end != pos + 1 && num_end <= end;
+}
+
+/* Reads the flat baseline format written by _bal_perf_write_baseline: an
+ * optional top-level "max_ratio", then a "metrics" object holding one
+ * {"value", "unit"[, "max_ratio"]} object per metric. */
+static bool _bal_perf_parse_baseline(const char* json)
+{
+    const char* metrics = strstr(json, "\"metrics\"");
+    if (NULL == metrics)
+        return false;
+
+    (void)_bal_json_number(json, metrics, "max_ratio", &_bal_perf_max_ratio);
+
+    const char* pos = strchr(metrics + 9, '{');
+    if (NULL == pos)
+        return false;
+    pos++;
+
+    while (_bal_perf_baseline_count < BAL_PERF_MAX_METRICS) {
+        const char* key    = strchr(pos, '"');
+        const char* closed = strchr(pos, '}');
+        if (NULL == key || (NULL != closed && closed < key))
+            break;
+
+        const char* key_end = strchr(key + 1, '"');
+        const char* obj     = NULL != key_end ? strchr(key_end, '{') : NULL;
+        const char* obj_end = NULL != obj ? strchr(obj, '}') : NULL;
+        if (NULL == obj_end)
+            return false;
+
+        bal_perf_metric* m = &_bal_perf_baseline[_bal_perf_baseline_count];
+        int name_len       = (int)(key_end - key - 1);
+        (void)snprintf(m->name, sizeof(m->name), "%.*s", name_len, key + 1);
+        m->max_ratio = _bal_perf_max_ratio;
+        (void)_bal_json_number(obj, obj_end, "max_ratio", &m->max_ratio);
+        if (!_bal_json_number(obj, obj_end, "value", &m->value))
+            return false;
+
+        _bal_perf_baseline_count++;
+        pos = obj_end + 1;
+    }
+
+    return true;
+}
+
+static bool _bal_perf_load_baseline(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (NULL == f)
+        return false;
+
+    bool ok    = 0 == fseek(f, 0, SEEK_END);
+    long size  = ok ? ftell(f) : -1L;
+    char* json = size >= 0L ? calloc((size_t)size + 1, 1) : NULL;
+
+    ok = NULL != json && 0 == fseek(f, 0, SEEK_SET) &&
+         (size_t)size == fread(json, 1, (size_t)size, f);
+    (void)fclose(f);
+
+    ok = ok && _bal_perf_parse_baseline(json);
+    free(json);
+
+    return ok;
+}
+
+static const bal_perf_metric* _bal_perf_find(const bal_perf_metric* metrics,
+    size_t count, const char* name)
+{
+    for (size_t n = 0; n < count; n++) {
+        if (0 == strcmp(metrics[n].name, name))
+            return &metrics[n];
+    }
+    return NULL;
+}
+
+static bool _bal_perf_write_baseline(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    if (NULL == f)
+        return false;
+
+    (void)fprintf(f, "{\n    \"max_ratio\": %.2f,\n    \"metrics\": {\n",
+        _bal_perf_max_ratio);
+
+    for (size_t n = 0; n < _bal_perf_result_count; n++) {
+        const bal_perf_metric* m = &_bal_perf_results[n];
+        (void)fprintf(f, "        \"%s\": {\"value\": %.3f, \"unit\": \"%s\"", m->name,
+            m->value, m->unit);
+
+        /* keep any tolerance that was tuned for an individual metric. */
+        if (m->max_ratio != _bal_perf_max_ratio)
+            (void)fprintf(f, ", \"max_ratio\": %.2f", m->max_ratio);
+
+        (void)fprintf(f, "}%s\n", n + 1 < _bal_perf_result_count ? "," : "");
+    }
+
+    (void)fprintf(f, "    }\n}\n");
+    return 0 == fclose(f);
+}
+
+bool _bal_perf_check(const char* metric, double value, const char* unit)
+{
+    const bal_perf_metric* base = _bal_perf_find(_bal_perf_baseline,
+        _bal_perf_baseline_count, metric);
+
+    bal_perf_metric* result = (bal_perf_metric*)_bal_perf_find(_bal_perf_results,
+        _bal_perf_result_count, metric);
+    if (NULL == result && _bal_perf_result_count < BAL_PERF_MAX_METRICS)
+        result = &_bal_perf_results[_bal_perf_result_count++];
+
+    if (NULL != result) {
+        (void)snprintf(result->name, sizeof(result->name), "%s", metric);
+        (void)snprintf(result->unit, sizeof(result->unit), "%s", unit);
+        result->value     = value;
+        result->max_ratio = NULL != base ? base->max_ratio : _bal_perf_max_ratio;
+    }
+
+    if (NULL == base || base->value <= 0.0) {
+        TEST_MSG("%s: %.3f %s (no baseline)", metric, value, unit);
+        return true;
+    }
+
+    double ratio = value / base->value;
+    if (ratio > base->max_ratio) {
+        ERROR_MSG("%s: %.3f %s is %.2fx the baseline of %.3f (limit: %.2fx)", metric,
+            value, unit, ratio, base->value, base->max_ratio);
+        return false;
+    }
+
+    TEST_MSG("%s: %.3f %s (%.2fx the baseline of %.3f)", metric, value, unit, ratio,
+        base->value);
+    return true;
+}
+
+static int _bal_perf_compare(const void* lhs, const void* rhs)
+{
+    double l = *(const double*)lhs;
+    double r = *(const double*)rhs;
+    return (l > r) - (l < r);
+}
+
+double _bal_perf_percentile(double* samples, size_t count, double pct)
+{
+    if (0 == count)
+        return 0.0;
+
+    qsort(samples, count, sizeof(double), &_bal_perf_compare);
+    size_t rank = (size_t)(pct / 100.0 * (double)count);
+    return samples[rank < count ? rank : count - 1];
+}
+
+int _bal_run_tests(bal_test_data* tests, size_t count, const bal_test_options* opts)
+{
+    if (opts->perf && NULL != opts->baseline && !_bal_perf_load_baseline(opts->baseline)) {
+        (void)fprintf(stderr, "error: failed to read perf baseline '%s'\n", opts->baseline);
+        return EXIT_FAILURE;
+    }
+
+    size_t selected = 0;
+    for (size_t n = 0; n < count; n++) {
+        tests[n].run  = _bal_test_selected(&tests[n], opts);
+        tests[n].pass = true;
+        if (tests[n].run)
+            selected++;
+    }
+
+    size_t tests_total  = selected * opts->repeat;
+    size_t tests_run    = 0;
+    size_t tests_passed = 0;
+
+    _bal_start_all_tests(tests_total);
+
+    for (size_t r = 0; r < opts->repeat; r++) {
+        for (size_t n = 0; n < count; n++) {
+            if (!tests[n].run)
+                continue;
+
+            _bal_start_test(tests_total, tests_run, tests[n].name);
+            bool pass = tests[n].func();
+            _bal_end_test(tests_total, tests_run, tests[n].name, pass);
+            tests[n].pass = tests[n].pass && pass;
+            if (pass)
+                tests_passed++;
+            tests_run++;
+        }
+    }
+
+    _bal_end_all_tests(tests_total, tests_run, tests_passed);
+
+    if (opts->perf && NULL != opts->write_baseline) {
+        if (!_bal_perf_write_baseline(opts->write_baseline)) {
+            (void)fprintf(stderr, "error: failed to write perf baseline '%s'\n",
+                opts->write_baseline);
+            return EXIT_FAILURE;
+        }
+        (void)printf("wrote perf baseline to '%s'\n", opts->write_baseline);
+    }
+
+    return tests_passed == tests_run ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 void _bal_async_poll_callback(bal_socket* s, uint32_t events)
 {
 #pragma message("TODO: print events")
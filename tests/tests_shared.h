@@ -44,10 +44,41 @@ typedef struct {
     const char* const name; /**< Human-readable name */
     bal_test_func func;     /**< Function pointer. */
     bool online_only;       /**< Whether an Internet connection is required. */
+    bool perf;              /**< Whether this is a performance test (run with --perf). */
     bool run;               /**< Whether or not to include the test. */
     bool pass;              /**< Pass/fail result of test execution. */
 } bal_test_data;
 
+/** Most --filter arguments accepted on the command line. */
+# define BAL_TESTS_MAX_FILTERS 16
+
+/** Most metrics a perf baseline may hold. */
+# define BAL_PERF_MAX_METRICS 64
+
+/** A perf measurement, or its counterpart in the baseline. */
+typedef struct {
+    char name[64];    /**< Metric name (e.g. "register-ns-per-socket"). */
+    char unit[16];    /**< Unit the value is expressed in. */
+    double value;     /**< Measured or baseline value; lower is better. */
+    double max_ratio; /**< Largest acceptable value/baseline ratio. */
+} bal_perf_metric;
+
+/** The value/baseline ratio above which a perf metric fails, unless the
+ * baseline says otherwise. */
+# define BAL_PERF_DEFAULT_MAX_RATIO 2.0
+
+/** Command line options for the test runners. */
+typedef struct {
+    const char* filters[BAL_TESTS_MAX_FILTERS]; /**< Run tests whose names contain
+                                                     any of these. */
+    size_t filter_count;      /**< Number of entries in `filters`. */
+    size_t repeat;            /**< Number of times to run the selected tests. */
+    bool offline;             /**< Skip tests that need an Internet connection. */
+    bool perf;                /**< Run the performance tests instead of the others. */
+    const char* baseline;     /**< Perf baseline to compare against (or NULL). */
+    const char* write_baseline; /**< Where to write a new perf baseline (or NULL). */
+} bal_test_options;
+
 /** Returns the plural form of test(s) based on `num`. */
 # define _TEST_PLURAL(num) ((!(num) || (num) > 1) ? "tests" : "test")
 
@@ -152,6 +183,21 @@ bool _bal_print_err(bool pass, bool expected);
 void _bal_end_test(size_t total, size_t run, const char* name, bool pass);
 void _bal_end_all_tests(size_t total, size_t run, size_t passed);
 
+/** Parses the command line; prints usage and returns false if it is invalid. */
+bool _bal_parse_test_args(int argc, char** argv, bal_test_options* opts);
+
+/** Runs the tests selected by `opts`, `opts->repeat` times, and returns the
+ * process exit code. */
+int _bal_run_tests(bal_test_data* tests, size_t count, const bal_test_options* opts);
+
+/** Records a perf test's measurement, where lower is better, and compares it
+ * with the baseline. Returns false if it exceeds the baseline value by more
+ * than the baseline's tolerance. */
+bool _bal_perf_check(const char* metric, double value, const char* unit);
+
+/** Returns the `pct`th percentile of `count` samples (which are sorted). */
+double _bal_perf_percentile(double* samples, size_t count, double pct);
+
 /** Handles and prints async I/O events as they arrive for a socket. */
 void _bal_async_poll_callback(bal_socket* s, uint32_t events);
 